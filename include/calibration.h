@@ -0,0 +1,58 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+#include "calibration_lut.h"
+
+// Per-channel, per-mode multipoint output calibration
+// Each (signal, mode) pair stores up to CAL_MAX_POINTS measured points:
+// "nominal" is the value that was commanded, "measured" is what a meter read.
+// Points are persisted in flash (NVS) and compiled at load time into a lookup
+// table indexed by DAC code, so the output path only does one table lookup
+// and a short interpolation per write.
+
+#define CAL_NVS_NAMESPACE "dac_cal"
+
+/**
+ * Load calibration from flash and compile lookup tables
+ */
+void initCalibration();
+
+/**
+ * Add or replace a calibration point and save it to flash
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' for voltage (V), 'c' for current (mA)
+ * @param nominal Commanded value
+ * @param measured Measured output value
+ * @return true if point was stored
+ */
+bool addCalibrationPoint(uint8_t channel, char mode, float nominal, float measured);
+
+/**
+ * Remove all calibration points for a signal and mode and save to flash
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' or 'c'
+ */
+void clearCalibration(uint8_t channel, char mode);
+
+/**
+ * Apply calibration to a DAC code
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' or 'c'
+ * @param code Requested DAC code (0-32767)
+ * @return Corrected DAC code (0-32767)
+ */
+uint16_t applyCalibration(uint8_t channel, char mode, uint16_t code);
+
+/**
+ * Print all calibration points
+ */
+void printCalibration();
+
+/**
+ * Parse calibration commands
+ * Format: cal <signal> <v|c> <nominal> <measured> | cal clear <signal> <v|c> | cal show
+ */
+void parseCalibrationCommand(String input);
+
+#endif // CALIBRATION_H
@@ -0,0 +1,45 @@
+#ifndef CALIBRATION_LUT_H
+#define CALIBRATION_LUT_H
+
+#include <stdint.h>
+
+// Calibration lookup tables: compiled from measured points, indexed by DAC code
+// A table holds one corrected code every 2^CAL_LUT_SHIFT codes; codes in between
+// are interpolated linearly. Units are mV (voltage) or uA (current).
+// This file has no Arduino dependencies so it can also be compiled on a host
+
+#define CAL_MAX_POINTS 8                    // Points per signal and mode
+#define CAL_LUT_SHIFT 5                     // One LUT entry every 32 codes
+#define CAL_LUT_SIZE ((32768 >> CAL_LUT_SHIFT) + 1)
+
+// Calibration points for one signal and mode (engineering units: mV or uA)
+struct CalibrationPoints {
+    uint8_t count;
+    int32_t nominal[CAL_MAX_POINTS];    // Commanded value
+    int32_t measured[CAL_MAX_POINTS];   // Value actually measured at the output
+};
+
+/**
+ * Sort points by measured value (required before compileCalibrationLUT)
+ * @param points Calibration points, sorted in place
+ */
+void sortCalibrationPoints(CalibrationPoints* points);
+
+/**
+ * Compile calibration points into a lookup table (piecewise-linear, extrapolated at the ends)
+ * @param points Calibration points sorted by measured value
+ * @param mode 'v' or 'c'
+ * @param lut Output table with CAL_LUT_SIZE entries
+ */
+void compileCalibrationLUT(const CalibrationPoints* points, char mode, uint16_t* lut);
+
+/**
+ * Look up a DAC code in a compiled table
+ * @param lut Table from compileCalibrationLUT
+ * @param mode 'v' or 'c'
+ * @param code Requested DAC code, clamped to the codec range
+ * @return Corrected DAC code
+ */
+uint16_t lookupCalibrationLUT(const uint16_t* lut, char mode, uint16_t code);
+
+#endif // CALIBRATION_LUT_H
@@ -0,0 +1,75 @@
+#ifndef DAC_CODES_H
+#define DAC_CODES_H
+
+#include <stdint.h>
+
+// Compile-time DAC conversion layer
+// Maps integer engineering units to DAC codes and wire codes without float math.
+// Units: millivolts (mV) for GP8413 voltage, microamps (uA) for GP8313 current.
+// All conversions round to nearest and clamp to the DAC range in one place.
+// No Arduino dependencies.
+
+// DAC resolution: code range and left-alignment in the 16-bit data register
+template <uint8_t Bits>
+struct DacResolution {
+    static constexpr uint16_t kMaxCode = (uint16_t)((1u << Bits) - 1);
+    static constexpr uint8_t kWireShift = 16 - Bits;
+
+    // Clamp code to range
+    static constexpr uint16_t clamp(int32_t code) {
+        return code <= 0 ? 0 : (code >= kMaxCode ? kMaxCode : (uint16_t)code);
+    }
+
+    // DAC code -> value written to the data register
+    static constexpr uint16_t toWire(uint16_t code) {
+        return (uint16_t)((code > kMaxCode ? kMaxCode : code) << kWireShift);
+    }
+};
+
+// DAC transfer function: FullScaleUnits maps to the maximum code
+template <class Resolution, uint32_t FullScaleUnits>
+struct DacCodec {
+    typedef Resolution ResolutionType;
+    static constexpr uint16_t kMaxCode = Resolution::kMaxCode;
+    static constexpr uint32_t kFullScaleUnits = FullScaleUnits;
+
+    // Engineering units -> code, rounded, not clamped (may be negative or above range)
+    static constexpr int32_t toCodeUnclamped(int32_t units) {
+        return units >= 0
+            ? (int32_t)(((int64_t)units * kMaxCode + FullScaleUnits / 2) / FullScaleUnits)
+            : -(int32_t)(((int64_t)(-units) * kMaxCode + FullScaleUnits / 2) / FullScaleUnits);
+    }
+
+    // Engineering units -> code, rounded and clamped to DAC range
+    static constexpr uint16_t toCode(int32_t units) {
+        return units <= 0 ? 0
+             : ((uint32_t)units >= FullScaleUnits ? kMaxCode
+             : (uint16_t)(((uint32_t)units * kMaxCode + FullScaleUnits / 2) / FullScaleUnits));
+    }
+
+    // Engineering units -> data register value
+    static constexpr uint16_t toWire(int32_t units) {
+        return Resolution::toWire(toCode(units));
+    }
+
+    // Code -> engineering units, rounded
+    static constexpr int32_t toUnits(uint16_t code) {
+        return (int32_t)(((uint32_t)code * FullScaleUnits + kMaxCode / 2) / kMaxCode);
+    }
+};
+
+typedef DacResolution<15> Dac15Bit;
+typedef DacResolution<12> Dac12Bit;
+
+typedef DacCodec<Dac15Bit, 10000> GP8413VoltageCodec;  // 0-10 V  -> 0-32767 (mV)
+typedef DacCodec<Dac15Bit, 25000> GP8313CurrentCodec;  // 0-25 mA -> 0-32767 (uA, Rset = 2kΩ)
+
+// Sanity checks on the conversion constants
+static_assert(GP8413VoltageCodec::toCode(10000) == 32767, "10 V must map to full scale");
+static_assert(GP8413VoltageCodec::toCode(5000) == 16384, "5 V must map to mid scale");
+static_assert(GP8413VoltageCodec::toCode(-1) == 0, "Negative voltage must clamp to 0");
+static_assert(GP8313CurrentCodec::toCode(1000) == 1311, "1 mA must map to 1310.68 rounded");
+static_assert(GP8313CurrentCodec::toCode(30000) == 32767, "Over-range current must clamp");
+static_assert(Dac15Bit::toWire(32767) == 0xFFFE, "15-bit data is left-aligned");
+
+#endif // DAC_CODES_H
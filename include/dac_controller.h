@@ -3,12 +3,41 @@
 
 #include "DFRobot_GP8XXX.h"
 #include <Arduino.h>
+#include "dac_codes.h"
+
+// Common base for GP8413/GP8313: raw code writes that report I2C bus status
+// (library writeRegister() discards the endTransmission() result)
+class GP8XXXDevice : public DFRobot_GP8XXX_IIC {
+public:
+    GP8XXXDevice(uint8_t deviceAddr, uint16_t resolution)
+        : DFRobot_GP8XXX_IIC(resolution, deviceAddr) {}
+
+    /**
+     * Write raw code to one channel
+     * @param channel Output channel (0 or 1)
+     * @param code DAC code (0-32767)
+     * @return Wire status (0 = success)
+     */
+    uint8_t writeChannelCode(uint8_t channel, uint16_t code);
+
+    /**
+     * Write raw codes to both channels in a single I2C transaction
+     * @param code0 Channel 0 DAC code (0-32767)
+     * @param code1 Channel 1 DAC code (0-32767)
+     * @return Wire status (0 = success)
+     */
+    uint8_t writeDualChannelCodes(uint16_t code0, uint16_t code1);
+
+protected:
+    uint16_t alignCode(uint16_t code);
+    uint8_t writeRegisterChecked(uint8_t reg, const uint8_t* buf, size_t size);
+};
 
 // GP8413 class definition: for voltage output
-class GP8413 : public DFRobot_GP8XXX_IIC {
+class GP8413 : public GP8XXXDevice {
 public:
     GP8413(uint8_t deviceAddr = DFGP8XXX_I2C_DEVICEADDR, uint16_t resolution = RESOLUTION_15_BIT)
-        : DFRobot_GP8XXX_IIC(resolution, deviceAddr) {}
+        : GP8XXXDevice(deviceAddr, resolution) {}
 
     /**
      * Set voltage output
@@ -20,10 +49,10 @@ public:
 };
 
 // GP8313 class definition: for current output
-class GP8313 : public DFRobot_GP8XXX_IIC {
+class GP8313 : public GP8XXXDevice {
 public:
     GP8313(uint8_t deviceAddr, uint16_t resolution = RESOLUTION_15_BIT)
-        : DFRobot_GP8XXX_IIC(resolution, deviceAddr) {}
+        : GP8XXXDevice(deviceAddr, resolution) {}
 
     /**
      * Set current output
@@ -40,11 +69,92 @@ extern GP8313 gp8313_1;
 extern GP8313 gp8313_2;
 extern GP8313 gp8313_3;
 
+// DAC output frame: pending codes for all signals, written out by commitDacFrame()
+struct DacFrame {
+    uint16_t voltageCode[3];  // GP8413 code per signal (0-32767)
+    uint16_t currentCode[3];  // GP8313 code per signal (0-32767)
+    uint8_t voltagePending;   // Bit n set = voltageCode[n] should be written
+    uint8_t currentPending;   // Bit n set = currentCode[n] should be written
+};
+
+/**
+ * Clear all pending codes in a frame
+ * @param frame Frame to clear
+ */
+void dacFrameClear(DacFrame* frame);
+
+/**
+ * Queue a voltage DAC code in a frame
+ * @param frame Target frame
+ * @param channel Signal channel (0-2)
+ * @param code DAC code (0-32767)
+ */
+void dacFrameSetVoltageCode(DacFrame* frame, uint8_t channel, uint16_t code);
+
+/**
+ * Queue a current DAC code in a frame
+ * @param frame Target frame
+ * @param channel Signal channel (0-2)
+ * @param code DAC code (0-32767)
+ */
+void dacFrameSetCurrentCode(DacFrame* frame, uint8_t channel, uint16_t code);
+
+// I2C bus utilisation counters for DAC writes
+struct DacBusStats {
+    uint32_t transactions;    // I2C transactions issued
+    uint32_t bytes;           // Bytes on the bus (address + register + data)
+    uint32_t channelWrites;   // Channel codes written to the bus
+    uint32_t skippedWrites;   // Channel writes skipped by the shadow cache
+    uint32_t busErrors;       // Transactions that were not acknowledged
+};
+
+/**
+ * Write all pending codes of a frame with the minimum number of I2C transactions
+ * Voltage channels that share a GP8413 are written together in one transaction.
+ * Codes equal to the last value committed to a channel (shadow cache) are skipped.
+ * @param frame Frame to commit
+ */
+void commitDacFrame(const DacFrame* frame);
+
+/**
+ * Invalidate the shadow cache and rewrite the latest requested code of every channel
+ * Use for recovery after a bus error or DAC power glitch.
+ */
+void refreshDacOutputs();
+
+/**
+ * Get DAC bus utilisation counters
+ * @return Copy of counters
+ */
+DacBusStats getDacBusStats();
+
+/**
+ * Print DAC bus utilisation counters to USB serial
+ */
+void printDacBusStatus();
+
+/**
+ * Convert voltage to GP8413 15-bit DAC code (rounded, clamped to 0-10V)
+ * Only the V -> mV step is float; the rest is GP8413VoltageCodec integer math.
+ * @param voltage Voltage (0-10V)
+ * @return DAC code (0-32767)
+ */
+uint16_t voltageToDacCode(float voltage);
+
+/**
+ * Convert current to GP8313 15-bit DAC code (rounded, clamped to 0-25mA)
+ * Only the mA -> uA step is float; the rest is GP8313CurrentCodec integer math.
+ * @param current Current (0-25mA)
+ * @return DAC code (0-32767)
+ */
+uint16_t currentToDacCode(float current);
+
 /**
  * Initialize all DACs
  * Set all outputs to 0
+ * @return false if the zeroing did not reach the DACs within the flush timeout
  */
-void initializeDACs();
+bool initializeDACs();
 
 /**
  * Initialize DAC controllers
@@ -0,0 +1,86 @@
+#ifndef DAC_OUTPUT_QUEUE_H
+#define DAC_OUTPUT_QUEUE_H
+
+#include <Arduino.h>
+#include "dac_controller.h"
+
+// Asynchronous DAC output queue
+// Producers (command handler, waveform engine, RS-485 handler) post setpoints and
+// return immediately. A dedicated worker task drains pending setpoints to the I2C bus.
+// Each DAC channel holds at most one pending setpoint: a newer post for the same
+// channel replaces the older one (counted as superseded), so only the latest value
+// is ever written.
+
+#define DAC_QUEUE_TASK_STACK 4096
+#define DAC_QUEUE_TASK_PRIORITY 4         // Below sample clock task (5), above loop() (1)
+#define DAC_QUEUE_TASK_CORE 0
+#define DAC_QUEUE_FLUSH_TIMEOUT_MS 50     // Default wait for flushDacOutputQueue()
+
+// Queue statistics
+struct DacQueueStats {
+    uint32_t posted;      // Setpoints posted by producers
+    uint32_t written;     // Setpoints written to the bus
+    uint32_t superseded;  // Setpoints dropped because a newer one replaced them
+    uint8_t depth;        // Setpoints currently pending
+    uint8_t maxDepth;     // Highest pending count seen
+};
+
+/**
+ * Initialize output queue and start the worker task
+ */
+void initDacOutputQueue();
+
+/**
+ * Post all pending codes of a frame (kept together in one bus commit)
+ * @param frame Frame with pending codes
+ */
+void postDacFrame(const DacFrame* frame);
+
+/**
+ * Get the most recent code posted for a channel (pending or already written)
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' for voltage DAC, 'c' for current DAC
+ * @return DAC code (0-32767)
+ */
+uint16_t getLastPostedCode(uint8_t channel, char mode);
+
+/**
+ * Post the most recent code again for every channel without a pending one
+ * Channels already pending keep their newer code.
+ */
+void repostDacOutputs();
+
+/**
+ * Post a voltage setpoint
+ * @param channel Signal channel (0-2)
+ * @param code DAC code (0-32767)
+ */
+void postVoltageCode(uint8_t channel, uint16_t code);
+
+/**
+ * Post a current setpoint
+ * @param channel Signal channel (0-2)
+ * @param code DAC code (0-32767)
+ */
+void postCurrentCode(uint8_t channel, uint16_t code);
+
+/**
+ * Wait until all posted setpoints have reached the bus
+ * Used where ordering against relays matters (break-before-make).
+ * @param timeoutMs Maximum wait in milliseconds
+ * @return true if queue drained within timeout
+ */
+bool flushDacOutputQueue(uint32_t timeoutMs = DAC_QUEUE_FLUSH_TIMEOUT_MS);
+
+/**
+ * Get queue statistics
+ * @return Copy of current statistics
+ */
+DacQueueStats getDacQueueStats();
+
+/**
+ * Print queue statistics to USB serial
+ */
+void printDacQueueStatus();
+
+#endif // DAC_OUTPUT_QUEUE_H
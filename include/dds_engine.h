@@ -0,0 +1,123 @@
+#ifndef DDS_ENGINE_H
+#define DDS_ENGINE_H
+
+#include <stdint.h>
+
+// Direct Digital Synthesis (DDS) engine for the waveform generator
+// Each channel owns a 32-bit phase accumulator (one full cycle = 2^32)
+// Sine values come from a precomputed Q15 table with linear interpolation
+// Output is produced directly as 15-bit DAC codes (0-32767), no float math per tick
+// Phase can also be evaluated for an absolute sample index (phase + increment * n),
+// so several channels computed from one shared tick counter stay phase-locked
+// This file has no Arduino dependencies so it can also be compiled on a host
+
+#define DDS_TABLE_BITS 10                         // 1024-point sine table
+#define DDS_TABLE_SIZE (1 << DDS_TABLE_BITS)
+#define DDS_CODE_MAX 32767                        // 15-bit DAC full scale
+#define DDS_AMPLITUDE_CODE_MAX 65535              // Keeps amplitude * Q15 sample inside int32
+
+// Chirp (frequency sweep) shapes and end-of-sweep behaviour
+#define DDS_CHIRP_LINEAR 0        // Frequency changes linearly with time
+#define DDS_CHIRP_LOG 1           // Frequency changes exponentially (constant octaves per second)
+#define DDS_CHIRP_ONCE 0          // Keep end frequency after the sweep
+#define DDS_CHIRP_REPEAT 1        // Restart at start frequency
+#define DDS_CHIRP_BOUNCE 2        // Sweep back and forth
+
+// Chirp parameters: increment as a function of sample index
+// Phase stays continuous because the channel accumulates these increments.
+struct DDSChirp {
+    uint32_t startIncrement;  // Phase step at sweep start
+    uint32_t endIncrement;    // Phase step at sweep end
+    uint32_t sweepSamples;    // Sweep duration in sample ticks
+    uint8_t shape;            // DDS_CHIRP_LINEAR or DDS_CHIRP_LOG
+    uint8_t endMode;          // DDS_CHIRP_ONCE, DDS_CHIRP_REPEAT or DDS_CHIRP_BOUNCE
+    float logRatio;           // ln(endIncrement / startIncrement), DDS_CHIRP_LOG only
+};
+
+// Per-channel DDS state
+struct DDSChannel {
+    uint32_t phase;         // Phase accumulator
+    uint32_t increment;     // Phase step per sample tick
+    int32_t centerCode;     // Center point in DAC codes
+    int32_t amplitudeCode;  // Peak amplitude in DAC codes
+};
+
+/**
+ * Build the Q15 sine table (call once at startup)
+ */
+void ddsInitTable();
+
+/**
+ * Calculate phase increment per sample for a given period
+ * @param periodSeconds Waveform period in seconds
+ * @param sampleRateHz Sample clock rate in Hz
+ * @return Phase increment (2^32 = one full cycle)
+ */
+uint32_t ddsIncrementForPeriod(float periodSeconds, float sampleRateHz);
+
+/**
+ * Configure a DDS channel and reset its phase to 0
+ * @param channel DDS channel state
+ * @param centerCode Center point in DAC codes
+ * @param amplitudeCode Peak amplitude in DAC codes
+ * @param increment Phase step per sample tick
+ */
+void ddsConfigure(DDSChannel* channel, int32_t centerCode, int32_t amplitudeCode, uint32_t increment);
+
+/**
+ * Look up sine value for a phase
+ * @param phase Phase (2^32 = one full cycle)
+ * @return Sine value in Q15 (-32767 to 32767)
+ */
+int16_t ddsSineQ15(uint32_t phase);
+
+/**
+ * Get DAC code for the current phase (clamped to 0-32767)
+ * @param channel DDS channel state
+ * @return DAC code
+ */
+uint16_t ddsCurrentCode(const DDSChannel* channel);
+
+/**
+ * Get DAC code at an absolute sample index without touching channel state
+ * @param channel DDS channel state (phase = phase at sample 0)
+ * @param sampleIndex Samples since the channel's epoch
+ * @return DAC code
+ */
+uint16_t ddsCodeAt(const DDSChannel* channel, uint32_t sampleIndex);
+
+/**
+ * Convert phase offset in degrees to accumulator phase
+ * @param degrees Phase offset (any value, wrapped to 0-360)
+ * @return Phase (2^32 = one full cycle)
+ */
+uint32_t ddsPhaseFromDegrees(float degrees);
+
+/**
+ * Configure a chirp
+ * @param chirp Chirp parameters
+ * @param startIncrement Phase step at sweep start
+ * @param endIncrement Phase step at sweep end
+ * @param sweepSamples Sweep duration in sample ticks (at least 1)
+ * @param shape DDS_CHIRP_LINEAR or DDS_CHIRP_LOG
+ * @param endMode DDS_CHIRP_ONCE, DDS_CHIRP_REPEAT or DDS_CHIRP_BOUNCE
+ */
+void ddsChirpConfigure(DDSChirp* chirp, uint32_t startIncrement, uint32_t endIncrement,
+                       uint32_t sweepSamples, uint8_t shape, uint8_t endMode);
+
+/**
+ * Get phase increment of a chirp at a sample index
+ * @param chirp Chirp parameters
+ * @param sampleIndex Samples since sweep start
+ * @return Phase step for this sample
+ */
+uint32_t ddsChirpIncrement(const DDSChirp* chirp, uint32_t sampleIndex);
+
+/**
+ * Advance phase accumulator
+ * @param channel DDS channel state
+ * @param ticks Number of sample ticks to advance
+ */
+void ddsAdvance(DDSChannel* channel, uint32_t ticks);
+
+#endif // DDS_ENGINE_H
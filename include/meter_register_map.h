@@ -0,0 +1,200 @@
+#ifndef METER_REGISTER_MAP_H
+#define METER_REGISTER_MAP_H
+
+#include <Arduino.h>
+#include "modbus_handler.h"
+#include "modbus_register_image.h"
+
+// Flow meter register map
+// Every emulated meter register is one row of a constexpr table: address, data
+// type, word order, scale and access. Encoders are templates on the data type, so
+// a row is turned into register words with no table search and no allocation;
+// the table is checked at compile time (inside the image, no overlaps).
+// Adding a register from the device manual = adding a row and an id.
+// Values are read and written in the image of one virtual meter (meter index).
+
+// Word order on the wire (bytes inside a register are always big-endian)
+enum MeterWordOrder {
+    WORD_ORDER_1032,   // Low word first (device manual "1-0-3-2"), U64 low 32 bits first
+    WORD_ORDER_3210    // High word first
+};
+
+// Register access from the Modbus master
+enum MeterAccess {
+    ACCESS_READ,       // Value set by the emulator only
+    ACCESS_READ_WRITE  // Master may write (FC06/FC16)
+};
+
+// One register-map row
+struct MeterRegister {
+    const char* name;   // Command/display name
+    uint16_t address;   // First holding register
+    DataType type;      // TYPE_FLOAT, TYPE_U32, TYPE_U64 or TYPE_INT16
+    MeterWordOrder order;
+    float scale;        // Engineering units per raw count (integer types)
+    MeterAccess access;
+    const char* unit;
+};
+
+// Register ids (index into meterRegisterMap)
+enum MeterRegisterId {
+    METER_FLOW,
+    METER_CONSUMPTION,
+    METER_REVERSE_CONSUMPTION,
+    METER_FLOW_DIRECTION,
+    METER_REGISTER_COUNT
+};
+
+constexpr MeterRegister meterRegisterMap[METER_REGISTER_COUNT] = {
+    // name          addr  type        order            scale access        unit
+    {"flow",           6, TYPE_FLOAT, WORD_ORDER_1032, 1.0f, ACCESS_READ, "m3/h"},
+    {"consumption",    8, TYPE_U32,   WORD_ORDER_1032, 1.0f, ACCESS_READ, "m3"},
+    {"reverse",       14, TYPE_U32,   WORD_ORDER_1032, 1.0f, ACCESS_READ, "m3"},
+    {"direction",     42, TYPE_U32,   WORD_ORDER_1032, 1.0f, ACCESS_READ, ""},
+};
+
+/**
+ * Number of registers used by a data type
+ */
+constexpr uint8_t meterTypeWords(DataType type) {
+    return (type == TYPE_U64) ? 4 : (type == TYPE_INT16) ? 1 : 2;
+}
+
+/**
+ * Check that register rows a and b do not overlap
+ */
+constexpr bool meterRowsDisjoint(int a, int b) {
+    return meterRegisterMap[a].address + meterTypeWords(meterRegisterMap[a].type) <= meterRegisterMap[b].address ||
+           meterRegisterMap[b].address + meterTypeWords(meterRegisterMap[b].type) <= meterRegisterMap[a].address;
+}
+
+/**
+ * Check that row a is inside the image and overlaps no later row
+ */
+constexpr bool meterRowValid(int a, int b = 1) {
+    return (a >= METER_REGISTER_COUNT) ? true :
+           (b >= METER_REGISTER_COUNT) ?
+               (meterRegisterMap[a].address + meterTypeWords(meterRegisterMap[a].type) <= MODBUS_IMAGE_SIZE &&
+                meterRowValid(a + 1, a + 2)) :
+               (b <= a || meterRowsDisjoint(a, b)) && meterRowValid(a, b + 1);
+}
+
+static_assert(meterRowValid(0), "Meter register map overlaps or exceeds the register image");
+
+/**
+ * Register encoder for one data type
+ * @param raw Raw value bits (IEEE-754 bits for FLOAT, integer otherwise)
+ * @param order Word order
+ * @param words Output register words (meterTypeWords(Type) entries)
+ */
+template <DataType Type>
+inline void encodeMeterWords(uint64_t raw, MeterWordOrder order, uint16_t* words) {
+    const uint8_t count = meterTypeWords(Type);
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t word = (uint16_t)(raw >> (16 * i));
+        words[(order == WORD_ORDER_1032) ? i : count - 1 - i] = word;
+    }
+}
+
+/**
+ * Convert an engineering value to raw bits for a row
+ * Integer types are divided by scale, rounded and clamped to the type's range.
+ */
+uint64_t meterRawFromValue(const MeterRegister& row, double value);
+
+/**
+ * Write a raw value into the image through the map (compile-time row)
+ * @tparam Id Register id
+ * @param meter Meter index
+ * @param raw Raw value bits
+ */
+template <MeterRegisterId Id>
+inline void setMeterRaw(uint8_t meter, uint64_t raw) {
+    uint16_t words[meterTypeWords(meterRegisterMap[Id].type)];
+    encodeMeterWords<meterRegisterMap[Id].type>(raw, meterRegisterMap[Id].order, words);
+    writeImageRegisters(meter, meterRegisterMap[Id].address, words, meterTypeWords(meterRegisterMap[Id].type));
+}
+
+/**
+ * Write an engineering value into the image through the map (compile-time row)
+ * @tparam Id Register id
+ * @param meter Meter index
+ * @param value Value in the row's unit
+ */
+template <MeterRegisterId Id>
+inline void setMeterValue(uint8_t meter, double value) {
+    setMeterRaw<Id>(meter, meterRawFromValue(meterRegisterMap[Id], value));
+}
+
+/**
+ * Encode a raw value of a row into an image write (for writeImageBatch)
+ * @param id Register id
+ * @param raw Raw value bits
+ * @param write Output register range
+ * @return true if id is valid
+ */
+bool encodeMeterWrite(uint8_t id, uint64_t raw, ImageWrite* write);
+
+/**
+ * Convert raw bits of a row to an engineering value
+ * @param row Register-map row
+ * @param raw Raw value bits
+ * @return Value in the row's unit
+ */
+double meterValueFromRaw(const MeterRegister& row, uint64_t raw);
+
+/**
+ * Read the raw value of a row from the image
+ * @param meter Meter index
+ * @param id Register id
+ * @param raw Output raw value bits
+ * @return true if id is valid
+ */
+bool getMeterRaw(uint8_t meter, uint8_t id, uint64_t* raw);
+
+/**
+ * Read the engineering value of a row from the image
+ * @param meter Meter index
+ * @param id Register id
+ * @return Value in the row's unit (0 for an invalid id)
+ */
+double getMeterValue(uint8_t meter, uint8_t id);
+
+/**
+ * Write a raw value by runtime id
+ * @param meter Meter index
+ * @param id Register id
+ * @param raw Raw value bits
+ * @return true if id is valid
+ */
+bool setMeterRawById(uint8_t meter, uint8_t id, uint64_t raw);
+
+/**
+ * Write an engineering value by runtime id
+ * @param meter Meter index
+ * @param id Register id
+ * @param value Value in the row's unit
+ * @return true if id is valid
+ */
+bool setMeterValueById(uint8_t meter, uint8_t id, double value);
+
+/**
+ * Find a register by name
+ * @param name Register name (case-insensitive)
+ * @return Register id, or -1 if not found
+ */
+int findMeterRegister(const char* name);
+
+/**
+ * Mark read-only registers in a meter's register image
+ * @param meter Meter index
+ */
+void initMeterRegisterMap(uint8_t meter);
+
+/**
+ * Print the register map with current register contents
+ * @param meter Meter index
+ */
+void printMeterRegisterMap(uint8_t meter);
+
+#endif // METER_REGISTER_MAP_H
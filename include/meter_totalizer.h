@@ -0,0 +1,62 @@
+#ifndef METER_TOTALIZER_H
+#define METER_TOTALIZER_H
+
+#include <Arduino.h>
+
+// Flow totalizer simulation
+// Integrates the flow register (reg 6, m3/h) into 64-bit forward and reverse totals
+// on a fixed tick, like a real meter. Positive flow adds to consumption (reg 8),
+// negative flow adds to reverse consumption (reg 14) and sets direction (reg 42).
+// All three registers are written in one image update per tick, so a master never
+// reads a half-updated value. Values set by command or by the master are picked
+// up as the new starting point of the totals. Each virtual meter has its own totals.
+
+#define TOTALIZER_TICK_MS 100              // Integration tick
+#define TOTALIZER_MICRO_PER_UNIT 1000000ULL // Totals are kept in 1e-6 m3
+#define TOTALIZER_TASK_STACK 3072
+#define TOTALIZER_TASK_PRIORITY 2          // Above loop() (1), below Modbus receiver (3)
+#define TOTALIZER_TASK_CORE 1
+
+/**
+ * Create the totalizer task (all meters stopped)
+ */
+void initTotalizer();
+
+/**
+ * Start integrating flow (totals start from the current register values)
+ * @param meter Meter index
+ */
+void startTotalizer(uint8_t meter);
+
+/**
+ * Stop integrating, registers keep their last values
+ * @param meter Meter index
+ */
+void stopTotalizer(uint8_t meter);
+
+/**
+ * Stop and clear a meter's totalizer (meter added or removed)
+ * @param meter Meter index
+ */
+void resetTotalizer(uint8_t meter);
+
+/**
+ * Check whether a meter's totalizer is running
+ * @param meter Meter index
+ * @return true if running
+ */
+bool isTotalizerRunning(uint8_t meter);
+
+/**
+ * Get memory used by one meter's totalizer
+ * @return Bytes per meter
+ */
+size_t getTotalizerBytes();
+
+/**
+ * Print totals and tick statistics
+ * @param meter Meter index
+ */
+void printTotalizerStatus(uint8_t meter);
+
+#endif // METER_TOTALIZER_H
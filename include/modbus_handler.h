@@ -15,8 +15,9 @@
 enum DataType {
     TYPE_U64,
     TYPE_FLOAT,
-    TYPE_INT16
-}; // Construct our data type, as I checked the excel only found these 3
+    TYPE_INT16,
+    TYPE_U32
+}; // Construct our data type, as I checked the excel only found these 3 (+ UNIT32 counters)
 
 // Modbus instance
 extern ModbusRTU mb;
@@ -70,7 +71,8 @@ void setReverseConsumptionValue(uint32_t reverseConsumption);
 void setFlowDirectionValue(uint32_t direction);
 
 // Set all DAC outputs to zero when Modbus is activated
-void setAllDACsToZero();
+// Returns false if the zeroing did not reach the DACs in time (relays must not move)
+bool setAllDACsToZero();
 
 // Turn off all relays to isolate outputs when Modbus is activated
 void turnOffAllRelays();
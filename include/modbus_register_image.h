@@ -0,0 +1,142 @@
+#ifndef MODBUS_REGISTER_IMAGE_H
+#define MODBUS_REGISTER_IMAGE_H
+
+#include <Arduino.h>
+
+// Flat holding-register image for the meter emulator
+// Holding registers 0..MODBUS_IMAGE_SIZE-1 live in one directly indexed array.
+// The RTU receiver (modbus_rtu_receiver.h) answers read (FC03), write (FC06,
+// FC16) and read/write (FC23) requests from it directly instead of the Modbus library's per-register
+// linear search, so a multi-register read is a bounds check plus one copy.
+// Other function codes and addresses outside the image get exception responses.
+// Each virtual meter (virtual_meters.h) has its own fixed-size image, selected by
+// meter index (0 to MODBUS_MAX_METERS-1).
+
+#define MODBUS_IMAGE_SIZE 128          // Holding registers 0-127 (meter map 6-45, output control 100-123)
+#define MODBUS_MAX_READ_REGS 125       // Modbus limit for FC03
+#define MODBUS_MAX_WRITE_REGS 123      // Modbus limit for FC16
+#define MODBUS_MAX_RW_WRITE_REGS 121   // Modbus limit for the write part of FC23
+#define MODBUS_MAX_METERS 4            // Virtual meters (slave IDs) served by one device
+
+// Request counters
+struct ModbusImageStats {
+    uint32_t reads;        // FC03 requests served from the image
+    uint32_t writes;       // FC06/FC16/FC23 requests served from the image
+    uint32_t exceptions;   // Exception responses built
+};
+
+// One register range of a batched write
+struct ImageWrite {
+    uint16_t address;      // First register address
+    uint8_t count;         // Number of registers (1-4)
+    uint16_t words[4];     // Register values
+};
+
+// Write hook: called after a master write has been stored in a watched range
+// Returns 0 to accept the write, or a Modbus exception code to reject it (the whole
+// written range, also outside the watched one, then gets its previous contents back
+// and the master gets the exception).
+// Runs in the receiver task outside the image lock, so it may read the image and
+// drive outputs.
+typedef uint8_t (*ImageWriteHook)(uint8_t meter, uint16_t address, uint16_t count);
+
+// Optional lock around a watched write: taken before the write is stored and released
+// after the hook returned (and a rejected range was restored), so nothing that holds it
+// can rewrite the range in between. Returns false if busy (answered with exception 06).
+typedef bool (*ImageWriteLock)();
+typedef void (*ImageWriteUnlock)();
+
+/**
+ * Clear all images and register access flags
+ */
+void initModbusRegisterImage();
+
+/**
+ * Clear one meter's image (registers, access flags and counters)
+ * @param meter Meter index
+ */
+void clearModbusImage(uint8_t meter);
+
+/**
+ * Write consecutive registers (all words updated together, no partial value visible)
+ * @param meter Meter index
+ * @param address First register address
+ * @param words Register values
+ * @param count Number of registers
+ * @return true if the whole range is inside the image
+ */
+bool writeImageRegisters(uint8_t meter, uint16_t address, const uint16_t* words, uint8_t count);
+
+/**
+ * Write several register ranges as one update (a master never sees some updated and others not)
+ * @param meter Meter index
+ * @param writes Register ranges
+ * @param count Number of ranges
+ * @return true if all ranges are inside the image (nothing is written otherwise)
+ */
+bool writeImageBatch(uint8_t meter, const ImageWrite* writes, uint8_t count);
+
+/**
+ * Set whether the Modbus master may write a register range
+ * Registers are writable by default; writes touching a read-only register get exception 02.
+ * @param meter Meter index
+ * @param address First register address
+ * @param count Number of registers
+ * @param writable true to allow FC06/FC16/FC23
+ * @return true if the whole range is inside the image
+ */
+bool setImageRegisterAccess(uint8_t meter, uint16_t address, uint8_t count, bool writable);
+
+/**
+ * Watch a register range of one meter for master writes (one hook for the device)
+ * @param meter Meter index
+ * @param address First register address
+ * @param count Number of registers
+ * @param hook Function called with the written range (clipped to the watched range), nullptr to remove
+ * @param lock Taken around store and hook, nullptr for none
+ * @param unlock Releases lock
+ * @return true if the whole range is inside the image
+ */
+bool setImageWriteHook(uint8_t meter, uint16_t address, uint16_t count, ImageWriteHook hook,
+                       ImageWriteLock lock = nullptr, ImageWriteUnlock unlock = nullptr);
+
+/**
+ * Read consecutive registers (consistent snapshot)
+ * @param meter Meter index
+ * @param address First register address
+ * @param words Output register values
+ * @param count Number of registers
+ * @return true if the whole range is inside the image
+ */
+bool readImageRegisters(uint8_t meter, uint16_t address, uint16_t* words, uint8_t count);
+
+/**
+ * Build the response PDU for a request PDU (normal or exception response)
+ * @param meter Meter index
+ * @param request Request PDU (function code + data, no address/CRC)
+ * @param length Request PDU length
+ * @param response Output PDU buffer (at least 2 + 2 * MODBUS_MAX_READ_REGS bytes),
+ *                 may be the request buffer itself (request is parsed before it is overwritten)
+ * @return Response PDU length, 0 for an empty request or invalid meter
+ */
+uint8_t buildImageResponse(uint8_t meter, const uint8_t* request, uint8_t length, uint8_t* response);
+
+/**
+ * Get request counters
+ * @param meter Meter index
+ * @return Copy of current counters
+ */
+ModbusImageStats getModbusImageStats(uint8_t meter);
+
+/**
+ * Get memory used by one meter's image
+ * @return Bytes per meter (registers, access flags, counters)
+ */
+size_t getModbusImageBytes();
+
+/**
+ * Benchmark register image against the library's register search path (on meter 0)
+ */
+void runModbusImageBenchmark();
+
+#endif // MODBUS_REGISTER_IMAGE_H
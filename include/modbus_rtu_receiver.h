@@ -0,0 +1,100 @@
+#ifndef MODBUS_RTU_RECEIVER_H
+#define MODBUS_RTU_RECEIVER_H
+
+#include <Arduino.h>
+
+// Event-driven Modbus RTU slave receiver
+// The UART hardware RX timeout marks the end of a frame (line idle for
+// MODBUS_RX_TIMEOUT_SYMBOLS character times, >= the 3.5 character RTU gap).
+// The UART event callback only wakes a dedicated task, which assembles the frame,
+// checks address and CRC and answers from the register image. Response time no
+// longer depends on loop(), USB command handling or its delay().
+// The pipeline never allocates: one static frame buffer holds the request and the
+// response built in place over it, and the CRC is computed while the bytes are
+// copied out of the UART driver (no malloc/free per frame as in ModbusRTU::task()).
+// measureModbusHeap() (USB command modbus_heap) measures both pipelines on the device.
+
+#define MODBUS_RX_TIMEOUT_SYMBOLS 4        // End of frame after 4 idle characters
+#define MODBUS_RX_BUFFER_SIZE 512          // UART driver RX ring buffer
+#define MODBUS_RTU_MAX_FRAME 256           // Largest RTU frame (address + PDU + CRC)
+#define MODBUS_RTU_TASK_STACK 4096
+#define MODBUS_RTU_TASK_PRIORITY 3         // Above loop() (1), below DAC queue (4) and sample clock (5)
+#define MODBUS_RTU_TASK_CORE 1             // Same core as loop(), sample clock and DAC queue run on core 0
+
+// Receiver statistics
+struct ModbusReceiverStats {
+    uint32_t frames;          // Complete frames received
+    uint32_t responses;       // Responses sent
+    uint32_t broadcasts;      // Broadcast requests (no response)
+    uint32_t otherAddress;    // Frames for other slaves
+    uint32_t crcErrors;       // Frames dropped for bad CRC or short length
+    uint32_t overruns;        // Frames longer than MODBUS_RTU_MAX_FRAME
+    uint32_t lastLatencyUs;   // End-of-frame event to response queued, last frame
+    uint32_t maxLatencyUs;    // Worst case since last clear
+    uint64_t totalLatencyUs;  // Sum for average
+};
+
+// Heap measurement of one RTU pipeline over a number of frames
+struct ModbusHeapSample {
+    uint32_t frames;          // Frames seen during the measurement
+    uint32_t freeBefore;      // Free heap before the first frame
+    uint32_t freeAfter;       // Free heap after the last frame
+    uint32_t minFree;         // Lowest free heap sampled while a frame was in flight
+    uint32_t lowWaterBefore;  // Heap low-water mark since boot, before
+    uint32_t lowWaterAfter;   // Heap low-water mark since boot, after
+    uint32_t largestBlock;    // Largest allocatable block after (fragmentation)
+};
+
+#define MODBUS_HEAP_TIMEOUT_MS 60000       // Longest wait per pipeline in measureModbusHeap()
+
+/**
+ * Attach the receiver to Serial1 and start the receive task (call after Serial1.begin())
+ */
+void initModbusReceiver();
+
+/**
+ * Detach the receiver from Serial1 so another reader can use the port for a while
+ * (the receive task stays idle until attachModbusReceiver())
+ */
+void detachModbusReceiver();
+
+/**
+ * Reattach the receiver to Serial1 (bytes left in the RX buffer are dropped)
+ */
+void attachModbusReceiver();
+
+/**
+ * Compute Modbus RTU CRC16 (send low byte first)
+ * @param data Frame bytes
+ * @param length Number of bytes
+ * @return CRC value
+ */
+uint16_t modbusCrc16(const uint8_t* data, uint16_t length);
+
+/**
+ * Get receiver statistics
+ * @return Copy of current statistics
+ */
+ModbusReceiverStats getModbusReceiverStats();
+
+/**
+ * Clear receiver statistics
+ */
+void clearModbusReceiverStats();
+
+/**
+ * Print receiver, heap and register image statistics
+ */
+void printModbusReceiverStats();
+
+/**
+ * Measure heap use of ModbusRTU::task() and of this receiver over the same traffic
+ * Runs the library pipeline from the calling task (receiver detached) for the given
+ * number of frames, then this receiver for as many, and prints both. Needs a master
+ * polling the slave meanwhile (e.g. tools/modbus_rtt.py).
+ * @param frames Frames per pipeline
+ * @param timeoutMs Longest wait per pipeline
+ */
+void measureModbusHeap(uint32_t frames, uint32_t timeoutMs = MODBUS_HEAP_TIMEOUT_MS);
+
+#endif // MODBUS_RTU_RECEIVER_H
@@ -0,0 +1,142 @@
+#ifndef OUTPUT_CONTROL_H
+#define OUTPUT_CONTROL_H
+
+#include <Arduino.h>
+
+// Modbus control plane for the analog outputs
+// Holding registers 100-123 of meter 0 (the first virtual meter) command the three
+// signals, one 8-register block per signal (FLOATs in 1-0-3-2 word order):
+//
+//   Register      SIG1  SIG2  SIG3  Content
+//   MODE           100   108   116  0 = voltage, 1 = current
+//   WAVEFORM       101   109   117  0 = DC setpoint, 1 = sine
+//   SETPOINT       102   110   118  FLOAT, V (0-10) or mA (0-25); sine center
+//   AMPLITUDE      104   112   120  FLOAT, sine peak amplitude in V or mA
+//   PERIOD         106   114   122  FLOAT, sine period in seconds (1-60)
+//
+// The block mirrors the real output state: USB (and RS-485) commands refresh it when
+// they finish, so writing one field re-applies the others with their current values.
+// Signals driven by waveform playback or a profile report WAVEFORM 2 (not writable).
+// A write (FC06, FC16, FC23) is checked for every signal it touches before anything
+// is applied; an invalid block is rejected with exception 03 and keeps its previous
+// contents. Accepted writes go through the normal output path:
+//   1. Signals changing mode: the outgoing DAC is zeroed and the queue flushed
+//      before the relay switches (break-before-make, as the MODE command).
+//   2. All DC setpoints of the write are committed in one DAC frame, sine signals
+//      are armed and started together on the same sample tick.
+// One FC16/FC23 covering several blocks therefore updates several signals at once.
+// If the zeroing does not reach the DAC in time, no relay moves and the write is
+// answered with exception 04. Outputs are changed under the output lock shared with
+// the command paths in loop(); if it is held longer than OUTPUT_LOCK_TIMEOUT_MS the
+// write is answered with exception 06 (busy).
+// FLOATs must be written whole (FC16/FC23); half a FLOAT is validated as written.
+// The block is writable in analog mode only: Modbus (meter) mode isolates the
+// outputs, the block is cleared and answers writes with exception 02.
+
+#define OUTPUT_CONTROL_METER 0          // Virtual meter carrying the block
+#define OUTPUT_CONTROL_BASE 100         // First register (SIG1 MODE)
+#define OUTPUT_CONTROL_STRIDE 8         // Registers per signal
+#define OUTPUT_CONTROL_REGS (3 * OUTPUT_CONTROL_STRIDE)
+
+// Register offsets inside a signal's block
+#define OUTPUT_REG_MODE 0
+#define OUTPUT_REG_WAVEFORM 1
+#define OUTPUT_REG_SETPOINT 2
+#define OUTPUT_REG_AMPLITUDE 4
+#define OUTPUT_REG_PERIOD 6
+
+// Register values
+#define OUTPUT_MODE_VOLTAGE 0
+#define OUTPUT_MODE_CURRENT 1
+#define OUTPUT_WAVEFORM_DC 0
+#define OUTPUT_WAVEFORM_SINE 1
+#define OUTPUT_WAVEFORM_OTHER 2         // Reported only: waveform playback or profile
+
+#define OUTPUT_LOCK_TIMEOUT_MS 100      // Longest wait of a Modbus write for the output lock
+
+// One signal's target state (shared by the Modbus block and RS-485 batch commands)
+struct OutputCommand {
+    char mode;          // 'v' or 'c'
+    bool sine;          // Sine instead of DC setpoint
+    float setpoint;     // DC value or sine center, V or mA
+    float amplitude;    // Sine peak amplitude
+    float period;       // Sine period in seconds
+};
+
+/**
+ * Check a target state against the output ranges
+ * @param command Target state
+ * @return true if setpoint (and sine parameters) are in range
+ */
+bool isOutputCommandValid(const OutputCommand& command);
+
+/**
+ * Apply target states to several signals together (caller holds the output lock)
+ * Mode changes are break-before-make, DC setpoints go out in one DAC frame and
+ * sine signals start on one sample tick. Commands must be valid.
+ * @param commands Target state per signal (index 0-2)
+ * @param channelMask Bit n set = apply commands[n]
+ * @return false if the zeroing before a relay switch timed out (no relay moved)
+ */
+bool applyOutputCommands(const OutputCommand* commands, uint8_t channelMask);
+
+/**
+ * Apply target states with the DC setpoints posted on a given sample tick (deferred latch)
+ * Mode changes still switch relays immediately (break-before-make); only the
+ * setpoint frame waits for the tick. Shaped channels start ramping on the same tick.
+ * @param commands Target state per signal (index 0-2)
+ * @param channelMask Bit n set = apply commands[n]
+ * @param tick Sample tick index on which the setpoints are written
+ * @return false if the zeroing before a relay switch timed out (no relay moved)
+ */
+bool applyOutputCommandsAtTick(const OutputCommand* commands, uint8_t channelMask, uint32_t tick);
+
+/**
+ * Attach the control block to the register image (call after initVirtualMeters())
+ */
+void initOutputControl();
+
+/**
+ * Allow or refuse master writes to the control block
+ * @param writable true in analog mode; false clears the block and makes it read-only
+ */
+void setOutputControlWritable(bool writable);
+
+/**
+ * Take the output lock (signal modes, relays, setpoints and source ownership)
+ * @param timeoutMs Longest wait
+ * @return true if taken
+ */
+bool lockOutputs(uint32_t timeoutMs);
+
+/**
+ * Release the output lock
+ */
+void unlockOutputs();
+
+/**
+ * Copy the real output state into the control block (caller holds the output lock)
+ */
+void syncOutputControl();
+
+// Holds the output lock for a scope and refreshes the control block on release
+// (wraps command handling in loop())
+class OutputLockScope {
+public:
+    OutputLockScope() { locked = lockOutputs(portMAX_DELAY); }
+    ~OutputLockScope() {
+        if (locked) {
+            syncOutputControl();
+            unlockOutputs();
+        }
+    }
+private:
+    bool locked;
+};
+
+/**
+ * Print the control block contents
+ */
+void printOutputControl();
+
+#endif // OUTPUT_CONTROL_H
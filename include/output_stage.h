@@ -0,0 +1,83 @@
+#ifndef OUTPUT_STAGE_H
+#define OUTPUT_STAGE_H
+
+#include <Arduino.h>
+#include "dac_controller.h"
+
+// Output shaping stage (slew-rate limiter + first-order smoothing filter)
+// Sits between setpoint producers and the DAC output queue and runs on the sample
+// clock in Q16 fixed-point DAC codes. Waveforms and profiles pass through it in the
+// sample tick; manual setpoints are handed to it with postSetpointCode().
+// Per channel: maximum slew rate in V/s or mA/s (channel's current mode) and an
+// optional smoothing time constant. Both default to off (pass-through).
+// Safety writes (zeroing on stop or mode change) bypass the stage; the stage
+// notices them, drops the ramp it was running and holds the new output value
+// until the next setpoint, which ramps from there.
+// Disabling a channel's stage commits its target: a ramp in progress or a pending
+// manual setpoint goes to the DAC on the next tick instead of being frozen or dropped.
+
+/**
+ * Initialize output stage (all channels pass-through)
+ */
+void initOutputStage();
+
+/**
+ * Set maximum slew rate of a channel
+ * @param channel Signal channel (0-2)
+ * @param rate V/s in voltage mode, mA/s in current mode, 0 = unlimited
+ */
+void setOutputSlewRate(uint8_t channel, float rate);
+
+/**
+ * Set smoothing filter time constant of a channel
+ * @param channel Signal channel (0-2)
+ * @param tauSeconds First-order time constant in seconds, 0 = off
+ */
+void setOutputFilter(uint8_t channel, float tauSeconds);
+
+/**
+ * Check if a channel shapes its output
+ * @param channel Signal channel (0-2)
+ * @return true if slew limit or filter is enabled
+ */
+bool isOutputStageEnabled(uint8_t channel);
+
+/**
+ * Post a manual setpoint: shaped on the sample clock if the stage is enabled,
+ * otherwise posted to the DAC output queue directly
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' for voltage, 'c' for current
+ * @param code DAC code (0-32767)
+ */
+void postSetpointCode(uint8_t channel, char mode, uint16_t code);
+
+/**
+ * Post a manual setpoint that the stage takes over on a given sample tick
+ * (same as postSetpointCode() if the stage is off: the caller schedules the code)
+ * A later postSetpointCode() for the channel replaces it.
+ * @param channel Signal channel (0-2)
+ * @param mode 'v' for voltage, 'c' for current
+ * @param code DAC code (0-32767)
+ * @param tick Sample tick on which the ramp towards the code starts
+ */
+void postSetpointCodeAtTick(uint8_t channel, char mode, uint16_t code, uint32_t tick);
+
+/**
+ * Shape a tick's output frame in place (called from the sample clock task after all sources rendered)
+ * @param frame Output frame shared by all signal sources
+ * @param ticks Number of sample ticks due since last call (slew and filter advance by all of them)
+ */
+void applyOutputStage(DacFrame* frame, uint32_t ticks);
+
+/**
+ * Print output stage settings and state
+ */
+void printOutputStageStatus();
+
+/**
+ * Parse output stage commands
+ * Format: stage <signal> slew <rate|off> | stage <signal> filter <tau|off> | stage <signal> off | stage status
+ */
+void parseOutputStageCommand(String input);
+
+#endif // OUTPUT_STAGE_H
@@ -0,0 +1,86 @@
+#ifndef PROFILE_SEQUENCER_H
+#define PROFILE_SEQUENCER_H
+
+#include <Arduino.h>
+#include "dac_controller.h"
+
+// Setpoint Profile Sequencer (Analog Mode Only)
+// Runs a list of segments per channel from the sample clock, replacing
+// host-scripted sequences of manual commands with on-device timing.
+// Segments:
+//   STEP value        - jump to value
+//   RAMP value time   - linear ramp from the current value to value over time (s)
+//   HOLD time         - keep the current value for time (s)
+//   LOOP n            - repeat the segments since the previous LOOP (or the start) n times in total, 0 = forever
+// All channels loaded in one PROFILE LOAD line start in the same sample tick.
+
+#define PROFILE_MAX_SEGMENTS 32     // Segments per channel
+
+/**
+ * Initialize profile sequencer
+ */
+void initProfileSequencer();
+
+/**
+ * Load a profile for one channel from its segment list (channel must be idle)
+ * @param signal: Signal number (1-3)
+ * @param mode: 'v' for voltage, 'c' for current
+ * @param segments: Segment list separated by ';', e.g. "STEP 0; RAMP 10 5; HOLD 2; LOOP 3"
+ * @return true if profile was parsed and stored
+ */
+bool loadProfile(uint8_t signal, char mode, String segments);
+
+/**
+ * Start loaded profiles on several channels in the same sample tick
+ * @param signalMask: Bit n set = start signal n+1
+ * @return true if at least one channel was started
+ */
+bool startProfiles(uint8_t signalMask);
+
+/**
+ * Stop profile execution, the output keeps its last value
+ * @param signal: Signal number (1-3), 0 to stop all channels
+ */
+void stopProfile(uint8_t signal);
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ * @param channel: Channel number (0-2)
+ */
+void releaseProfileChannel(uint8_t channel);
+
+/**
+ * Render profile setpoints into the tick's output frame (called from the sample clock task)
+ * @param frame: Output frame shared by all signal sources
+ * @param ticks: Number of sample ticks due since last call
+ */
+void renderProfiles(DacFrame* frame, uint32_t ticks);
+
+/**
+ * Check if a profile is running on specific channel
+ * @param channel: Channel number (0-2)
+ * @return true if a profile is running on this channel
+ */
+bool isProfileActiveOnChannel(uint8_t channel);
+
+/**
+ * Print profile status
+ */
+void getProfileStatus();
+
+/**
+ * Parse profile commands
+ * Format: PROFILE LOAD/START/STOP/STATUS ...
+ */
+void parseProfileCommand(String input);
+
+// Command examples:
+// PROFILE LOAD 1 V STEP 0; RAMP 10 5; HOLD 2; RAMP 0 5; LOOP 3
+// PROFILE LOAD 1 V RAMP 10 5; HOLD 1 | 2 C STEP 4; HOLD 1; STEP 20; HOLD 1; LOOP 0
+//                                   // Several channels in one line, separated by '|'
+// PROFILE START                     // Start all loaded channels in the same tick
+// PROFILE START 1 3                 // Start SIG1 and SIG3 together
+// PROFILE STOP [signal]             // Stop, output keeps its last value
+// PROFILE STATUS
+
+#endif // PROFILE_SEQUENCER_H
@@ -12,6 +12,31 @@
 #define CMD_GET_STATUS 0x30
 #define CMD_SINE_WAVE 0x40
 #define CMD_STOP_SINE 0x41
+#define CMD_SET_OUTPUTS 0x50     // Batch: modes and setpoints of several signals, one DAC commit
+#define CMD_STAGE_OUTPUTS 0x51   // Batch stored as pending, outputs unchanged
+#define CMD_LATCH_OUTPUTS 0x52   // Commit pending values (normally broadcast to all modules)
+
+// CMD_SET_OUTPUTS request: [CHANNEL_MASK] then per set bit (SIG1 first): [MODE][VALUE_HI][VALUE_LO]
+//   MODE 0 = voltage, 1 = current; VALUE in 0.01 V or 0.01 mA (big endian)
+// All signals are checked first; nothing changes if one is invalid. Answered with one
+// compact status frame instead of an ack (no answer to broadcasts):
+//   [RESULT][MODE_BITS][RELAY_BITS][SOURCE_BITS][SIG1_HI][SIG1_LO][SIG2_HI][SIG2_LO][SIG3_HI][SIG3_LO]
+//   MODE_BITS bit n = SIGn+1 in current mode, RELAY_BITS bits 0-5 = relays 1-6,
+//   SOURCE_BITS bit n = sine, waveform or profile running on SIGn+1, SIGx = setpoint in 0.01 V/mA
+#define RS485_BATCH_ENTRY_LENGTH 3
+#define RS485_COMPACT_STATUS_LENGTH 10
+
+// Two-phase synchronized update for a rack of modules
+// CMD_STAGE_OUTPUTS (same payload as CMD_SET_OUTPUTS) is sent to each device ID and
+// only stores the values; staging again replaces the signals it names. One broadcast
+// CMD_LATCH_OUTPUTS (device 0xFF, no data) then commits them everywhere: each module
+// writes its staged setpoints on the sample tick RS485_LATCH_DELAY_MS after the end
+// of the latch frame (the receive event that delivered its last byte, recorded with
+// the frame, not when loop() gets to it), so all modules change on the same tick
+// relative to the frame. Signals with an output stage start their ramp on that tick.
+// Signals that change mode switch their relays when the latch is decoded. Compact
+// status replies are sent to addressed stage/latch frames only.
+#define RS485_LATCH_DELAY_MS 20  // Must cover the worst-case loop() delay until decoding
 
 // Response codes
 #define RESP_SUCCESS 0x01
@@ -101,4 +126,37 @@ bool handleSineWaveCommand(const uint8_t* data, uint8_t length);
  */
 bool handleStopSineCommand(const uint8_t* data, uint8_t length);
 
+/**
+ * Handle batch output command (sends its own compact status response)
+ * @param data Command data
+ * @param length Data length
+ * @return true if successful
+ */
+bool handleSetOutputsCommand(const uint8_t* data, uint8_t length);
+
+/**
+ * Handle stage command (values kept until CMD_LATCH_OUTPUTS)
+ * @param data Command data
+ * @param length Data length
+ * @return true if successful
+ */
+bool handleStageOutputsCommand(const uint8_t* data, uint8_t length);
+
+/**
+ * Handle latch command (commit staged values on a common sample tick)
+ * @param data Command data
+ * @param length Data length
+ * @param rxTick Sample tick of the receive event that completed the latch frame
+ * @return true if successful
+ */
+bool handleLatchOutputsCommand(const uint8_t* data, uint8_t length, uint32_t rxTick);
+
+/**
+ * Build the compact status response
+ * @param result Response code (RESP_*)
+ * @param status Output buffer (RS485_COMPACT_STATUS_LENGTH bytes)
+ * @return Number of bytes written
+ */
+uint8_t buildCompactStatus(uint8_t result, uint8_t* status);
+
 #endif // RS485_COMMAND_HANDLER_H 
\ No newline at end of file
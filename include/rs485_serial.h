@@ -5,15 +5,74 @@
 #include <HardwareSerial.h>
 
 // RS-485 Serial Configuration - Work mode receiving interface (receiving external RS-485 signals)
-#define RS485_SERIAL_NUM 1        // Use Serial1 for receiving external RS-485
+#define RS485_SERIAL_NUM 2        // UART2 for receiving external RS-485 (UART1 is the Modbus port)
 #define RS485_TX_PIN 19           // GPIO 19 for TX (另一路RS-485)
 #define RS485_RX_PIN 18           // GPIO 18 for RX (另一路RS-485)
 #define RS485_BAUDRATE 19200      // Baud rate
 #define RS485_PARITY SERIAL_8E1   // 8 data bits, Even parity, 1 stop bit
+#define RS485_DE_PIN -1           // Transceiver DE/RE GPIO, -1 = auto-direction transceiver
+
+// UART1 (Serial1, GPIO 16/17) runs the Modbus RTU slave and its receive task; both
+// links install their own driver and receive callback, so they cannot share a UART
+#if RS485_SERIAL_NUM == 1
+#error "RS485_SERIAL_NUM must not be 1: UART1 is the Modbus RTU port (modbus_handler.h)"
+#endif
 
 // Buffer sizes
-#define RS485_BUFFER_SIZE 64      // Receive buffer size
+#define RS485_BUFFER_SIZE 64      // Frame assembly buffer (decoded frame body)
 #define RS485_MAX_COMMAND_LENGTH 32
+#define RS485_UART_RX_BUFFER 512  // UART driver RX buffer
+#define RS485_RX_RING_SIZE 1024   // Receive ring, power of two (~90 ms of data at 115200 baud)
+#define RS485_UART_TX_BUFFER 256  // UART driver TX buffer (several complete response frames)
+#define RS485_RX_EVENT_SLOTS 64   // Receive events remembered for frame timing, power of two
+
+// Receive path
+// The UART receive event (FIFO threshold or RX timeout) copies everything the driver
+// holds into a single-producer/single-consumer ring; processRS485Commands() decodes
+// from the ring at its own pace. Producer and consumer each own one free-running
+// index, so neither side takes a lock. Bytes that do not fit are dropped and counted;
+// the frame decoder then rejects the damaged frame and resyncs on the next one.
+// Each receive event also records the sample tick and the ring position it filled
+// up to (a second SPSC ring), so a decoded command carries the tick of the event
+// that delivered its last byte, not of whatever arrived after it.
+
+// Transmit path
+// A response is built as one complete frame and handed to the UART driver with a
+// single write that only copies it into the driver's TX buffer; nothing waits for
+// the line. With RS485_DE_PIN set, the UART runs in RS-485 half-duplex mode and
+// drives DE/RE itself (RTS output): asserted while sending, released back to
+// receive by the transmit-complete interrupt.
+
+// Frame formats
+// CRC (default): [0x7E][LEN][DEVICE_ID][COMMAND][DATA...][CRC_LO][CRC_HI]
+//   LEN = bytes from DEVICE_ID to the end of DATA (2 to RS485_MAX_COMMAND_LENGTH).
+//   CRC16 (Modbus polynomial 0xA001, initial 0xFFFF) over LEN..DATA, low byte first.
+//   After the start byte, 0x7E and 0x7D are sent as 0x7D followed by (byte ^ 0x20),
+//   so 0x7E only ever starts a frame and any payload value is allowed. The receiver
+//   decodes byte by byte (unstuffing, length and CRC in the same pass) and resyncs
+//   on the next 0x7E after an error.
+// Legacy: [0xAA][DEVICE_ID][COMMAND][DATA...][0x55], ends at the first 0x55 after
+//   four bytes, so DATA must not contain 0xAA or 0x55.
+#define RS485_FRAMING_LEGACY 0
+#define RS485_FRAMING_CRC 1
+#define RS485_DEFAULT_FRAMING RS485_FRAMING_CRC
+#define RS485_FRAME_START 0x7E
+#define RS485_FRAME_ESCAPE 0x7D
+#define RS485_FRAME_ESCAPE_XOR 0x20
+#define RS485_MAX_FRAME_LENGTH (1 + 2 * (RS485_MAX_COMMAND_LENGTH + 3)) // Start + everything stuffed
+
+// Link counters
+struct RS485LinkStats {
+    uint32_t frames;          // Complete frames (any device ID)
+    uint32_t crcErrors;       // CRC mismatches
+    uint32_t frameErrors;     // Bad length, bad escape or frame cut by a new start byte
+    uint32_t ringOverruns;    // Bytes dropped because the receive ring was full
+    uint32_t uartOverruns;    // UART FIFO or driver buffer overflows
+    uint32_t lineErrors;      // Parity, framing (stop bit) and break errors on the line
+    uint32_t ringHighWater;   // Highest ring fill level in bytes
+    uint32_t txFrames;        // Response frames handed to the UART
+    uint32_t txDropped;       // Responses dropped because the TX buffer was full
+};
 
 // Command structure
 struct RS485Command {
@@ -21,6 +80,7 @@ struct RS485Command {
     uint8_t commandType;          // Command type
     uint8_t data[RS485_MAX_COMMAND_LENGTH - 2]; // Command data
     uint8_t length;               // Total command length
+    uint32_t rxTick;              // Sample tick of the receive event that completed the frame
     bool valid;                   // Command validity flag
 };
 
@@ -29,14 +89,43 @@ struct RS485Command {
  */
 void initRS485Serial();
 
+/**
+ * Select the frame format for receiving and sending
+ * @param framing RS485_FRAMING_CRC or RS485_FRAMING_LEGACY
+ */
+void setRS485Framing(uint8_t framing);
+
+/**
+ * Get the frame format in use
+ * @return RS485_FRAMING_CRC or RS485_FRAMING_LEGACY
+ */
+uint8_t getRS485Framing();
+
+/**
+ * Get receive counters
+ * @return Copy of current counters
+ */
+RS485LinkStats getRS485LinkStats();
+
+/**
+ * Clear receive counters
+ */
+void clearRS485LinkStats();
+
+/**
+ * Print frame format and receive counters
+ */
+void printRS485LinkStatus();
+
 /**
  * Process incoming RS-485 commands from work mode interface
+ * Stops after the first command for this device; later bytes stay queued for the next call.
  * @return true if a valid command was received
  */
 bool processRS485Commands();
 
 /**
- * Send response via RS-485 work mode interface
+ * Send response via RS-485 work mode interface (returns without waiting for transmission)
  * @param deviceID Target device ID
  * @param commandType Command type
  * @param data Response data
@@ -52,7 +141,7 @@ RS485Command* getLastCommand();
 
 /**
  * Check if RS-485 is available
- * @return true if data is available
+ * @return true if received bytes are waiting to be decoded
  */
 bool isRS485Available();
 
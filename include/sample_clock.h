@@ -0,0 +1,58 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <Arduino.h>
+#include "sample_scheduler.h"
+
+// Hardware-timer-driven sample clock
+// A periodic hardware timer wakes a dedicated FreeRTOS task, which computes and
+// outputs waveform samples independently of USB and Modbus processing in loop().
+
+#define SAMPLE_CLOCK_TIMER_NUM 0           // Hardware timer group 0, timer 0
+#define SAMPLE_CLOCK_DEFAULT_HZ 100        // Default sample rate
+#define SAMPLE_CLOCK_MIN_HZ 1              // Slowest configurable rate
+#define SAMPLE_CLOCK_MAX_HZ 2000           // Fastest configurable rate
+#define SAMPLE_CLOCK_TASK_STACK 4096
+#define SAMPLE_CLOCK_TASK_PRIORITY 5       // Above loop() (priority 1)
+#define SAMPLE_CLOCK_TASK_CORE 0           // loop() runs on core 1
+
+// Sample callback, receives number of ticks due (normally 1)
+typedef void (*SampleTickCallback)(uint32_t ticks);
+
+/**
+ * Initialize sample clock timer and task
+ * @param callback Function called from the sample task on each tick
+ */
+void initSampleClock(SampleTickCallback callback);
+
+/**
+ * Change sample rate
+ * @param rateHz Sample rate in Hz (SAMPLE_CLOCK_MIN_HZ to SAMPLE_CLOCK_MAX_HZ)
+ * @return true if rate was accepted
+ */
+bool setSampleClockRate(uint32_t rateHz);
+
+/**
+ * Get effective sample rate (exact, derived from integer timer period)
+ * @return Sample rate in Hz
+ */
+float getSampleClockRate();
+
+/**
+ * Get sample period
+ * @return Sample period in microseconds
+ */
+uint32_t getSampleClockPeriodUs();
+
+/**
+ * Get scheduler statistics (tick count, missed ticks, jitter)
+ * @return Copy of scheduler state
+ */
+SampleScheduler getSampleClockStats();
+
+/**
+ * Clear jitter statistics
+ */
+void clearSampleClockStats();
+
+#endif // SAMPLE_CLOCK_H
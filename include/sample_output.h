@@ -0,0 +1,49 @@
+#ifndef SAMPLE_OUTPUT_H
+#define SAMPLE_OUTPUT_H
+
+#include <Arduino.h>
+#include "dac_controller.h"
+
+// Sample output pipeline
+// Runs on every sample clock tick: each signal source (sine generator,
+// waveform player, profile sequencer) renders its active channels into one shared DacFrame,
+// which is shaped by the output stage (slew limit / smoothing) and then posted
+// to the DAC output queue as a single frame.
+// A frame can also be scheduled for a given tick (deferred latch): it is merged
+// into that tick's frame after the output stage and goes out with it. Any other
+// path that posts to or takes over a channel before then cancels its scheduled code.
+
+/**
+ * Start the sample clock with the output pipeline as its tick handler
+ * (call after all signal sources are initialized)
+ */
+void initSampleOutput();
+
+/**
+ * Get the shared sample tick counter (index of the tick being or last rendered)
+ * All sources compute their output for a tick from this one timestamp.
+ * @return Sample tick index since the sample clock started
+ */
+uint32_t getSampleTick();
+
+/**
+ * Post codes together with a given sample tick
+ * Merges into codes already scheduled: channels in this frame replace theirs, the others keep them.
+ * @param frame Codes to write
+ * @param tick Sample tick index to post on; a tick that has already passed posts on the next one
+ */
+void scheduleSampleFrame(const DacFrame* frame, uint32_t tick);
+
+/**
+ * Drop a channel's scheduled codes (another path posts to or takes over the channel)
+ * @param channel Signal channel (0-2)
+ */
+void cancelScheduledChannel(uint8_t channel);
+
+/**
+ * Render all signal sources for one sample tick and post the frame
+ * @param ticks Number of sample ticks due since last call
+ */
+void onSampleTick(uint32_t ticks);
+
+#endif // SAMPLE_OUTPUT_H
@@ -0,0 +1,44 @@
+#ifndef SAMPLE_SCHEDULER_H
+#define SAMPLE_SCHEDULER_H
+
+#include <stdint.h>
+
+// Sample tick scheduler for waveform output
+// Tracks sample deadlines against a microsecond time source and reports how many
+// ticks are due. The hardware timer only wakes the sample task; this logic decides
+// what is due, so it can be driven by a virtual clock on a host build.
+// No Arduino dependencies.
+
+// Per-scheduler state and jitter statistics
+struct SampleScheduler {
+    uint32_t periodUs;        // Sample period in microseconds
+    uint32_t nextDeadlineUs;  // Time the next tick is due
+    uint32_t tickCount;       // Total ticks delivered (including skipped ones)
+    uint32_t missedTicks;     // Ticks that were due but serviced late in a batch
+    uint32_t lastLatenessUs;  // Most recent poll: distance from the oldest due deadline
+    uint32_t maxLatenessUs;   // Worst lateness seen since last reset
+};
+
+/**
+ * Reset scheduler with a new period, first tick due one period after nowUs
+ * @param scheduler Scheduler state
+ * @param periodUs Sample period in microseconds
+ * @param nowUs Current time in microseconds
+ */
+void sampleSchedulerReset(SampleScheduler* scheduler, uint32_t periodUs, uint32_t nowUs);
+
+/**
+ * Check how many ticks are due at nowUs and advance the deadline past them
+ * @param scheduler Scheduler state
+ * @param nowUs Current time in microseconds (wraps at 2^32)
+ * @return Number of ticks due (0 if next deadline not reached)
+ */
+uint32_t sampleSchedulerPoll(SampleScheduler* scheduler, uint32_t nowUs);
+
+/**
+ * Clear jitter statistics
+ * @param scheduler Scheduler state
+ */
+void sampleSchedulerClearStats(SampleScheduler* scheduler);
+
+#endif // SAMPLE_SCHEDULER_H
@@ -2,15 +2,20 @@
 #define SINE_WAVE_GENERATOR_H
 
 #include <Arduino.h>
+#include "dac_controller.h"
+#include "dds_engine.h"
 
 // Sine Wave Generator (Analog Mode Only)
 // This feature allows generation of sinusoidal waves with configurable parameters
-// Resolution: 0.25 seconds
+// Resolution: hardware-timer sample clock, 1-2000 Hz (default 100 Hz), phase-accumulator (DDS) synthesis
 // Period range: 1-60 seconds
 // Amplitude and center point: User configurable
 // Output modes: Voltage (0-10V), Current (0-25mA)
 // Safe ranges: Voltage 0-10V, Current 0-25mA (values are clamped to boundaries)
 // Multi-channel support: Each signal can have independent sine wave parameters
+// Chirp mode: frequency sweep between two periods (linear or log), phase continuous
+// Time base: all channels are computed from one shared sample tick counter; armed
+// channels started by SINE TRIGGER share the same epoch (plus per-channel phase offsets)
 
 /**
  * Initialize sine wave generator
@@ -25,8 +30,39 @@ void initSineWaveGenerator();
  * @param signal: Signal number (1-3)
  * @param mode: 'v' for voltage, 'c' for current
  * @param overshoot: Unused parameter (kept for compatibility)
+ * @param phaseDeg: Phase offset at start in degrees
  */
-void startSineWave(float amplitude, float period, float center, uint8_t signal, char mode, bool overshoot);
+void startSineWave(float amplitude, float period, float center, uint8_t signal, char mode, bool overshoot,
+                   float phaseDeg = 0.0f);
+
+/**
+ * Arm sine wave generation for a specific channel (configured but idle until triggered)
+ * Parameters as startSineWave()
+ * @param phaseDeg: Phase offset at trigger in degrees
+ */
+void armSineWave(float amplitude, float period, float center, uint8_t signal, char mode, float phaseDeg);
+
+/**
+ * Start (or arm) a frequency sweep between two periods with continuous phase
+ * @param amplitude: Peak amplitude from center point
+ * @param startPeriod: Period at sweep start in seconds (1-60s)
+ * @param endPeriod: Period at sweep end in seconds (1-60s)
+ * @param sweepSeconds: Sweep duration in seconds
+ * @param center: Center point of the sine wave
+ * @param signal: Signal number (1-3)
+ * @param mode: 'v' for voltage, 'c' for current
+ * @param shape: DDS_CHIRP_LINEAR or DDS_CHIRP_LOG
+ * @param endMode: DDS_CHIRP_ONCE, DDS_CHIRP_REPEAT or DDS_CHIRP_BOUNCE
+ * @param arm: true to wait for SINE TRIGGER
+ */
+void startSineChirp(float amplitude, float startPeriod, float endPeriod, float sweepSeconds, float center,
+                    uint8_t signal, char mode, uint8_t shape, uint8_t endMode, bool arm);
+
+/**
+ * Start all armed channels from one common epoch (the next sample tick)
+ * @return Number of channels started
+ */
+int triggerSineWaves();
 
 /**
  * Stop sine wave generation
@@ -35,15 +71,39 @@ void startSineWave(float amplitude, float period, float center, uint8_t signal,
 void stopSineWave(uint8_t signal);
 
 /**
- * Update sine wave output (call this in main loop)
+ * Render sine wave samples into the tick's output frame (called from the sample clock task)
+ * @param frame: Output frame shared by all signal sources
+ * @param ticks: Number of sample ticks due since last call
  */
-void updateSineWave();
+void renderSineWave(DacFrame* frame, uint32_t ticks);
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ * @param channel: Channel number (0-2)
+ */
+void releaseSineChannel(uint8_t channel);
+
+/**
+ * Set waveform sample rate
+ * @param rateHz: Sample rate in Hz (1-2000)
+ */
+void setSineSampleRate(uint32_t rateHz);
+
+/**
+ * Print sample clock rate and jitter statistics
+ */
+void printSampleClockStatus();
 
 /**
  * Get sine wave status
  */
 void getSineWaveStatus();
 
+/**
+ * Benchmark DDS engine against the float sin() path (accuracy and throughput)
+ */
+void runSineBenchmark();
+
 /**
  * Check if sine wave is active
  * @return true if sine wave is active
@@ -77,9 +137,17 @@ void parseSineWaveCommand(String input);
 // Command examples:
 // SINE START 5.0 2.0 5.0 1 V    // Start 5V amplitude, 2s period, center 5V, signal 1, voltage mode (output: 0-10V)
 // SINE START 3.0 1.5 2.5 2 C    // Start 3mA amplitude, 1.5s period, center 2.5mA, signal 2, current mode (output: 0-5.5mA, clamped)
+// SINE ARM 5.0 2.0 5.0 1 V 0    // Three-phase pattern: arm SIG1-3 at 0/120/240 degrees...
+// SINE ARM 5.0 2.0 5.0 2 V 120
+// SINE ARM 5.0 2.0 5.0 3 V 240
+// SINE TRIGGER                  // ...and start them together from one epoch
+// SINE CHIRP 5.0 10 1 60 5.0 1 V LOG REPEAT  // Log sweep 10s -> 1s period over 60s, repeating
+// SINE CHIRP 2.0 5 1 30 12 2 C LIN BOUNCE ARM // Linear sweep back and forth, start on SINE TRIGGER
 // SINE STOP                     // Stop all sine wave generation
 // SINE STOP 1                   // Stop sine wave on signal 1 only
 // SINE STATUS                   // Get current status
+// SINE BENCH                    // Compare DDS engine against float sin() path
+// SINE RATE 1000                // Set sample rate to 1 kHz (no argument: show rate and jitter)
 
 extern char signalModes[3];
 
@@ -0,0 +1,84 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include <Arduino.h>
+
+// Measurement trace replay
+// Recorded meter traces (timestamped flow, consumption, reverse, direction) are
+// streamed over USB serial in chunks (TRACE DATA) into a ring buffer while playback
+// runs, so the trace never has to fit in RAM. The host keeps the ring filled using
+// the free-slot count returned for each chunk. Playback is clocked on the device:
+// a record is applied when the elapsed time (times the speed factor) reaches its
+// timestamp, independent of when the host sent it. Each record updates registers
+// 6/8/14/42 of the meter selected at TRACE START in one image write.
+
+#define TRACE_RING_SIZE 256        // Records buffered on the device
+#define TRACE_TICK_MS 5            // Playback clock resolution
+#define TRACE_MAX_SPEED 1000.0f    // Fastest playback (x real time)
+#define TRACE_TASK_STACK 3072
+#define TRACE_TASK_PRIORITY 2      // Above loop() (1), below Modbus receiver (3)
+#define TRACE_TASK_CORE 1
+
+// One trace record
+struct TraceRecord {
+    uint32_t timeMs;        // Timestamp in the trace (ms, any origin)
+    float flow;             // Register 6
+    uint32_t consumption;   // Register 8
+    uint32_t reverse;       // Register 14
+    uint8_t direction;      // Register 42
+};
+
+/**
+ * Create the playback task (idle)
+ */
+void initTraceReplay();
+
+/**
+ * Clear the ring buffer and set playback speed
+ * @param speed Playback speed (1 = real time, 10 = ten times faster)
+ * @return true if speed is valid
+ */
+bool beginTrace(float speed);
+
+/**
+ * Add a record to the ring buffer
+ * @param record Trace record (timestamps must not decrease)
+ * @return true if stored, false if the ring is full or the timestamp goes backwards
+ */
+bool pushTraceRecord(const TraceRecord& record);
+
+/**
+ * Mark the end of the trace (playback finishes after the last record)
+ */
+void endTrace();
+
+/**
+ * Start playback from the first buffered record into the selected virtual meter
+ * @return true if started
+ */
+bool startTrace();
+
+/**
+ * Stop playback, registers keep their last values
+ */
+void stopTrace();
+
+/**
+ * Get free slots in the ring buffer
+ * @return Number of records that can still be pushed
+ */
+uint16_t getTraceFreeSlots();
+
+/**
+ * Print playback state
+ */
+void printTraceStatus();
+
+/**
+ * Parse trace commands
+ * Format: TRACE BEGIN/DATA/END/START/STOP/STATUS ...
+ * @param input Command string
+ */
+void parseTraceCommand(String input);
+
+#endif // TRACE_REPLAY_H
@@ -0,0 +1,83 @@
+#ifndef VIRTUAL_METERS_H
+#define VIRTUAL_METERS_H
+
+#include <Arduino.h>
+#include "modbus_register_image.h"
+
+// Virtual meters: one device answering as several Modbus slaves on the same bus
+// Each virtual meter has a slave ID, its own register image and its own totalizer.
+// A 256-entry table maps a unit ID directly to its meter, so dispatch is one
+// lookup per frame regardless of how many meters are configured.
+// USB measurement commands (flow, consumption, meter, totalizer, trace) act on the
+// selected meter; currentSlaveID follows the selection.
+
+#define VIRTUAL_METER_NONE 0xFF    // Unit ID not served
+
+/**
+ * Reset the table and create meter 0 with the given slave ID (call after initModbusRegisterImage)
+ * @param slaveID Slave ID of the first meter (1-247)
+ */
+void initVirtualMeters(uint8_t slaveID);
+
+/**
+ * Add a virtual meter with empty registers
+ * @param slaveID Slave ID (1-247, not yet used)
+ * @return Meter index, or VIRTUAL_METER_NONE if the ID is invalid/used or all meters are in use
+ */
+uint8_t addVirtualMeter(uint8_t slaveID);
+
+/**
+ * Remove a virtual meter (not the last remaining meter, not meter 0 with the output control block)
+ * @param slaveID Slave ID
+ * @return true if removed
+ */
+bool removeVirtualMeter(uint8_t slaveID);
+
+/**
+ * Change the slave ID of a meter (registers and totalizer are kept)
+ * @param meter Meter index
+ * @param slaveID New slave ID (1-247, not used by another meter)
+ * @return true if changed
+ */
+bool setVirtualMeterSlaveID(uint8_t meter, uint8_t slaveID);
+
+/**
+ * Look up the meter serving a unit ID
+ * @param slaveID Unit ID from the request
+ * @return Meter index, or VIRTUAL_METER_NONE
+ */
+uint8_t findVirtualMeter(uint8_t slaveID);
+
+/**
+ * Select the meter USB commands act on
+ * @param slaveID Slave ID of the meter
+ * @return true if selected
+ */
+bool selectVirtualMeter(uint8_t slaveID);
+
+/**
+ * Get the selected meter
+ * @return Meter index
+ */
+uint8_t getSelectedMeter();
+
+/**
+ * Check whether a meter index is in use
+ * @param meter Meter index
+ * @return true if active
+ */
+bool isVirtualMeterActive(uint8_t meter);
+
+/**
+ * Get the slave ID of a meter
+ * @param meter Meter index
+ * @return Slave ID, 0 if the meter is not active
+ */
+uint8_t getVirtualMeterSlaveID(uint8_t meter);
+
+/**
+ * Print meters, request counters and memory per meter
+ */
+void printVirtualMeters();
+
+#endif // VIRTUAL_METERS_H
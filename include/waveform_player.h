@@ -0,0 +1,92 @@
+#ifndef WAVEFORM_PLAYER_H
+#define WAVEFORM_PLAYER_H
+
+#include <Arduino.h>
+#include "dac_controller.h"
+
+// Arbitrary Waveform Playback (Analog Mode Only)
+// Replays a sample sequence per channel on the same sample clock as the sine generator.
+// Each channel has two sample buffers: one is played while the other is loaded.
+// A committed buffer becomes active at the end of the running cycle, so replacing
+// a waveform never cuts a cycle short.
+// Memory per channel: 2 x AWG_MAX_SAMPLES x 2 bytes (fixed, allocated statically)
+
+#define AWG_MAX_SAMPLES 1024        // Samples per buffer
+#define AWG_MAX_HOLD 60000          // Max sample clock ticks per sample
+
+/**
+ * Initialize waveform player
+ */
+void initWaveformPlayer();
+
+/**
+ * Start loading a new waveform into the back buffer of a channel
+ * @param signal: Signal number (1-3)
+ * @param mode: 'v' for voltage, 'c' for current
+ * @return true if back buffer is free for loading
+ */
+bool beginWaveformLoad(uint8_t signal, char mode);
+
+/**
+ * Append one sample to the back buffer
+ * @param signal: Signal number (1-3)
+ * @param value: Voltage (V) or current (mA), clamped to the safe range
+ * @return true if sample was stored
+ */
+bool appendWaveformSample(uint8_t signal, float value);
+
+/**
+ * Commit the back buffer: starts playback, or replaces the running waveform at the end of its cycle
+ * @param signal: Signal number (1-3)
+ * @param hold: Sample clock ticks each sample is held (1-AWG_MAX_HOLD)
+ * @return true if committed
+ */
+bool commitWaveform(uint8_t signal, long hold);
+
+/**
+ * Stop waveform playback
+ * @param signal: Signal number (1-3), 0 to stop all channels
+ */
+void stopWaveform(uint8_t signal);
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ * @param channel: Channel number (0-2)
+ */
+void releaseWaveformChannel(uint8_t channel);
+
+/**
+ * Render waveform samples into the tick's output frame (called from the sample clock task)
+ * @param frame: Output frame shared by all signal sources
+ * @param ticks: Number of sample ticks due since last call
+ */
+void renderWaveformPlayback(DacFrame* frame, uint32_t ticks);
+
+/**
+ * Check if waveform playback is active on specific channel
+ * @param channel: Channel number (0-2)
+ * @return true if playback is active on this channel
+ */
+bool isWaveformActiveOnChannel(uint8_t channel);
+
+/**
+ * Print playback status and sample memory usage
+ */
+void getWaveformStatus();
+
+/**
+ * Parse waveform commands
+ * Format: AWG LOAD/DATA/COMMIT/SHAPE/STOP/STATUS ...
+ */
+void parseWaveformCommand(String input);
+
+// Command examples:
+// AWG LOAD 1 V                         // Start loading a new waveform for SIG1 (voltage)
+// AWG DATA 1 0.0 2.5 5.0 7.5 10.0      // Append samples (repeat as needed, max 1024)
+// AWG COMMIT 1 10                      // Play it, each sample held 10 sample ticks
+// AWG SHAPE 2 C TRI 4.0 20.0 200       // Built-in triangle 4-20mA, 200 samples, on SIG2
+// AWG SHAPE 3 V STEP 0.0 10.0 5 100    // 5-level staircase 0-10V, 100 ticks per level
+// AWG STOP 1                           // Stop playback on SIG1
+// AWG STATUS                           // Show playback state and memory use
+
+#endif // WAVEFORM_PLAYER_H
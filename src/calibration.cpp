@@ -0,0 +1,241 @@
+#include "calibration.h"
+#include "dac_controller.h"
+#include <Preferences.h>
+
+// Index 0 = voltage, 1 = current
+static CalibrationPoints calPoints[3][2];
+
+// Tables are compiled in loop() and read by the DAC queue worker on core 0.
+// One spare table is compiled off-line, then swapped in under calMux, so the
+// worker never interpolates a table that is half rewritten.
+static uint16_t calTables[3 * 2 + 1][CAL_LUT_SIZE];
+static uint16_t* calOwned[3][2];            // Table slot owned by each signal and mode
+static uint16_t* calSpare = NULL;           // Slot the next rebuild compiles into
+static const uint16_t* calLUT[3][2];        // Published table, NULL = no calibration
+static portMUX_TYPE calMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int modeIndex(char mode) {
+    return (mode == 'c') ? 1 : 0;
+}
+
+/**
+ * Key for one signal and mode in NVS, e.g. "v0", "c2"
+ */
+static void calibrationKey(uint8_t channel, char mode, char* key) {
+    key[0] = (mode == 'c') ? 'c' : 'v';
+    key[1] = '0' + channel;
+    key[2] = '\0';
+}
+
+/**
+ * Rebuild LUT for one signal and mode from its points
+ * The table is compiled into the spare slot and published with one pointer swap;
+ * the slot it replaces becomes the spare once no reader can hold it.
+ */
+static void rebuildLUT(uint8_t channel, char mode) {
+    int m = modeIndex(mode);
+    CalibrationPoints* points = &calPoints[channel][m];
+    if (calSpare == NULL) {
+        for (int i = 0; i < 3 * 2; i++) {
+            calOwned[i / 2][i % 2] = calTables[i];
+        }
+        calSpare = calTables[3 * 2];
+    }
+
+    if (points->count == 0) {
+        portENTER_CRITICAL(&calMux);
+        calLUT[channel][m] = NULL;
+        portEXIT_CRITICAL(&calMux);
+        return;
+    }
+    sortCalibrationPoints(points);
+    compileCalibrationLUT(points, mode, calSpare);
+
+    uint16_t* retired = calOwned[channel][m];
+    portENTER_CRITICAL(&calMux);
+    calLUT[channel][m] = calSpare;
+    portEXIT_CRITICAL(&calMux);
+    calOwned[channel][m] = calSpare;
+    calSpare = retired;  // applyCalibration reads under calMux, so nobody still uses it
+}
+
+/**
+ * Save points for one signal and mode to flash
+ */
+static void saveCalibration(uint8_t channel, char mode) {
+    char key[3];
+    calibrationKey(channel, mode, key);
+    Preferences prefs;
+    prefs.begin(CAL_NVS_NAMESPACE, false);
+    prefs.putBytes(key, &calPoints[channel][modeIndex(mode)], sizeof(CalibrationPoints));
+    prefs.end();
+}
+
+/**
+ * Load calibration from flash and compile lookup tables
+ */
+void initCalibration() {
+    Preferences prefs;
+    prefs.begin(CAL_NVS_NAMESPACE, true);
+    int loaded = 0;
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        for (int m = 0; m < 2; m++) {
+            char mode = m ? 'c' : 'v';
+            char key[3];
+            calibrationKey(ch, mode, key);
+            CalibrationPoints* points = &calPoints[ch][m];
+            if (prefs.getBytes(key, points, sizeof(CalibrationPoints)) != sizeof(CalibrationPoints) ||
+                points->count > CAL_MAX_POINTS) {
+                points->count = 0;
+            }
+            rebuildLUT(ch, mode);
+            if (points->count > 0) loaded++;
+        }
+    }
+    prefs.end();
+    Serial.printf("Calibration loaded: %d table(s) active\n", loaded);
+}
+
+/**
+ * Add or replace a calibration point and save it to flash
+ */
+bool addCalibrationPoint(uint8_t channel, char mode, float nominal, float measured) {
+    if (channel >= 3 || (mode != 'v' && mode != 'c')) {
+        return false;
+    }
+    CalibrationPoints* points = &calPoints[channel][modeIndex(mode)];
+    int32_t nominalUnits = (int32_t)lroundf(nominal * 1000.0f);  // mV or uA
+    int32_t measuredUnits = (int32_t)lroundf(measured * 1000.0f);
+
+    // Same nominal value replaces the existing point
+    int slot = -1;
+    for (int i = 0; i < points->count; i++) {
+        if (points->nominal[i] == nominalUnits) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        if (points->count >= CAL_MAX_POINTS) {
+            Serial.printf("Calibration table full (%d points). Use 'cal clear' first.\n", CAL_MAX_POINTS);
+            return false;
+        }
+        slot = points->count++;
+    }
+    points->nominal[slot] = nominalUnits;
+    points->measured[slot] = measuredUnits;
+
+    rebuildLUT(channel, mode);
+    saveCalibration(channel, mode);
+    refreshDacOutputs(); // Re-apply to the current outputs
+    return true;
+}
+
+/**
+ * Remove all calibration points for a signal and mode and save to flash
+ */
+void clearCalibration(uint8_t channel, char mode) {
+    if (channel >= 3) return;
+    calPoints[channel][modeIndex(mode)].count = 0;
+    rebuildLUT(channel, mode);
+    saveCalibration(channel, mode);
+    refreshDacOutputs();
+}
+
+/**
+ * Apply calibration to a DAC code
+ */
+uint16_t applyCalibration(uint8_t channel, char mode, uint16_t code) {
+    if (channel >= 3) {
+        return code;
+    }
+    // The lookup reads the published table under the lock, never a retired one
+    uint16_t corrected = code;
+    portENTER_CRITICAL(&calMux);
+    const uint16_t* lut = calLUT[channel][modeIndex(mode)];
+    if (lut != NULL) {
+        corrected = lookupCalibrationLUT(lut, mode, code);
+    }
+    portEXIT_CRITICAL(&calMux);
+    return corrected;
+}
+
+/**
+ * Print all calibration points
+ */
+void printCalibration() {
+    Serial.println("=== CALIBRATION ===");
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        for (int m = 0; m < 2; m++) {
+            const CalibrationPoints* points = &calPoints[ch][m];
+            const char* unit = m ? "mA" : "V";
+            Serial.printf("SIG%d %s: %d point(s)\n", ch + 1, m ? "current" : "voltage", points->count);
+            for (int i = 0; i < points->count; i++) {
+                Serial.printf("  nominal %.3f%s -> measured %.3f%s\n",
+                              points->nominal[i] / 1000.0f, unit, points->measured[i] / 1000.0f, unit);
+            }
+        }
+    }
+    Serial.println("===================");
+}
+
+/**
+ * Parse calibration commands
+ * Format: cal <signal> <v|c> <nominal> <measured> | cal clear <signal> <v|c> | cal show
+ */
+void parseCalibrationCommand(String input) {
+    input.trim();
+    String params = input.substring(3); // Remove "cal"
+    params.trim();
+    params.toLowerCase();
+
+    if (params.length() == 0 || params.startsWith("show")) {
+        printCalibration();
+        return;
+    }
+
+    if (params.startsWith("clear")) {
+        // cal clear <signal> <v|c>
+        String rest = params.substring(5);
+        rest.trim();
+        int space1 = rest.indexOf(' ');
+        if (space1 == -1) {
+            Serial.println("Usage: cal clear <signal> <v|c>");
+            return;
+        }
+        int signal = rest.substring(0, space1).toInt();
+        char mode = rest.charAt(space1 + 1);
+        if (signal < 1 || signal > 3 || (mode != 'v' && mode != 'c')) {
+            Serial.println("Invalid signal (1-3) or mode (v/c).");
+            return;
+        }
+        clearCalibration(signal - 1, mode);
+        Serial.printf("Calibration cleared: SIG%d %c\n", signal, mode);
+        return;
+    }
+
+    // cal <signal> <v|c> <nominal> <measured>
+    int space1 = params.indexOf(' ');
+    int space2 = params.indexOf(' ', space1 + 1);
+    int space3 = params.indexOf(' ', space2 + 1);
+    if (space1 == -1 || space2 == -1 || space3 == -1) {
+        Serial.println("Usage: cal <signal> <v|c> <nominal> <measured>");
+        Serial.println("Example: cal 1 v 5.0 4.97   // SIG1 commanded 5.0V, meter read 4.97V");
+        Serial.println("         cal clear <signal> <v|c>");
+        Serial.println("         cal show");
+        return;
+    }
+    int signal = params.substring(0, space1).toInt();
+    char mode = params.charAt(space1 + 1);
+    float nominal = params.substring(space2 + 1, space3).toFloat();
+    float measured = params.substring(space3 + 1).toFloat();
+
+    if (signal < 1 || signal > 3 || (mode != 'v' && mode != 'c')) {
+        Serial.println("Invalid signal (1-3) or mode (v/c).");
+        return;
+    }
+    if (addCalibrationPoint(signal - 1, mode, nominal, measured)) {
+        Serial.printf("Calibration point stored: SIG%d %c nominal %.3f measured %.3f\n",
+                      signal, mode, nominal, measured);
+    }
+}
@@ -0,0 +1,81 @@
+#include "calibration_lut.h"
+#include "dac_codes.h"
+
+static int32_t codeToUnits(uint16_t code, char mode) {
+    return (mode == 'c') ? GP8313CurrentCodec::toUnits(code) : GP8413VoltageCodec::toUnits(code);
+}
+
+static uint16_t unitsToCode(int32_t units, char mode) {
+    return (mode == 'c') ? GP8313CurrentCodec::toCode(units) : GP8413VoltageCodec::toCode(units);
+}
+
+static uint16_t maxCode(char mode) {
+    return (mode == 'c') ? GP8313CurrentCodec::kMaxCode : GP8413VoltageCodec::kMaxCode;
+}
+
+/**
+ * Sort points by measured value (insertion sort, at most CAL_MAX_POINTS)
+ */
+void sortCalibrationPoints(CalibrationPoints* points) {
+    for (int i = 1; i < points->count; i++) {
+        int32_t n = points->nominal[i];
+        int32_t m = points->measured[i];
+        int j = i - 1;
+        while (j >= 0 && points->measured[j] > m) {
+            points->nominal[j + 1] = points->nominal[j];
+            points->measured[j + 1] = points->measured[j];
+            j--;
+        }
+        points->nominal[j + 1] = n;
+        points->measured[j + 1] = m;
+    }
+}
+
+/**
+ * Compile calibration points into a lookup table
+ * For a desired output value, find the commanded value that produces it by
+ * interpolating the (measured -> nominal) curve. One point = offset correction.
+ */
+void compileCalibrationLUT(const CalibrationPoints* points, char mode, uint16_t* lut) {
+    for (int k = 0; k < CAL_LUT_SIZE; k++) {
+        int32_t code = k << CAL_LUT_SHIFT;
+        if (code > maxCode(mode)) code = maxCode(mode);
+        int32_t desired = codeToUnits((uint16_t)code, mode);
+        int32_t commanded = desired;
+
+        if (points->count == 1) {
+            commanded = desired + (points->nominal[0] - points->measured[0]);
+        } else if (points->count >= 2) {
+            // Pick the segment containing desired, or the end segment for extrapolation
+            int seg = 0;
+            while (seg < points->count - 2 && desired > points->measured[seg + 1]) {
+                seg++;
+            }
+            int32_t m0 = points->measured[seg];
+            int32_t m1 = points->measured[seg + 1];
+            int32_t n0 = points->nominal[seg];
+            int32_t n1 = points->nominal[seg + 1];
+            if (m1 != m0) {
+                commanded = n0 + (int32_t)(((int64_t)(desired - m0) * (n1 - n0)) / (m1 - m0));
+            } else {
+                commanded = desired + (n0 - m0);
+            }
+        }
+        lut[k] = unitsToCode(commanded, mode);
+    }
+}
+
+/**
+ * Look up a DAC code in a compiled table
+ */
+uint16_t lookupCalibrationLUT(const uint16_t* lut, char mode, uint16_t code) {
+    // The last entry was compiled at full scale, one code short of its slot
+    if (code >= maxCode(mode)) {
+        return lut[CAL_LUT_SIZE - 1];
+    }
+    uint32_t index = code >> CAL_LUT_SHIFT;
+    int32_t fraction = code & ((1 << CAL_LUT_SHIFT) - 1);
+    int32_t a = lut[index];
+    int32_t b = lut[index + 1];
+    return (uint16_t)(a + (((b - a) * fraction) >> CAL_LUT_SHIFT));
+}
@@ -6,6 +6,9 @@
 #include "device_id.h"
 #include "rs485_command_handler.h"
 #include "utils.h"
+#include "dac_output_queue.h"
+#include "output_stage.h"
+#include "sample_output.h"
 
 // Global variable declarations
 extern char signalModes[3]; // Signal modes
@@ -34,14 +37,20 @@ void parseModeCommand(String params) {
         return;
     }
 
-    // Execute protection operation
+    // Execute protection operation (must reach the bus before the relay switches);
+    // a latched code would otherwise land on the zeroed DAC
+    cancelScheduledChannel(sig - 1);
     if (mode == 'v') {
-        signalMap[sig - 1].currentDAC->setDACOutElectricCurrent(0);
+        postCurrentCode(sig - 1, 0);
         Serial.printf("SIG%d: Current set to 0mA for protection.\n", sig);
     } else if (mode == 'c') {
-        signalMap[sig - 1].voltageDAC->setVoltage(0.0, signalMap[sig - 1].voltageChannel);
+        postVoltageCode(sig - 1, 0);
         Serial.printf("SIG%d: Voltage set to 0V for protection.\n", sig);
     }
+    if (!flushDacOutputQueue()) {
+        Serial.printf("SIG%d: mode not changed, DAC queue flush timed out (relay unchanged).\n", sig);
+        return;
+    }
 
     // Update mode status and set relay
     signalModes[sig - 1] = mode;
@@ -70,15 +79,14 @@ void parseValueCommand(String params) {
             Serial.println("Invalid voltage value. Use 0-10V.");
             return;
         }
-        signalMap[sig - 1].voltageDAC->setVoltage(value, signalMap[sig - 1].voltageChannel);
+        postSetpointCode(sig - 1, 'v', voltageToDacCode(value));
         Serial.printf("Voltage set: SIG%d -> %.2f V\n", sig, value);
     } else if (mode == 'c') {
         if (value < 0 || value > 25.0) {
             Serial.println("Invalid current value. Use 0-25mA.");
             return;
         }
-        // Convert mA to DAC data: Rset=2kΩ, 25mA = 32767 (15-bit), so 1mA = 1310.68
-        signalMap[sig - 1].currentDAC->setDACOutElectricCurrent(static_cast<uint16_t>(value * 1310.68));
+        postSetpointCode(sig - 1, 'c', currentToDacCode(value));
         Serial.printf("Current set: SIG%d -> %.2f mA\n", sig, value);
     } else {
         Serial.printf("Unknown mode '%c' for SIG%d.\n", mode, sig);
@@ -119,8 +127,7 @@ void processCommand(String command) {
             processAnalogCommand(command);
         } else if (lowerCommand.startsWith("help") || lowerCommand.startsWith("status")) {
             processSystemCommand(command);
-        } else if (lowerCommand.startsWith("modbus_test") || lowerCommand.startsWith("serial_test") || 
-                   lowerCommand.startsWith("send_modbus")) {
+        } else if (lowerCommand.startsWith("modbus_test") || lowerCommand.startsWith("send_modbus")) {
             processTestCommand(command);
         } else if (lowerCommand.startsWith("modbus")) {
             processModbusCommand(command);
@@ -161,8 +168,8 @@ void processAnalogCommand(String command) {
                     // Then set value using signal mapping
                     if (mode == 'v') {
                         if (value >= 0 && value <= 10) {
-                            // Use signal mapping to set correct DAC and channel
-                            signalMap[channel - 1].voltageDAC->setVoltage(value, signalMap[channel - 1].voltageChannel);
+                            // Queue setpoint for the signal's voltage DAC (shaped if the output stage is on)
+                            postSetpointCode(channel - 1, 'v', voltageToDacCode(value));
                             signalValues[channel - 1] = value; // Update signal value
                             Serial.printf("Channel %d set to VOLTAGE mode, output %.2fV\n", channel, value);
                             // Trigger status report after successful voltage setting
@@ -173,9 +180,8 @@ void processAnalogCommand(String command) {
                         }
                     } else if (mode == 'c') {
                         if (value >= 0 && value <= 25) {
-                            // Use signal mapping to set correct DAC
-                            // Convert mA to DAC data: Rset=2kΩ, 25mA = 32767 (15-bit), so 1mA = 1310.68
-                            signalMap[channel - 1].currentDAC->setDACOutElectricCurrent(static_cast<uint16_t>(value * 1310.68));
+                            // Queue setpoint for the signal's current DAC (shaped if the output stage is on)
+                            postSetpointCode(channel - 1, 'c', currentToDacCode(value));
                             signalValues[channel - 1] = value; // Update signal value
                             Serial.printf("Channel %d set to CURRENT mode, output %.2fmA\n", channel, value);
                             // Trigger status report after successful current setting
@@ -289,7 +295,7 @@ void processSystemCommand(String command) {
 }
 
 /**
- * Process test commands (modbus_test, serial_test, etc.)
+ * Process test commands (modbus_test, send_modbus)
  */
 void processTestCommand(String command) {
     // For now, delegate back to main.cpp's handleUSBSerialCommands  
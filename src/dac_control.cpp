@@ -1,4 +1,8 @@
 #include "dac_controller.h"
+#include "utils.h"
+#include "dac_output_queue.h"
+#include "calibration.h"
+#include "output_stage.h"
 
 // Global DAC instance definitions
 GP8413 gp8413_1(0x58); // GP8413 address 0x58, corresponds to SIG1 and SIG2 voltage
@@ -15,33 +19,243 @@ bool GP8413::setVoltage(float voltage, uint8_t channel) {
         return false;
     }
 
-    // Convert voltage to 15-bit DAC data (15-bit resolution = 32767)
-    uint16_t data = static_cast<uint16_t>((voltage / 10.0) * 32767);
-    
-    setDACOutVoltage(data, channel); // Call base class setting function
-    return true;
+    return writeChannelCode(channel, voltageToDacCode(voltage)) == 0;
+}
+
+// Left-align data in the 16-bit register, same as setDACOutVoltage()
+uint16_t GP8XXXDevice::alignCode(uint16_t code) {
+    if (_resolution == RESOLUTION_15_BIT) {
+        return Dac15Bit::toWire(code);
+    }
+    return Dac12Bit::toWire(code);
+}
+
+// Same framing as library writeRegister(), but returns the bus status
+uint8_t GP8XXXDevice::writeRegisterChecked(uint8_t reg, const uint8_t* buf, size_t size) {
+    _pWire->beginTransmission(_deviceAddr);
+    _pWire->write(reg);
+    _pWire->write(buf, size);
+    return _pWire->endTransmission();
+}
+
+// Channel 0 data register is 0x02, channel 1 is 0x04
+uint8_t GP8XXXDevice::writeChannelCode(uint8_t channel, uint16_t code) {
+    code = alignCode(code);
+    uint8_t buff[2] = {uint8_t(code & 0xFF), uint8_t(code >> 8)};
+    uint8_t reg = (channel == 0) ? GP8XXX_CONFIG_CURRENT_REG : (GP8XXX_CONFIG_CURRENT_REG << 1);
+    return writeRegisterChecked(reg, buff, 2);
+}
+
+// Both channels in one transaction (register 0x02, 4 data bytes)
+// Library sendData(…, 2) can only write the same value to both channels
+uint8_t GP8XXXDevice::writeDualChannelCodes(uint16_t code0, uint16_t code1) {
+    code0 = alignCode(code0);
+    code1 = alignCode(code1);
+    uint8_t buff[4] = {uint8_t(code0 & 0xFF), uint8_t(code0 >> 8),
+                       uint8_t(code1 & 0xFF), uint8_t(code1 >> 8)};
+    return writeRegisterChecked(GP8XXX_CONFIG_CURRENT_REG, buff, 4);
 }
 
 // GP8313: Set current output
 void GP8313::setDACOutElectricCurrent(uint16_t current) {
-    setDACOutVoltage(current);
+    writeChannelCode(0, current);
 }
 
 /**
- * Initialize all DAC outputs to 0
+ * Convert voltage to GP8413 15-bit DAC code (10V = 32767)
  */
-void initializeDACs() {
-    // Initialize GP8413
-    gp8413_1.setVoltage(0.0, 0); // SIG1 voltage channel
-    gp8413_1.setVoltage(0.0, 1); // SIG2 voltage channel
-    gp8413_2.setVoltage(0.0, 0); // SIG3 voltage channel
+uint16_t voltageToDacCode(float voltage) {
+    return GP8413VoltageCodec::toCode((int32_t)lroundf(voltage * 1000.0f));
+}
 
-    // Initialize GP8313
-    gp8313_1.setDACOutElectricCurrent(0); // SIG1 current channel
-    gp8313_2.setDACOutElectricCurrent(0); // SIG2 current channel
-    gp8313_3.setDACOutElectricCurrent(0); // SIG3 current channel
+/**
+ * Convert current to GP8313 15-bit DAC code
+ * Rset=2kΩ, 25mA = 32767 (15-bit)
+ */
+uint16_t currentToDacCode(float current) {
+    return GP8313CurrentCodec::toCode((int32_t)lroundf(current * 1000.0f));
+}
+
+/**
+ * Clear all pending codes in a frame
+ */
+void dacFrameClear(DacFrame* frame) {
+    memset(frame, 0, sizeof(DacFrame));
+}
+
+/**
+ * Queue a voltage DAC code in a frame
+ */
+void dacFrameSetVoltageCode(DacFrame* frame, uint8_t channel, uint16_t code) {
+    if (channel >= 3) return;
+    frame->voltageCode[channel] = code;
+    frame->voltagePending |= (1 << channel);
+}
+
+/**
+ * Queue a current DAC code in a frame
+ */
+void dacFrameSetCurrentCode(DacFrame* frame, uint8_t channel, uint16_t code) {
+    if (channel >= 3) return;
+    frame->currentCode[channel] = code;
+    frame->currentPending |= (1 << channel);
+}
+
+// Shadow cache: last code sent to each channel; valid bit = confirmed on the bus
+static uint16_t voltageShadow[3] = {0, 0, 0};
+static uint16_t currentShadow[3] = {0, 0, 0};
+static uint8_t voltageShadowValid = 0;
+static uint8_t currentShadowValid = 0;
+static volatile bool shadowInvalidateRequested = false;
+static DacBusStats busStats = {0, 0, 0, 0, 0};
+
+/**
+ * Account for one transaction and update shadow valid bits from its result
+ */
+static void recordTransaction(uint8_t status, uint8_t dataBytes, uint8_t* validMask, uint8_t channelBits) {
+    busStats.transactions++;
+    busStats.bytes += 2 + dataBytes; // Address byte + register byte + data
+    busStats.channelWrites += dataBytes / 2;
+    if (status == 0) {
+        *validMask |= channelBits;
+    } else {
+        // Not acknowledged: force the next write of this channel onto the bus
+        *validMask &= ~channelBits;
+        busStats.busErrors++;
+    }
+}
+
+/**
+ * Write all pending codes of a frame with the minimum number of I2C transactions
+ */
+void commitDacFrame(const DacFrame* frame) {
+    if (shadowInvalidateRequested) {
+        shadowInvalidateRequested = false;
+        voltageShadowValid = 0;
+        currentShadowValid = 0;
+    }
+
+    // Drop writes that would not change the DAC register
+    // Shadow holds requested codes; calibration is applied only on the wire write
+    uint8_t voltageDirty = 0;
+    uint8_t currentDirty = 0;
+    for (int i = 0; i < 3; i++) {
+        uint8_t bit = 1 << i;
+        if (frame->voltagePending & bit) {
+            if ((voltageShadowValid & bit) && voltageShadow[i] == frame->voltageCode[i]) {
+                busStats.skippedWrites++;
+            } else {
+                voltageDirty |= bit;
+            }
+        }
+        if (frame->currentPending & bit) {
+            if ((currentShadowValid & bit) && currentShadow[i] == frame->currentCode[i]) {
+                busStats.skippedWrites++;
+            } else {
+                currentDirty |= bit;
+            }
+        }
+    }
+
+    // Voltage: pair up signals that share a GP8413 (SIG1 + SIG2 on 0x58)
+    uint8_t written = 0;
+    for (int i = 0; i < 3; i++) {
+        if (!(voltageDirty & (1 << i)) || (written & (1 << i))) {
+            continue;
+        }
+        GP8413* dac = signalMap[i].voltageDAC;
+        int partner = -1;
+        for (int j = i + 1; j < 3; j++) {
+            if ((voltageDirty & (1 << j)) && signalMap[j].voltageDAC == dac &&
+                signalMap[j].voltageChannel != signalMap[i].voltageChannel) {
+                partner = j;
+                break;
+            }
+        }
+
+        if (partner >= 0) {
+            uint16_t codeI = applyCalibration(i, 'v', frame->voltageCode[i]);
+            uint16_t codeP = applyCalibration(partner, 'v', frame->voltageCode[partner]);
+            uint16_t code0 = (signalMap[i].voltageChannel == 0) ? codeI : codeP;
+            uint16_t code1 = (signalMap[i].voltageChannel == 0) ? codeP : codeI;
+            uint8_t status = dac->writeDualChannelCodes(code0, code1);
+            voltageShadow[i] = frame->voltageCode[i];
+            voltageShadow[partner] = frame->voltageCode[partner];
+            recordTransaction(status, 4, &voltageShadowValid, (1 << i) | (1 << partner));
+            written |= (1 << partner);
+        } else {
+            uint8_t status = dac->writeChannelCode(signalMap[i].voltageChannel,
+                                                  applyCalibration(i, 'v', frame->voltageCode[i]));
+            voltageShadow[i] = frame->voltageCode[i];
+            recordTransaction(status, 2, &voltageShadowValid, 1 << i);
+        }
+        written |= (1 << i);
+    }
+
+    // Current: each GP8313 has a single channel
+    for (int i = 0; i < 3; i++) {
+        if (currentDirty & (1 << i)) {
+            uint8_t status = signalMap[i].currentDAC->writeChannelCode(0, applyCalibration(i, 'c', frame->currentCode[i]));
+            currentShadow[i] = frame->currentCode[i];
+            recordTransaction(status, 2, &currentShadowValid, 1 << i);
+        }
+    }
+}
+
+/**
+ * Invalidate the shadow cache and rewrite the latest requested code of every channel
+ */
+void refreshDacOutputs() {
+    // Consumed by the next commit, which runs in the output worker. The rewrite uses
+    // the latest requested codes: the shadows belong to the worker and may be older.
+    shadowInvalidateRequested = true;
+    repostDacOutputs();
+    if (!flushDacOutputQueue()) {
+        Serial.println("DAC refresh posted, but the output queue flush timed out.");
+        return;
+    }
+    Serial.println("DAC outputs refreshed (shadow cache invalidated).");
+}
+
+/**
+ * Get DAC bus utilisation counters
+ */
+DacBusStats getDacBusStats() {
+    return busStats;
+}
+
+/**
+ * Print DAC bus utilisation counters to USB serial
+ */
+void printDacBusStatus() {
+    DacBusStats stats = getDacBusStats();
+    uint32_t requested = stats.channelWrites + stats.skippedWrites;
+    float savedPercent = requested ? (stats.skippedWrites * 100.0f / requested) : 0.0f;
+    Serial.printf("DAC bus: %lu transactions, %lu bytes, %lu bus errors\n",
+                  (unsigned long)stats.transactions, (unsigned long)stats.bytes, (unsigned long)stats.busErrors);
+    Serial.printf("DAC shadow cache: %lu channel writes, %lu skipped as unchanged (%.1f%% saved)\n",
+                  (unsigned long)stats.channelWrites, (unsigned long)stats.skippedWrites, savedPercent);
+}
+
+/**
+ * Initialize all DAC outputs to 0
+ */
+bool initializeDACs() {
+    DacFrame frame;
+    dacFrameClear(&frame);
+    for (int i = 0; i < 3; i++) {
+        dacFrameSetVoltageCode(&frame, i, 0); // SIG1-3 voltage channels
+        dacFrameSetCurrentCode(&frame, i, 0); // SIG1-3 current channels
+    }
+    // Goes through the output queue so it also overrides any stale pending setpoint
+    postDacFrame(&frame);
+    if (!flushDacOutputQueue()) {
+        Serial.println("DAC queue flush timed out: outputs not confirmed at 0.");
+        return false;
+    }
 
     Serial.println("All DAC outputs initialized to 0.");
+    return true;
 }
 
 // Global variables to track current outputs
@@ -79,8 +293,9 @@ void testDACCommunication() {
  * Initialize DAC controllers
  */
 void initDACControllers() {
-    initializeDACs();
-    Serial.println("DAC controllers initialized");
+    if (initializeDACs()) {
+        Serial.println("DAC controllers initialized");
+    }
     
     // Test communication
     testDACCommunication();
@@ -97,7 +312,7 @@ void setVoltageOutput(float voltage) {
     }
     
     currentVoltageOutput = voltage;
-    gp8413_1.setVoltage(voltage, 0); // Set on first channel
+    postSetpointCode(0, 'v', voltageToDacCode(voltage)); // SIG1 voltage, through the output stage
     Serial.printf("Voltage output set to %.2fV\n", voltage);
 }
 
@@ -112,8 +327,7 @@ void setCurrentOutput(float current) {
     }
     
     currentCurrentOutput = current;
-    // Convert mA to DAC data: Rset=2kΩ, 25mA = 32767 (15-bit), so 1mA = 1310.68
-    gp8313_1.setDACOutElectricCurrent((uint16_t)(current * 1310.68));
+    postSetpointCode(0, 'c', currentToDacCode(current)); // SIG1 current, through the output stage
     Serial.printf("Current output set to %.2fmA\n", current);
 }
 
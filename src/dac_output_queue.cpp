@@ -0,0 +1,203 @@
+#include "dac_output_queue.h"
+
+static DacFrame pendingFrame;        // One slot per DAC channel, latest value wins
+static DacFrame lastPostedFrame;     // Most recent code posted per DAC channel (pending masks unused)
+static DacQueueStats queueStats;
+static volatile bool workerBusy = false;
+static TaskHandle_t dacTaskHandle = nullptr;
+static portMUX_TYPE dacQueueMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Count set bits in a pending mask
+ */
+static uint8_t countPending(uint8_t mask) {
+    uint8_t count = 0;
+    while (mask) {
+        count += mask & 1;
+        mask >>= 1;
+    }
+    return count;
+}
+
+/**
+ * Take everything pending and write it to the bus
+ */
+static void drainDacOutputQueue() {
+    DacFrame frame;
+
+    portENTER_CRITICAL(&dacQueueMux);
+    frame = pendingFrame;
+    dacFrameClear(&pendingFrame);
+    queueStats.depth = 0;
+    workerBusy = true;
+    portEXIT_CRITICAL(&dacQueueMux);
+
+    if (frame.voltagePending || frame.currentPending) {
+        commitDacFrame(&frame);
+    }
+
+    portENTER_CRITICAL(&dacQueueMux);
+    queueStats.written += countPending(frame.voltagePending) + countPending(frame.currentPending);
+    workerBusy = false;
+    portEXIT_CRITICAL(&dacQueueMux);
+}
+
+/**
+ * Worker task: sleeps until a producer posts, then drains the queue
+ */
+static void dacOutputTask(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        drainDacOutputQueue();
+    }
+}
+
+/**
+ * Wake worker, or write synchronously if the worker is not running yet (early setup)
+ */
+static void kickWorker() {
+    if (dacTaskHandle) {
+        xTaskNotifyGive(dacTaskHandle);
+    } else {
+        drainDacOutputQueue();
+    }
+}
+
+/**
+ * Merge one setpoint into the pending frame (caller holds dacQueueMux)
+ */
+static void mergeSetpoint(uint16_t* slot, uint8_t* pendingMask, uint8_t channel, uint16_t code) {
+    uint8_t bit = 1 << channel;
+    if (*pendingMask & bit) {
+        queueStats.superseded++;
+    } else {
+        *pendingMask |= bit;
+        queueStats.depth++;
+        if (queueStats.depth > queueStats.maxDepth) {
+            queueStats.maxDepth = queueStats.depth;
+        }
+    }
+    *slot = code;
+    queueStats.posted++;
+}
+
+/**
+ * Initialize output queue and start the worker task
+ */
+void initDacOutputQueue() {
+    dacFrameClear(&pendingFrame);
+    dacFrameClear(&lastPostedFrame);
+    memset(&queueStats, 0, sizeof(queueStats));
+    xTaskCreatePinnedToCore(dacOutputTask, "dac_output", DAC_QUEUE_TASK_STACK, nullptr,
+                            DAC_QUEUE_TASK_PRIORITY, &dacTaskHandle, DAC_QUEUE_TASK_CORE);
+    Serial.println("DAC output queue initialized");
+}
+
+/**
+ * Post all pending codes of a frame
+ */
+void postDacFrame(const DacFrame* frame) {
+    portENTER_CRITICAL(&dacQueueMux);
+    for (uint8_t i = 0; i < 3; i++) {
+        if (frame->voltagePending & (1 << i)) {
+            mergeSetpoint(&pendingFrame.voltageCode[i], &pendingFrame.voltagePending, i, frame->voltageCode[i]);
+            lastPostedFrame.voltageCode[i] = frame->voltageCode[i];
+        }
+        if (frame->currentPending & (1 << i)) {
+            mergeSetpoint(&pendingFrame.currentCode[i], &pendingFrame.currentPending, i, frame->currentCode[i]);
+            lastPostedFrame.currentCode[i] = frame->currentCode[i];
+        }
+    }
+    portEXIT_CRITICAL(&dacQueueMux);
+    kickWorker();
+}
+
+/**
+ * Get the most recent code posted for a channel
+ */
+uint16_t getLastPostedCode(uint8_t channel, char mode) {
+    if (channel >= 3) {
+        return 0;
+    }
+    portENTER_CRITICAL(&dacQueueMux);
+    uint16_t code = (mode == 'c') ? lastPostedFrame.currentCode[channel] : lastPostedFrame.voltageCode[channel];
+    portEXIT_CRITICAL(&dacQueueMux);
+    return code;
+}
+
+/**
+ * Post the most recent code again for every channel without a pending one
+ */
+void repostDacOutputs() {
+    portENTER_CRITICAL(&dacQueueMux);
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t bit = 1 << i;
+        if (!(pendingFrame.voltagePending & bit)) {
+            mergeSetpoint(&pendingFrame.voltageCode[i], &pendingFrame.voltagePending, i, lastPostedFrame.voltageCode[i]);
+        }
+        if (!(pendingFrame.currentPending & bit)) {
+            mergeSetpoint(&pendingFrame.currentCode[i], &pendingFrame.currentPending, i, lastPostedFrame.currentCode[i]);
+        }
+    }
+    portEXIT_CRITICAL(&dacQueueMux);
+    kickWorker();
+}
+
+/**
+ * Post a voltage setpoint
+ */
+void postVoltageCode(uint8_t channel, uint16_t code) {
+    DacFrame frame;
+    dacFrameClear(&frame);
+    dacFrameSetVoltageCode(&frame, channel, code);
+    postDacFrame(&frame);
+}
+
+/**
+ * Post a current setpoint
+ */
+void postCurrentCode(uint8_t channel, uint16_t code) {
+    DacFrame frame;
+    dacFrameClear(&frame);
+    dacFrameSetCurrentCode(&frame, channel, code);
+    postDacFrame(&frame);
+}
+
+/**
+ * Wait until all posted setpoints have reached the bus
+ */
+bool flushDacOutputQueue(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    for (;;) {
+        portENTER_CRITICAL(&dacQueueMux);
+        bool idle = (queueStats.depth == 0) && !workerBusy;
+        portEXIT_CRITICAL(&dacQueueMux);
+        if (idle) {
+            return true;
+        }
+        if (millis() - start >= timeoutMs) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * Get queue statistics
+ */
+DacQueueStats getDacQueueStats() {
+    portENTER_CRITICAL(&dacQueueMux);
+    DacQueueStats copy = queueStats;
+    portEXIT_CRITICAL(&dacQueueMux);
+    return copy;
+}
+
+/**
+ * Print queue statistics to USB serial
+ */
+void printDacQueueStatus() {
+    DacQueueStats stats = getDacQueueStats();
+    Serial.printf("DAC queue: depth %u (max %u), posted %lu, written %lu, superseded %lu\n",
+                  stats.depth, stats.maxDepth, (unsigned long)stats.posted,
+                  (unsigned long)stats.written, (unsigned long)stats.superseded);
+}
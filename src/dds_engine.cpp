@@ -0,0 +1,138 @@
+#include "dds_engine.h"
+#include <math.h>
+
+// Q15 sine table, one extra entry so interpolation never wraps the index
+static int16_t ddsSineTable[DDS_TABLE_SIZE + 1];
+
+/**
+ * Build the Q15 sine table
+ */
+void ddsInitTable() {
+    for (int i = 0; i <= DDS_TABLE_SIZE; i++) {
+        double angle = 2.0 * 3.14159265358979323846 * i / DDS_TABLE_SIZE;
+        ddsSineTable[i] = (int16_t)lround(sin(angle) * 32767.0);
+    }
+}
+
+/**
+ * Calculate phase increment per sample for a given period
+ * @param periodSeconds Waveform period in seconds
+ * @param sampleRateHz Sample clock rate in Hz
+ * @return Phase increment (2^32 = one full cycle)
+ */
+uint32_t ddsIncrementForPeriod(float periodSeconds, float sampleRateHz) {
+    if (periodSeconds <= 0 || sampleRateHz <= 0) {
+        return 0;
+    }
+    double samplesPerCycle = (double)periodSeconds * sampleRateHz;
+    if (samplesPerCycle < 2.0) {
+        samplesPerCycle = 2.0; // Nyquist limit
+    }
+    return (uint32_t)llround(4294967296.0 / samplesPerCycle);
+}
+
+/**
+ * Configure a DDS channel and reset its phase to 0
+ */
+void ddsConfigure(DDSChannel* channel, int32_t centerCode, int32_t amplitudeCode, uint32_t increment) {
+    if (amplitudeCode < 0) amplitudeCode = 0;
+    if (amplitudeCode > DDS_AMPLITUDE_CODE_MAX) amplitudeCode = DDS_AMPLITUDE_CODE_MAX;
+
+    // Center only needs to be reachable within one full swing of the output range
+    if (centerCode < -DDS_AMPLITUDE_CODE_MAX) centerCode = -DDS_AMPLITUDE_CODE_MAX;
+    if (centerCode > DDS_CODE_MAX + DDS_AMPLITUDE_CODE_MAX) centerCode = DDS_CODE_MAX + DDS_AMPLITUDE_CODE_MAX;
+
+    channel->phase = 0;
+    channel->increment = increment;
+    channel->centerCode = centerCode;
+    channel->amplitudeCode = amplitudeCode;
+}
+
+/**
+ * Look up sine value with linear interpolation between table entries
+ * Top 10 bits of phase select the entry, next 16 bits are the fraction
+ */
+int16_t ddsSineQ15(uint32_t phase) {
+    uint32_t index = phase >> (32 - DDS_TABLE_BITS);
+    int32_t fraction = (phase >> (16 - DDS_TABLE_BITS)) & 0xFFFF;
+    int32_t a = ddsSineTable[index];
+    int32_t b = ddsSineTable[index + 1];
+    return (int16_t)(a + (((b - a) * fraction) >> 16));
+}
+
+/**
+ * Get DAC code for the current phase (clamped to 0-32767)
+ */
+uint16_t ddsCurrentCode(const DDSChannel* channel) {
+    int32_t code = channel->centerCode + ((channel->amplitudeCode * ddsSineQ15(channel->phase)) >> 15);
+    if (code < 0) code = 0;
+    if (code > DDS_CODE_MAX) code = DDS_CODE_MAX;
+    return (uint16_t)code;
+}
+
+/**
+ * Get DAC code at an absolute sample index
+ * Increment * index wraps at 2^32 exactly like stepping the accumulator index times.
+ */
+uint16_t ddsCodeAt(const DDSChannel* channel, uint32_t sampleIndex) {
+    DDSChannel at = *channel;
+    at.phase = channel->phase + channel->increment * sampleIndex;
+    return ddsCurrentCode(&at);
+}
+
+/**
+ * Convert phase offset in degrees to accumulator phase
+ */
+uint32_t ddsPhaseFromDegrees(float degrees) {
+    double turns = degrees / 360.0;
+    turns -= floor(turns);
+    return (uint32_t)(int64_t)llround(turns * 4294967296.0);
+}
+
+/**
+ * Configure a chirp
+ */
+void ddsChirpConfigure(DDSChirp* chirp, uint32_t startIncrement, uint32_t endIncrement,
+                       uint32_t sweepSamples, uint8_t shape, uint8_t endMode) {
+    if (startIncrement == 0) startIncrement = 1;
+    if (endIncrement == 0) endIncrement = 1;
+    chirp->startIncrement = startIncrement;
+    chirp->endIncrement = endIncrement;
+    chirp->sweepSamples = (sweepSamples > 0) ? sweepSamples : 1;
+    chirp->shape = shape;
+    chirp->endMode = endMode;
+    chirp->logRatio = (float)log((double)endIncrement / startIncrement);
+}
+
+/**
+ * Get phase increment of a chirp at a sample index
+ * Linear sweeps are exact integer interpolation; log sweeps evaluate exp() from the
+ * absolute position, so rounding never accumulates into a frequency drift.
+ */
+uint32_t ddsChirpIncrement(const DDSChirp* chirp, uint32_t sampleIndex) {
+    uint32_t n = chirp->sweepSamples;
+    uint32_t position;
+    if (sampleIndex < n) {
+        position = sampleIndex;
+    } else if (chirp->endMode == DDS_CHIRP_REPEAT) {
+        position = sampleIndex % n;
+    } else if (chirp->endMode == DDS_CHIRP_BOUNCE) {
+        uint32_t cycle = sampleIndex % (2 * (uint64_t)n);
+        position = (cycle < n) ? cycle : 2 * n - cycle;
+    } else {
+        position = n;
+    }
+
+    if (chirp->shape == DDS_CHIRP_LOG) {
+        return (uint32_t)(chirp->startIncrement * expf(chirp->logRatio * position / n));
+    }
+    int64_t delta = (int64_t)chirp->endIncrement - chirp->startIncrement;
+    return (uint32_t)(chirp->startIncrement + delta * position / n);
+}
+
+/**
+ * Advance phase accumulator (wraps naturally at 2^32)
+ */
+void ddsAdvance(DDSChannel* channel, uint32_t ticks) {
+    channel->phase += channel->increment * ticks;
+}
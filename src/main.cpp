@@ -7,7 +7,20 @@
 #include "sine_wave_generator.h"
 #include "device_id.h"
 #include "modbus_handler.h"
+#include "modbus_register_image.h"
+#include "meter_register_map.h"
+#include "modbus_rtu_receiver.h"
+#include "meter_totalizer.h"
+#include "trace_replay.h"
+#include "virtual_meters.h"
+#include "output_control.h"
 #include "utils.h"
+#include "dac_output_queue.h"
+#include "calibration.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "sample_output.h"
+#include "output_stage.h"
 
 char signalModes[3] = {'v', 'v', 'v'};
 float signalValues[3] = {0.0f, 0.0f, 0.0f}; // Track values for each signal
@@ -36,10 +49,16 @@ void setup() {
     uint8_t deviceID = calculateDeviceID();
     Serial.printf("Device ID: %d\n", deviceID);
     
+    // Load output calibration before the first DAC write
+    initCalibration();
+    
     // Initialize DAC controllers
     initDACControllers();
     Serial.println("DAC controllers initialized");
     
+    // Start asynchronous DAC output worker
+    initDacOutputQueue();
+    
     // Initialize relay controller
     initRelayController();
     Serial.println("Relay controller initialized");
@@ -53,18 +72,32 @@ void setup() {
     initSineWaveGenerator();
     Serial.println("Sine wave generator initialized");
     
-    // Initialize RS-485 serial communication (暂时禁用第一路RS-485)
-    // initRS485Serial();
+    // Initialize arbitrary waveform player
+    initWaveformPlayer();
+    
+    // Initialize setpoint profile sequencer
+    initProfileSequencer();
+    
+    // Output shaping stage (pass-through until configured)
+    initOutputStage();
     
-    // Initialize RS-485 command handler (暂时禁用第一路RS-485)
-    // initRS485CommandHandler();
+    // Start sample clock driving all signal sources
+    initSampleOutput();
+    
+    // Initialize work-mode RS-485 link (UART2; UART1 belongs to the Modbus slave)
+    initRS485Serial();
+    
+    // Initialize RS-485 command handler
+    initRS485CommandHandler();
     
     // Initialize Modbus slave
     initModbus();
+    initTotalizer();
+    initTraceReplay();
     
     Serial.println("System initialization complete");
     Serial.println("USB Serial: Debug output only");
-    Serial.println("RS-485 Serial: DISABLED (GPIO 19=TX, 18=RX) - 功能待定义");
+    Serial.println("RS-485 Serial: Work mode commands (GPIO 19=TX, 18=RX)");
     Serial.println("Modbus Slave: Interface (GPIO 17=TX, 16=RX)");
     Serial.println("Ready to receive commands...");
 }
@@ -73,17 +106,12 @@ void loop() {
     // Process USB Serial commands
     handleUSBSerialCommands();
     
-    // Process RS-485 commands (暂时禁用第一路RS-485)
-    // if (handleRS485Commands()) {
-    //     // Command was processed, no need to do anything else
-    //     // The command handler will send responses automatically
-    // }
+    // Process RS-485 commands (the command handler sends responses itself)
+    handleRS485Commands();
     
-    // Handle Modbus slave tasks
-    mb.task();
+    // Modbus requests are handled by the RTU receiver task (see modbus_rtu_receiver.cpp)
     
-    // Update sine wave generator
-    updateSineWave();
+    // Sine, waveform and profile output run from the sample clock task (see sample_output.cpp)
     
     // Periodic status report disabled - use 'status' command instead
     // if (millis() - lastStatusReport >= STATUS_REPORT_INTERVAL) {
@@ -126,6 +154,12 @@ void printStatusReport() {
                 Serial.printf("SIG%d: %s mode, SINE WAVE (%.2f%s amplitude, %.1fs period, center %.2f%s)\n", 
                              i + 1, modeStr, amplitude, unit, period, center, unit);
             }
+        } else if (isProfileActiveOnChannel(i)) {
+            Serial.printf("SIG%d: %s mode, PROFILE RUNNING (see PROFILE STATUS)\n",
+                         i + 1, (signalModes[i] == 'v') ? "voltage" : "current");
+        } else if (isWaveformActiveOnChannel(i)) {
+            Serial.printf("SIG%d: %s mode, WAVEFORM PLAYBACK (see AWG STATUS)\n",
+                         i + 1, (signalModes[i] == 'v') ? "voltage" : "current");
         } else {
             // Display normal manual mode values
             char mode = signalModes[i];
@@ -141,6 +175,10 @@ void printStatusReport() {
         }
     }
     
+    // DAC output queue and bus statistics
+    printDacQueueStatus();
+    printDacBusStatus();
+    
     Serial.println("==================\n");
 }
 
@@ -185,6 +223,10 @@ void handleUSBSerialCommands() {
         String command = Serial.readStringUntil('\n');
         command.trim();
         
+        // Outputs change under the lock shared with Modbus control writes; the
+        // Modbus output control block is refreshed when the command is done
+        OutputLockScope outputLock;
+        
         // Convert to lowercase for most commands, but keep modbus commands case-sensitive
         String lowerCommand = command;
         lowerCommand.toLowerCase();
@@ -196,7 +238,9 @@ void handleUSBSerialCommands() {
                 lowerCommand.startsWith("exit_modbus") || lowerCommand.startsWith("modbus") ||
                 lowerCommand.startsWith("measure") || lowerCommand.startsWith("flow") ||
                 lowerCommand.startsWith("consumption") || lowerCommand.startsWith("reverse") ||
-                lowerCommand.startsWith("direction") || lowerCommand.startsWith("slave")) {
+                lowerCommand.startsWith("direction") || lowerCommand.startsWith("slave") ||
+                lowerCommand.startsWith("meter") || lowerCommand.startsWith("totalizer") ||
+                lowerCommand.startsWith("trace")) {
                 // Allow these commands in modbus mode
             } else {
                 Serial.println("Command blocked: System is in Modbus mode.");
@@ -209,7 +253,9 @@ void handleUSBSerialCommands() {
                 // Allow exit_modbus in analog mode (it will just confirm we're already in analog mode)
             } else if (lowerCommand.startsWith("measure") || lowerCommand.startsWith("flow") ||
                 lowerCommand.startsWith("consumption") || lowerCommand.startsWith("reverse") ||
-                lowerCommand.startsWith("direction") || lowerCommand.startsWith("slave")) {
+                lowerCommand.startsWith("direction") || lowerCommand.startsWith("slave") ||
+                lowerCommand.startsWith("meter") || lowerCommand.startsWith("totalizer") ||
+                lowerCommand.startsWith("trace")) {
                 Serial.println("Command blocked: System is in Analog mode.");
                 Serial.println("Use 'modbus <slave_id>' to enter Modbus mode first.");
                 return;
@@ -218,12 +264,29 @@ void handleUSBSerialCommands() {
         }
         
         if (lowerCommand.startsWith("ping")) {
-            // Send ping command via RS-485 (暂时禁用第一路RS-485)
-            Serial.println("RS-485功能暂时禁用，等待功能定义");
+            // Send ping command via RS-485
+            sendTestRS485Command(CMD_PING, nullptr, 0);
         }
         else if (lowerCommand.startsWith("test485")) {
-            // Test RS-485 connection (暂时禁用第一路RS-485)
-            Serial.println("RS-485功能暂时禁用，等待功能定义");
+            // Test RS-485 connection
+            testRS485Connection();
+        }
+        else if (lowerCommand.startsWith("rs485")) {
+            // Work-mode RS-485 link: rs485 [status|clear|crc|legacy]
+            String action = lowerCommand.substring(5);
+            action.trim();
+            if (action == "crc") {
+                setRS485Framing(RS485_FRAMING_CRC);
+            } else if (action == "legacy") {
+                setRS485Framing(RS485_FRAMING_LEGACY);
+            } else if (action == "clear") {
+                clearRS485LinkStats();
+                Serial.println("RS-485 counters cleared");
+            } else if (action.length() == 0 || action == "status") {
+                printRS485LinkStatus();
+            } else {
+                Serial.println("Usage: rs485 [status|clear|crc|legacy]");
+            }
         }
         else if (lowerCommand.startsWith("status")) {
             // Show local system status
@@ -253,6 +316,26 @@ void handleUSBSerialCommands() {
                 Serial.println("Invalid current value (0-25mA)");
             }
         }
+        else if (lowerCommand.startsWith("dac_refresh")) {
+            // Rewrite all DAC channels from the shadow cache (bus error recovery)
+            refreshDacOutputs();
+        }
+        else if (lowerCommand.startsWith("cal ") || lowerCommand == "cal") {
+            // Multipoint output calibration
+            parseCalibrationCommand(command);
+        }
+        else if (lowerCommand.startsWith("stage")) {
+            // Output slew-rate limiter and smoothing filter
+            parseOutputStageCommand(command);
+        }
+        else if (lowerCommand.startsWith("profile")) {
+            // Setpoint profile sequencer
+            parseProfileCommand(command);
+        }
+        else if (lowerCommand.startsWith("awg")) {
+            // Arbitrary waveform playback
+            parseWaveformCommand(command);
+        }
         else if (lowerCommand.startsWith("sine")) {
             // Handle sine wave commands directly
             parseSineWaveCommand(command);
@@ -285,6 +368,27 @@ void handleUSBSerialCommands() {
                 Serial.println("Invalid direction. Use 0 (same) or 1 (reverse).");
             }
         }
+        else if (lowerCommand.startsWith("modbus_stats")) {
+            // Show receiver statistics and response latency: modbus_stats [clear]
+            printModbusReceiverStats();
+            if (lowerCommand.indexOf("clear") > 0) {
+                clearModbusReceiverStats();
+                Serial.println("Modbus receiver statistics cleared");
+            }
+        }
+        else if (lowerCommand.startsWith("modbus_heap")) {
+            // Heap use of the library pipeline vs the RTU receiver: modbus_heap [frames]
+            long frames = lowerCommand.substring(11).toInt();
+            measureModbusHeap(frames > 0 ? (uint32_t)frames : 100);
+        }
+        else if (lowerCommand.startsWith("modbus_bench")) {
+            // Compare register image with the library register search
+            runModbusImageBenchmark();
+        }
+        else if (lowerCommand.startsWith("modbus_control")) {
+            // Show the analog output control block (holding registers 100-123)
+            printOutputControl();
+        }
         else if (lowerCommand.startsWith("modbus")) {
             // Enter modbus mode: modbus <slave_id>
             uint8_t slaveID = command.substring(7).toInt();
@@ -294,6 +398,33 @@ void handleUSBSerialCommands() {
             // Exit modbus mode
             exitModbusMode();
         }
+        else if (lowerCommand.startsWith("slaves")) {
+            // Virtual meters: slaves | slaves add|remove|select <id>
+            String params = lowerCommand.substring(6);
+            params.trim();
+            int space = params.indexOf(' ');
+            String action = (space == -1) ? params : params.substring(0, space);
+            int slaveID = (space == -1) ? -1 : params.substring(space + 1).toInt();
+            if (action.length() == 0 || action == "list") {
+                printVirtualMeters();
+            } else if (slaveID < 1 || slaveID > 247) {
+                Serial.println("Usage: slaves [list] | slaves add|remove|select <id> (id 1-247)");
+            } else if (action == "add") {
+                if (addVirtualMeter(slaveID) != VIRTUAL_METER_NONE) {
+                    Serial.printf("Virtual meter added: slave %d (registers empty)\n", slaveID);
+                }
+            } else if (action == "remove") {
+                if (removeVirtualMeter(slaveID)) {
+                    Serial.printf("Virtual meter removed: slave %d, selected slave %d\n", slaveID, currentSlaveID);
+                }
+            } else if (action == "select") {
+                if (selectVirtualMeter(slaveID)) {
+                    Serial.printf("Selected slave %d for measurement commands\n", slaveID);
+                }
+            } else {
+                Serial.println("Usage: slaves [list] | slaves add|remove|select <id> (id 1-247)");
+            }
+        }
         else if (lowerCommand.startsWith("slave")) {
             // Set slave ID: slave <id> (only in modbus mode)
             if (isModbusModeActive()) {
@@ -303,6 +434,46 @@ void handleUSBSerialCommands() {
                 Serial.println("Use 'modbus <slave_id>' to enter Modbus mode first.");
             }
         }
+        else if (lowerCommand.startsWith("trace")) {
+            // Measurement trace replay: TRACE BEGIN/DATA/END/START/STOP/STATUS
+            parseTraceCommand(command);
+        }
+        else if (lowerCommand.startsWith("totalizer")) {
+            // Flow totalizer: totalizer start|stop|status
+            String action = lowerCommand.substring(9);
+            action.trim();
+            if (action == "start") {
+                startTotalizer(getSelectedMeter());
+            } else if (action == "stop") {
+                stopTotalizer(getSelectedMeter());
+            } else if (action.length() == 0 || action == "status") {
+                printTotalizerStatus(getSelectedMeter());
+            } else {
+                Serial.println("Usage: totalizer start|stop|status");
+            }
+        }
+        else if (lowerCommand.startsWith("meter")) {
+            // Register map: meter list | meter <name> <value>
+            String params = command.substring(5);
+            params.trim();
+            int space = params.indexOf(' ');
+            if (params.length() == 0 || params.equalsIgnoreCase("list")) {
+                printMeterRegisterMap(getSelectedMeter());
+            } else if (space > 0) {
+                String name = params.substring(0, space);
+                int id = findMeterRegister(name.c_str());
+                if (id < 0) {
+                    Serial.printf("Unknown meter register: %s (use 'meter list')\n", name.c_str());
+                } else {
+                    double value = params.substring(space + 1).toDouble();
+                    setMeterValueById(getSelectedMeter(), id, value);
+                    Serial.printf("%s set to %.3f %s (Register %u)\n", meterRegisterMap[id].name, value,
+                                  meterRegisterMap[id].unit, meterRegisterMap[id].address);
+                }
+            } else {
+                Serial.println("Usage: meter list | meter <name> <value>");
+            }
+        }
         else if (lowerCommand.startsWith("measure")) {
             // Set all measurements: measure <flow> <consumption> <reverse> <direction>
             String params = command.substring(8); // Remove "measure "
@@ -349,8 +520,8 @@ void handleUSBSerialCommands() {
                             // Then set value using signal mapping
                             if (mode == 'v') {
                                 if (value >= 0 && value <= 10) {
-                                    // Use signal mapping to set correct DAC and channel
-                                    signalMap[channel - 1].voltageDAC->setVoltage(value, signalMap[channel - 1].voltageChannel);
+                                    // Queue setpoint for the signal's voltage DAC (shaped if the output stage is on)
+                                    postSetpointCode(channel - 1, 'v', voltageToDacCode(value));
                                     signalValues[channel - 1] = value; // Update signal value
                                     Serial.printf("Channel %d set to VOLTAGE mode, output %.2fV\n", channel, value);
                                     // Trigger status report after successful voltage setting
@@ -360,9 +531,8 @@ void handleUSBSerialCommands() {
                                 }
                             } else if (mode == 'c') {
                                 if (value >= 0 && value <= 25) {
-                                    // Use signal mapping to set correct DAC
-                                    // Convert mA to DAC data: Rset=2kΩ, 25mA = 32767 (15-bit), so 1mA = 1310.68
-                                    signalMap[channel - 1].currentDAC->setDACOutElectricCurrent(static_cast<uint16_t>(value * 1310.68));
+                                    // Queue setpoint for the signal's current DAC (shaped if the output stage is on)
+                                    postSetpointCode(channel - 1, 'c', currentToDacCode(value));
                                     signalValues[channel - 1] = value; // Update signal value
                                     Serial.printf("Channel %d set to CURRENT mode, output %.2fmA\n", channel, value);
                                     // Trigger status report after successful current setting
@@ -411,6 +581,8 @@ void handleUSBSerialCommands() {
             Serial.println("");
             Serial.println("Starting monitoring...");
             
+            // The RTU receiver owns Serial1: hand the port to this loop for the test
+            detachModbusReceiver();
             unsigned long startTime = millis();
             int requestCount = 0;
             int totalBytes = 0;
@@ -449,6 +621,8 @@ void handleUSBSerialCommands() {
                 delay(10);
             }
             
+            attachModbusReceiver();
+            
             Serial.printf("Test complete. Received %d data packets, %d total bytes.\n", requestCount, totalBytes);
             Serial.printf("Sent %d Modbus responses.\n", modbusResponses);
             
@@ -467,40 +641,6 @@ void handleUSBSerialCommands() {
             }
             Serial.println("=============================");
         }
-        else if (lowerCommand.startsWith("serial_test")) {
-            // Simple Serial2 loopback test
-            Serial.println("=== Serial2 Loopback Test ===");
-            Serial.println("This test will send data via Serial2 TX and read it back via RX");
-            Serial.println("Connect GPIO 16 (RX) to GPIO 17 (TX) with a jumper wire");
-            Serial.println("Starting test in 3 seconds...");
-            delay(3000);
-            
-            const char* testMessage = "ESP32 Serial2 Test Message";
-            Serial.printf("Sending: %s\n", testMessage);
-            Serial2.write(testMessage);
-            Serial2.write('\n');
-            
-            delay(100); // Wait for data to be sent
-            
-            Serial.println("Reading back data...");
-            String received = "";
-            unsigned long startTime = millis();
-            while (millis() - startTime < 2000) {
-                if (Serial2.available()) {
-                    received += (char)Serial2.read();
-                }
-                delay(10);
-            }
-            
-            if (received.length() > 0) {
-                Serial.printf("Received: %s\n", received.c_str());
-                Serial.println("Loopback test PASSED - Serial2 is working!");
-            } else {
-                Serial.println("Loopback test FAILED - No data received");
-                Serial.println("Check jumper wire connection between GPIO 16 and 17");
-            }
-            Serial.println("=============================");
-        }
         else if (lowerCommand.startsWith("send_modbus")) {
             // Send a test Modbus request
             Serial.println("=== Send Test Modbus Request ===");
@@ -524,6 +664,7 @@ void handleUSBSerialCommands() {
             }
             Serial.println();
             
+            detachModbusReceiver(); // Read the reply here, not in the RTU receiver
             Serial1.write(request, 8);
             Serial1.flush();
             Serial.println("Request sent via Serial1");
@@ -538,6 +679,7 @@ void handleUSBSerialCommands() {
                 }
                 delay(10);
             }
+            attachModbusReceiver();
             
             if (response.length() > 0) {
                 Serial.printf("Received response (%d bytes): ", response.length());
@@ -580,7 +722,16 @@ void printHelp() {
         Serial.println("consumption <value>     - Set consumption (Register 8)");
         Serial.println("reverse <value>         - Set reverse consumption (Register 14)");
         Serial.println("direction <0|1>         - Set flow direction (Register 42)");
-        Serial.println("slave <id>              - Change slave ID (1-247)");
+        Serial.println("slave <id>              - Change slave ID of the selected meter (1-247)");
+        Serial.println("slaves [list]           - Show virtual meters and memory per meter");
+        Serial.println("slaves add|remove <id>  - Serve / stop serving another slave ID");
+        Serial.println("slaves select <id>      - Select meter for measurement commands");
+        Serial.println("meter <name> <value>    - Set any register of the meter map");
+        Serial.println("meter list              - Show register map and contents");
+        Serial.println("totalizer start|stop|status - Integrate flow into consumption registers");
+        Serial.println("TRACE BEGIN [speed]     - Prepare trace replay (1 = real time)");
+        Serial.println("TRACE DATA <t> <f> <c> <r> <d>; ... - Stream trace records (t in ms)");
+        Serial.println("TRACE START|END|STOP|STATUS - Control trace playback");
     } else {
         Serial.println("=== ANALOG MODE ACTIVE ===");
         Serial.println("Mode Commands:");
@@ -595,17 +746,49 @@ void printHelp() {
         Serial.println("");
         Serial.println("SINE START <amp> <period> <center> <signal> <mode> - Start sine wave");
         Serial.println("  Example: SINE START 2.0 2.0 5.0 1 V");
+        Serial.println("SINE ARM <amp> <period> <center> <signal> <mode> [phase] - Arm sine wave");
+        Serial.println("SINE TRIGGER            - Start all armed sine waves from one epoch");
+        Serial.println("SINE CHIRP <amp> <p0> <p1> <sweep> <center> <signal> <mode> [LIN|LOG] [ONCE|REPEAT|BOUNCE] [ARM]");
+        Serial.println("                        - Frequency sweep from period p0 to p1 in sweep seconds");
         Serial.println("SINE STOP [signal]      - Stop sine wave");
         Serial.println("SINE STATUS             - Show sine wave status");
+        Serial.println("dac_refresh             - Force rewrite of all DAC outputs");
+        Serial.println("SINE BENCH              - Benchmark DDS engine vs float sin()");
+        Serial.println("SINE RATE [hz]          - Set/show sample clock rate (1-2000 Hz)");
+        Serial.println("AWG SHAPE <sig> <mode> <TRI|SQUARE|SAW|STEP> <low> <high> <samples> [hold]");
+        Serial.println("                        - Play built-in waveform");
+        Serial.println("AWG LOAD/DATA/COMMIT    - Load custom waveform (AWG LOAD <sig> <mode>,");
+        Serial.println("                          AWG DATA <sig> <v1> <v2> ..., AWG COMMIT <sig> [hold])");
+        Serial.println("AWG STOP [sig]          - Stop waveform playback");
+        Serial.println("AWG STATUS              - Show playback state and sample memory");
+        Serial.println("PROFILE LOAD <sig> <mode> <seg>; <seg>; ... [| <sig> <mode> ...]");
+        Serial.println("                        - Load profile (STEP v, RAMP v s, HOLD s, LOOP n)");
+        Serial.println("  Example: PROFILE LOAD 3 V STEP 0; RAMP 2.0 10; HOLD 5; LOOP 3");
+        Serial.println("PROFILE START [sig ...] - Start loaded profiles in the same tick");
+        Serial.println("PROFILE STOP [sig]      - Stop profile, output keeps last value");
+        Serial.println("PROFILE STATUS          - Show profile progress");
+        Serial.println("stage <sig> slew <rate|off> - Limit slew rate (V/s or mA/s)");
+        Serial.println("stage <sig> filter <tau|off> - Smoothing filter time constant (s)");
+        Serial.println("stage <sig> off         - Disable output shaping");
+        Serial.println("stage status            - Show output stage settings");
+        Serial.println("cal <sig> <v|c> <nominal> <measured> - Add calibration point");
+        Serial.println("  Example: cal 1 v 5.0 4.97 - SIG1 set to 5.0V measured 4.97V");
+        Serial.println("cal clear <sig> <v|c>   - Clear calibration of a signal");
+        Serial.println("cal show                - Show calibration points");
         Serial.println("");
     }
     
     Serial.println("System Commands:");
-    Serial.println("ping                    - Send ping command via RS-485 (暂时禁用)");
-    Serial.println("test485                 - Test RS-485 connection (暂时禁用)");
+    Serial.println("ping                    - Send ping command via RS-485");
+    Serial.println("test485                 - Test RS-485 connection");
+    Serial.println("rs485 [status|clear]    - Show work-mode RS-485 framing and receive counters");
+    Serial.println("rs485 crc|legacy        - Select RS-485 frame format (default crc)");
     Serial.println("status                  - Show local system status");
     Serial.println("modbus_test             - Test Modbus connection and show configuration");
-    Serial.println("serial_test             - Test Serial2 loopback (connect GPIO 16 to 17)");
+    Serial.println("modbus_stats [clear]    - Show Modbus frame counters and response latency");
+    Serial.println("modbus_heap [frames]    - Compare heap use of ModbusRTU::task() and the RTU receiver");
+    Serial.println("modbus_bench            - Benchmark Modbus register image vs library lookup");
+    Serial.println("modbus_control          - Show Modbus output control registers 100-123");
     Serial.println("send_modbus             - Send test Modbus request");
     Serial.println("help                    - Show this help");
     Serial.println("========================================\n");
@@ -0,0 +1,169 @@
+#include "meter_register_map.h"
+#include "virtual_meters.h"
+#include <string.h>
+
+/**
+ * Convert an engineering value to raw bits for a row
+ */
+uint64_t meterRawFromValue(const MeterRegister& row, double value) {
+    double scaled = (row.scale != 0.0f) ? value / row.scale : value;
+    switch (row.type) {
+        case TYPE_FLOAT: {
+            float asFloat = (float)scaled;
+            uint32_t bits;
+            memcpy(&bits, &asFloat, sizeof(bits));
+            return bits;
+        }
+        case TYPE_U32:
+            if (scaled <= 0) return 0;
+            if (scaled >= 4294967295.0) return 0xFFFFFFFFULL;
+            return (uint64_t)llround(scaled);
+        case TYPE_U64:
+            if (scaled <= 0) return 0;
+            if (scaled >= 18446744073709551615.0) return 0xFFFFFFFFFFFFFFFFULL;
+            return (uint64_t)scaled;
+        case TYPE_INT16:
+        default: {
+            long rounded = lround(scaled);
+            if (rounded < -32768) rounded = -32768;
+            if (rounded > 32767) rounded = 32767;
+            return (uint16_t)(int16_t)rounded;
+        }
+    }
+}
+
+/**
+ * Convert raw bits of a row to an engineering value
+ */
+double meterValueFromRaw(const MeterRegister& row, uint64_t raw) {
+    if (row.type == TYPE_FLOAT) {
+        uint32_t bits = (uint32_t)raw;
+        float asFloat;
+        memcpy(&asFloat, &bits, sizeof(asFloat));
+        return asFloat * (double)row.scale;
+    }
+    if (row.type == TYPE_INT16) {
+        return (int16_t)raw * (double)row.scale;
+    }
+    return raw * (double)row.scale;
+}
+
+/**
+ * Encode a raw value of a row into an image write
+ */
+bool encodeMeterWrite(uint8_t id, uint64_t raw, ImageWrite* write) {
+    if (id >= METER_REGISTER_COUNT) {
+        return false;
+    }
+    const MeterRegister& row = meterRegisterMap[id];
+    write->address = row.address;
+    write->count = meterTypeWords(row.type);
+    switch (row.type) {
+        case TYPE_FLOAT: encodeMeterWords<TYPE_FLOAT>(raw, row.order, write->words); break;
+        case TYPE_U32:   encodeMeterWords<TYPE_U32>(raw, row.order, write->words); break;
+        case TYPE_U64:   encodeMeterWords<TYPE_U64>(raw, row.order, write->words); break;
+        case TYPE_INT16: encodeMeterWords<TYPE_INT16>(raw, row.order, write->words); break;
+    }
+    return true;
+}
+
+/**
+ * Read the raw value of a row from the image
+ */
+bool getMeterRaw(uint8_t meter, uint8_t id, uint64_t* raw) {
+    if (id >= METER_REGISTER_COUNT) {
+        return false;
+    }
+    const MeterRegister& row = meterRegisterMap[id];
+    uint8_t count = meterTypeWords(row.type);
+    uint16_t words[4];
+    if (!readImageRegisters(meter, row.address, words, count)) {
+        return false;
+    }
+
+    // Reassemble raw bits from the words in wire order
+    *raw = 0;
+    for (uint8_t w = 0; w < count; w++) {
+        uint16_t word = words[(row.order == WORD_ORDER_1032) ? w : count - 1 - w];
+        *raw |= (uint64_t)word << (16 * w);
+    }
+    return true;
+}
+
+/**
+ * Read the engineering value of a row from the image
+ */
+double getMeterValue(uint8_t meter, uint8_t id) {
+    uint64_t raw;
+    if (!getMeterRaw(meter, id, &raw)) {
+        return 0;
+    }
+    return meterValueFromRaw(meterRegisterMap[id], raw);
+}
+
+/**
+ * Write a raw value by runtime id
+ */
+bool setMeterRawById(uint8_t meter, uint8_t id, uint64_t raw) {
+    ImageWrite write;
+    if (!encodeMeterWrite(id, raw, &write)) {
+        return false;
+    }
+    return writeImageBatch(meter, &write, 1);
+}
+
+/**
+ * Write an engineering value by runtime id
+ */
+bool setMeterValueById(uint8_t meter, uint8_t id, double value) {
+    if (id >= METER_REGISTER_COUNT) {
+        return false;
+    }
+    return setMeterRawById(meter, id, meterRawFromValue(meterRegisterMap[id], value));
+}
+
+/**
+ * Find a register by name
+ */
+int findMeterRegister(const char* name) {
+    for (int i = 0; i < METER_REGISTER_COUNT; i++) {
+        if (strcasecmp(name, meterRegisterMap[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Mark read-only registers in the register image
+ */
+void initMeterRegisterMap(uint8_t meter) {
+    for (int i = 0; i < METER_REGISTER_COUNT; i++) {
+        const MeterRegister& row = meterRegisterMap[i];
+        setImageRegisterAccess(meter, row.address, meterTypeWords(row.type), row.access == ACCESS_READ_WRITE);
+    }
+}
+
+/**
+ * Print the register map with current register contents
+ */
+void printMeterRegisterMap(uint8_t meter) {
+    static const char* typeNames[] = {"U64", "FLOAT", "INT16", "U32"};
+    Serial.printf("=== METER REGISTER MAP (slave %d) ===\n", getVirtualMeterSlaveID(meter));
+    for (int i = 0; i < METER_REGISTER_COUNT; i++) {
+        const MeterRegister& row = meterRegisterMap[i];
+        uint8_t count = meterTypeWords(row.type);
+        uint16_t words[4];
+        readImageRegisters(meter, row.address, words, count);
+        double value = getMeterValue(meter, i);
+
+        Serial.printf("%-12s reg %3u %-5s %s %s %.3f %s [", row.name, row.address, typeNames[row.type],
+                      (row.order == WORD_ORDER_1032) ? "1-0-3-2" : "3-2-1-0",
+                      (row.access == ACCESS_READ_WRITE) ? "RW" : "RO", value, row.unit);
+        for (uint8_t w = 0; w < count; w++) {
+            Serial.printf("%s%04X", w ? " " : "", words[w]);
+        }
+        Serial.println("]");
+    }
+    Serial.println("==========================");
+}
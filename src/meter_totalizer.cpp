@@ -0,0 +1,209 @@
+#include "meter_totalizer.h"
+#include "meter_register_map.h"
+#include "virtual_meters.h"
+#include <math.h>
+
+// Totalizer state of one virtual meter
+struct TotalizerState {
+    bool running;
+    uint64_t forwardMicro;      // Totals in 1e-6 m3
+    uint64_t reverseMicro;
+    double remainderMicro;      // Sub-micro remainder carried between ticks
+    uint64_t forwardRegister;   // Register contents last written (to detect external writes)
+    uint64_t reverseRegister;
+    uint32_t lastTickUs;
+    uint32_t tickCount;
+    uint32_t maxTickIntervalUs;
+};
+
+static TaskHandle_t totalizerTaskHandle = nullptr;
+static portMUX_TYPE totalizerMux = portMUX_INITIALIZER_UNLOCKED;
+static TotalizerState totalizers[MODBUS_MAX_METERS];
+
+/**
+ * Total units (1e-6 m3) per raw count of a register
+ */
+static uint64_t microPerCount(uint8_t id) {
+    uint64_t micro = (uint64_t)llround(meterRegisterMap[id].scale * (double)TOTALIZER_MICRO_PER_UNIT);
+    return (micro > 0) ? micro : 1;
+}
+
+/**
+ * Raw register value for a total, truncated to the register width (meter rollover)
+ */
+static uint64_t registerFromTotal(uint8_t id, uint64_t totalMicro) {
+    uint64_t raw = totalMicro / microPerCount(id);
+    uint8_t bits = 16 * meterTypeWords(meterRegisterMap[id].type);
+    return (bits >= 64) ? raw : raw & ((1ULL << bits) - 1);
+}
+
+/**
+ * Take a register value written by someone else as the new total
+ */
+static void syncTotal(uint8_t meter, uint8_t id, uint64_t* totalMicro, uint64_t* lastRegister) {
+    uint64_t raw;
+    getMeterRaw(meter, id, &raw);
+    if (raw != *lastRegister) {
+        *totalMicro = raw * microPerCount(id);
+        *lastRegister = raw;
+    }
+}
+
+/**
+ * Integrate flow over the time since the last tick and update the registers
+ */
+static void totalizerTick(uint8_t meter) {
+    TotalizerState& state = totalizers[meter];
+    uint32_t now = micros();
+    uint32_t elapsedUs = now - state.lastTickUs;
+    state.lastTickUs = now;
+
+    double flow = getMeterValue(meter, METER_FLOW); // m3/h
+
+    portENTER_CRITICAL(&totalizerMux);
+    syncTotal(meter, METER_CONSUMPTION, &state.forwardMicro, &state.forwardRegister);
+    syncTotal(meter, METER_REVERSE_CONSUMPTION, &state.reverseMicro, &state.reverseRegister);
+
+    // m3/h * us / 3600 = 1e-6 m3
+    double volume = fabs(flow) * elapsedUs / 3600.0 + state.remainderMicro;
+    uint64_t whole = (uint64_t)volume;
+    state.remainderMicro = volume - whole;
+    if (flow < 0) {
+        state.reverseMicro += whole;
+    } else {
+        state.forwardMicro += whole;
+    }
+    state.forwardRegister = registerFromTotal(METER_CONSUMPTION, state.forwardMicro);
+    state.reverseRegister = registerFromTotal(METER_REVERSE_CONSUMPTION, state.reverseMicro);
+
+    state.tickCount++;
+    if (state.tickCount > 1 && elapsedUs > state.maxTickIntervalUs) {
+        state.maxTickIntervalUs = elapsedUs;
+    }
+    uint64_t forward = state.forwardRegister;
+    uint64_t reverse = state.reverseRegister;
+    portEXIT_CRITICAL(&totalizerMux);
+
+    ImageWrite writes[3];
+    uint8_t count = 2;
+    encodeMeterWrite(METER_CONSUMPTION, forward, &writes[0]);
+    encodeMeterWrite(METER_REVERSE_CONSUMPTION, reverse, &writes[1]);
+    if (flow != 0) {
+        encodeMeterWrite(METER_FLOW_DIRECTION, (flow < 0) ? 1 : 0, &writes[count++]);
+    }
+    writeImageBatch(meter, writes, count);
+}
+
+/**
+ * Totalizer task: fixed-period tick for all running meters, elapsed time measured with micros()
+ */
+static void totalizerTask(void* param) {
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(TOTALIZER_TICK_MS));
+        for (uint8_t meter = 0; meter < MODBUS_MAX_METERS; meter++) {
+            if (totalizers[meter].running) {
+                totalizerTick(meter);
+            }
+        }
+    }
+}
+
+/**
+ * Create the totalizer task (all meters stopped)
+ */
+void initTotalizer() {
+    memset(totalizers, 0, sizeof(totalizers));
+    xTaskCreatePinnedToCore(totalizerTask, "totalizer", TOTALIZER_TASK_STACK, nullptr,
+                            TOTALIZER_TASK_PRIORITY, &totalizerTaskHandle, TOTALIZER_TASK_CORE);
+}
+
+/**
+ * Start integrating flow
+ */
+void startTotalizer(uint8_t meter) {
+    if (!isVirtualMeterActive(meter)) {
+        return;
+    }
+    uint64_t forward, reverse;
+    getMeterRaw(meter, METER_CONSUMPTION, &forward);
+    getMeterRaw(meter, METER_REVERSE_CONSUMPTION, &reverse);
+
+    TotalizerState& state = totalizers[meter];
+    portENTER_CRITICAL(&totalizerMux);
+    state.forwardRegister = forward;
+    state.reverseRegister = reverse;
+    state.forwardMicro = forward * microPerCount(METER_CONSUMPTION);
+    state.reverseMicro = reverse * microPerCount(METER_REVERSE_CONSUMPTION);
+    state.remainderMicro = 0;
+    state.tickCount = 0;
+    state.maxTickIntervalUs = 0;
+    state.lastTickUs = micros();
+    state.running = true;
+    portEXIT_CRITICAL(&totalizerMux);
+
+    Serial.printf("Totalizer started (slave %d): flow %.3f m3/h, tick %d ms\n", getVirtualMeterSlaveID(meter),
+                  getMeterValue(meter, METER_FLOW), TOTALIZER_TICK_MS);
+}
+
+/**
+ * Stop integrating
+ */
+void stopTotalizer(uint8_t meter) {
+    if (meter >= MODBUS_MAX_METERS) {
+        return;
+    }
+    totalizers[meter].running = false;
+    Serial.printf("Totalizer stopped (slave %d), registers keep their last values\n", getVirtualMeterSlaveID(meter));
+}
+
+/**
+ * Stop and clear a meter's totalizer
+ */
+void resetTotalizer(uint8_t meter) {
+    if (meter >= MODBUS_MAX_METERS) {
+        return;
+    }
+    portENTER_CRITICAL(&totalizerMux);
+    memset(&totalizers[meter], 0, sizeof(TotalizerState));
+    portEXIT_CRITICAL(&totalizerMux);
+}
+
+/**
+ * Check whether a meter's totalizer is running
+ */
+bool isTotalizerRunning(uint8_t meter) {
+    return meter < MODBUS_MAX_METERS && totalizers[meter].running;
+}
+
+/**
+ * Get memory used by one meter's totalizer
+ */
+size_t getTotalizerBytes() {
+    return sizeof(TotalizerState);
+}
+
+/**
+ * Print totals and tick statistics
+ */
+void printTotalizerStatus(uint8_t meter) {
+    if (meter >= MODBUS_MAX_METERS) {
+        return;
+    }
+    portENTER_CRITICAL(&totalizerMux);
+    TotalizerState state = totalizers[meter];
+    portEXIT_CRITICAL(&totalizerMux);
+
+    Serial.printf("=== TOTALIZER (slave %d) ===\n", getVirtualMeterSlaveID(meter));
+    Serial.printf("State: %s, flow %.3f m3/h\n", state.running ? "RUNNING" : "STOPPED",
+                  getMeterValue(meter, METER_FLOW));
+    Serial.printf("Forward total: %.6f m3 (Register 8 = %.0f)\n",
+                  state.forwardMicro / (double)TOTALIZER_MICRO_PER_UNIT, getMeterValue(meter, METER_CONSUMPTION));
+    Serial.printf("Reverse total: %.6f m3 (Register 14 = %.0f)\n",
+                  state.reverseMicro / (double)TOTALIZER_MICRO_PER_UNIT,
+                  getMeterValue(meter, METER_REVERSE_CONSUMPTION));
+    Serial.printf("Direction: %.0f (Register 42)\n", getMeterValue(meter, METER_FLOW_DIRECTION));
+    Serial.printf("Ticks: %lu, longest interval: %lu us (nominal %d us)\n",
+                  (unsigned long)state.tickCount, (unsigned long)state.maxTickIntervalUs, TOTALIZER_TICK_MS * 1000);
+    Serial.println("=================");
+}
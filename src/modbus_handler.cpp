@@ -4,6 +4,16 @@
 #include "relay_controller.h"
 #include "command_handler.h"
 #include "utils.h"
+#include "dac_output_queue.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "modbus_register_image.h"
+#include "meter_register_map.h"
+#include "modbus_rtu_receiver.h"
+#include "virtual_meters.h"
+#include "output_control.h"
+#include "output_stage.h"
+#include "sample_output.h"
 
 // Modbus instance
 ModbusRTU mb;
@@ -30,12 +40,17 @@ uint16_t highWord(uint32_t dword) {
 
 void initModbus() {
     // Initialize Serial1 with explicit pin configuration (like working code)
+    Serial1.setRxBufferSize(MODBUS_RX_BUFFER_SIZE); // Must be set before begin()
     Serial1.begin(BAUDRATE, PARITY, MODBUS_RX_PIN, MODBUS_TX_PIN);
     delay(100); // Give Serial1 time to initialize
     
     // Initialize Modbus with Serial1 (like working code)
     mb.begin(&Serial1);
     mb.slave(currentSlaveID);
+    initModbusRegisterImage();
+    initVirtualMeters(currentSlaveID);
+    initOutputControl();
+    initModbusReceiver(); // Requests are answered from UART events, not from loop()
     
     Serial.printf("Modbus interface initialized: RX=GPIO%d, TX=GPIO%d, Baud=%d, Parity=8E1\n", 
                   MODBUS_RX_PIN, MODBUS_TX_PIN, BAUDRATE);
@@ -45,8 +60,18 @@ void initModbus() {
 
 void enterModbusMode(uint8_t slaveID) {
     if (slaveID >= 1 && slaveID <= 247) {
+        // Select the meter with this ID, or give the selected meter this ID
+        if (findVirtualMeter(slaveID) != VIRTUAL_METER_NONE) {
+            selectVirtualMeter(slaveID);
+        } else if (!setVirtualMeterSlaveID(getSelectedMeter(), slaveID)) {
+            return;
+        }
+        // Turn off all analog outputs; the relays may only open once they are at zero
+        if (!setAllDACsToZero()) {
+            Serial.println("Modbus mode not entered, relays unchanged. Retry the command.");
+            return;
+        }
         currentMode = MODE_MODBUS;
-        currentSlaveID = slaveID;
         mb.slave(currentSlaveID);
         
         // Clear the signal arrays in main.cpp to reset all analog inputs
@@ -59,9 +84,9 @@ void enterModbusMode(uint8_t slaveID) {
             signalConfigured[i] = false; // Mark as not configured
         }
         
-        // Turn off all analog outputs and isolate with relays
-        setAllDACsToZero();
+        // Isolate the (zeroed) outputs with relays
         turnOffAllRelays();
+        setOutputControlWritable(false);
         
         Serial.println("=== MODBUS MODE ACTIVATED ===");
         Serial.printf("Slave ID: %d\n", currentSlaveID);
@@ -91,6 +116,7 @@ void enterModbusMode(uint8_t slaveID) {
 void exitModbusMode() {
     if (currentMode == MODE_MODBUS) {
         currentMode = MODE_ANALOG;
+        setOutputControlWritable(true);
         
         // Don't restore previous values - keep everything at 0
         // User can manually set new values if needed
@@ -111,7 +137,9 @@ bool isModbusModeActive() {
 
 void setSlaveID(uint8_t slaveID) {
     if (slaveID >= 1 && slaveID <= 247) {
-        currentSlaveID = slaveID;
+        if (!setVirtualMeterSlaveID(getSelectedMeter(), slaveID)) {
+            return;
+        }
         mb.slave(currentSlaveID);
         Serial.printf("Slave ID changed to: %d\n", currentSlaveID);
     } else {
@@ -134,110 +162,56 @@ void processMeasurementValues(float flow, uint32_t consumption, uint32_t reverse
 }
 
 
+// Generic register writers for the selected meter, encoded by the meter map codecs (1-0-3-2 word order)
 void processU64(uint16_t regn, uint64_t data) {
-    mb.addHreg(regn, 0x00, 4);   // Add 4 registers for 64-bit data
-    
-    // For UINT64, we need to split into 4 16-bit registers
-    // Following the 1-0-3-2 byte order pattern for each 32-bit half
-    uint32_t low32 = (uint32_t)(data & 0xFFFFFFFF);
-    uint32_t high32 = (uint32_t)((data >> 32) & 0xFFFFFFFF);
-    
-    // Process low 32-bit part with 1-0-3-2 byte order
-    uint8_t byte0 = (low32 >> 0) & 0xFF;
-    uint8_t byte1 = (low32 >> 8) & 0xFF;
-    uint8_t byte2 = (low32 >> 16) & 0xFF;
-    uint8_t byte3 = (low32 >> 24) & 0xFF;
-    
-    uint16_t reg1 = (byte1 << 8) | byte0;  // Byte 1-0
-    uint16_t reg2 = (byte3 << 8) | byte2;  // Byte 3-2
-    
-    // Process high 32-bit part with 1-0-3-2 byte order
-    uint8_t byte4 = (high32 >> 0) & 0xFF;
-    uint8_t byte5 = (high32 >> 8) & 0xFF;
-    uint8_t byte6 = (high32 >> 16) & 0xFF;
-    uint8_t byte7 = (high32 >> 24) & 0xFF;
-    
-    uint16_t reg3 = (byte5 << 8) | byte4;  // Byte 1-0
-    uint16_t reg4 = (byte7 << 8) | byte6;  // Byte 3-2
-    
-    mb.Hreg(regn, reg1);
-    mb.Hreg(regn + 1, reg2);
-    mb.Hreg(regn + 2, reg3);
-    mb.Hreg(regn + 3, reg4);
+    uint16_t words[4];
+    encodeMeterWords<TYPE_U64>(data, WORD_ORDER_1032, words);
+    writeImageRegisters(getSelectedMeter(), regn, words, 4);
 }
 
 void processUint32(uint16_t regn, uint32_t data) {
-    mb.addHreg(regn, 0x00, 2);   // Add 2 registers for 32-bit data
-    
-    // UINT32 byte order: 1-0-3-2
-    // Original: Byte 0, Byte 1, Byte 2, Byte 3
-    // Device:   Byte 1, Byte 0, Byte 3, Byte 2
-    uint8_t byte0 = (data >> 0) & 0xFF;
-    uint8_t byte1 = (data >> 8) & 0xFF;
-    uint8_t byte2 = (data >> 16) & 0xFF;
-    uint8_t byte3 = (data >> 24) & 0xFF;
-    
-    // Reorder to 1-0-3-2
-    uint16_t reg1 = (byte1 << 8) | byte0;  // Byte 1-0
-    uint16_t reg2 = (byte3 << 8) | byte2;  // Byte 3-2
-    
-    mb.Hreg(regn, reg1);
-    mb.Hreg(regn + 1, reg2);
+    uint16_t words[2];
+    encodeMeterWords<TYPE_U32>(data, WORD_ORDER_1032, words);
+    writeImageRegisters(getSelectedMeter(), regn, words, 2);
 }
 
 void processFloat(uint16_t regn, float data) {
     uint32_t asInt = *(uint32_t*)&data;
-    mb.addHreg(regn, 0x00, 2);
-    
-    // FLOAT byte order: 1-0-3-2
-    // Original: Byte 0, Byte 1, Byte 2, Byte 3
-    // Device:   Byte 1, Byte 0, Byte 3, Byte 2
-    uint8_t byte0 = (asInt >> 0) & 0xFF;
-    uint8_t byte1 = (asInt >> 8) & 0xFF;
-    uint8_t byte2 = (asInt >> 16) & 0xFF;
-    uint8_t byte3 = (asInt >> 24) & 0xFF;
-    
-    // Reorder to 1-0-3-2
-    uint16_t reg1 = (byte1 << 8) | byte0;  // Byte 1-0
-    uint16_t reg2 = (byte3 << 8) | byte2;  // Byte 3-2
-    
-    mb.Hreg(regn, reg1);
-    mb.Hreg(regn + 1, reg2);
+    uint16_t words[2];
+    encodeMeterWords<TYPE_FLOAT>(asInt, WORD_ORDER_1032, words);
+    writeImageRegisters(getSelectedMeter(), regn, words, 2);
 }
 
 void processInt16(uint16_t regn, int16_t data) {
-    mb.addHreg(regn, 0x00, 1);   // Only need 1 register for 16-bit data
-    
-    // UINT16/INT16 byte order: 1-0
-    // Original: Byte 0, Byte 1
-    // Device:   Byte 1, Byte 0
-    uint8_t byte0 = (uint16_t)data & 0xFF;
-    uint8_t byte1 = ((uint16_t)data >> 8) & 0xFF;
-    
-    // Reorder to 1-0 (Byte 1 MSB, Byte 0 LSB)
-    uint16_t reg1 = (byte1 << 8) | byte0;
-    
-    mb.Hreg(regn, reg1);
+    uint16_t word = (uint16_t)data;
+    writeImageRegisters(getSelectedMeter(), regn, &word, 1);
 }
 
 /**
  * Set all DAC outputs to zero when Modbus is activated
  */
-void setAllDACsToZero() {
+bool setAllDACsToZero() {
     // Stop all sine wave generation
     stopSineWave(0); // Stop all channels
+    stopWaveform(0);
+    stopProfile(0);
     
-    // Set all voltage DACs to 0
-    gp8413_1.setVoltage(0.0, 0); // SIG1 voltage channel
-    gp8413_1.setVoltage(0.0, 1); // SIG2 voltage channel
-    gp8413_2.setVoltage(0.0, 0); // SIG3 voltage channel
-    
-    // Set all current DACs to 0
-    gp8313_1.setDACOutElectricCurrent(0); // SIG1 current channel
-    gp8313_2.setDACOutElectricCurrent(0); // SIG2 current channel
-    gp8313_3.setDACOutElectricCurrent(0); // SIG3 current channel
+    // Set all voltage and current DACs to 0 in one frame (latched codes are dropped)
+    DacFrame frame;
+    dacFrameClear(&frame);
+    for (int i = 0; i < 3; i++) {
+        cancelScheduledChannel(i);
+        dacFrameSetVoltageCode(&frame, i, 0);
+        dacFrameSetCurrentCode(&frame, i, 0);
+    }
+    postDacFrame(&frame);
+    if (!flushDacOutputQueue()) { // Outputs must be at zero before relays are opened
+        Serial.println("DAC queue flush timed out: outputs not confirmed at 0V/0mA");
+        return false;
+    }
     
     Serial.println("All DAC outputs set to 0V/0mA");
+    return true;
 }
 
 /**
@@ -309,11 +283,11 @@ void restoreAnalogValues() {
         if (previousSignalModes[i] == 'v' || previousSignalModes[i] == 'c') {
             setRelayMode(i + 1, previousSignalModes[i]);
             
-            // Restore DAC output
+            // Restore DAC output (through the output stage, like any manual setpoint)
             if (previousSignalModes[i] == 'v') {
-                signalMap[i].voltageDAC->setVoltage(previousVoltageValues[i], signalMap[i].voltageChannel);
+                postSetpointCode(i, 'v', voltageToDacCode(previousVoltageValues[i]));
             } else if (previousSignalModes[i] == 'c') {
-                signalMap[i].currentDAC->setDACOutElectricCurrent(static_cast<uint16_t>(previousCurrentValues[i] * 1310.68));
+                postSetpointCode(i, 'c', currentToDacCode(previousCurrentValues[i]));
             }
             
             const char* modeStr = (previousSignalModes[i] == 'v') ? "voltage" : "current";
@@ -334,26 +308,26 @@ void restoreAnalogValues() {
 
 // Flow measurement (Register 6, FLOAT, Resolution 0.1)
 void setFlowValue(float flow) {
-    processFloat(6, flow);
+    setMeterValue<METER_FLOW>(getSelectedMeter(), flow);
     Serial.printf("Flow set to %.1f (Register 6)\n", flow);
 }
 
 // Consumption measurement (Register 8, UNIT32, Resolution 1)
 void setConsumptionValue(uint32_t consumption) {
-    processUint32(8, consumption);
+    setMeterValue<METER_CONSUMPTION>(getSelectedMeter(), consumption);
     Serial.printf("Consumption set to %u (Register 8)\n", consumption);
 }
 
 // Reverse consumption measurement (Register 14, UNIT32, Resolution 1)
 void setReverseConsumptionValue(uint32_t reverseConsumption) {
-    processUint32(14, reverseConsumption);
+    setMeterValue<METER_REVERSE_CONSUMPTION>(getSelectedMeter(), reverseConsumption);
     Serial.printf("Reverse consumption set to %u (Register 14)\n", reverseConsumption);
 }
 
 // Flow direction indication (Register 42, UNIT32, Resolution 1)
 // Value 0 = same direction, Value 1 = reverse direction
 void setFlowDirectionValue(uint32_t direction) {
-    processUint32(42, direction);
+    setMeterValue<METER_FLOW_DIRECTION>(getSelectedMeter(), direction);
     const char* dirStr = (direction == 0) ? "same direction" : "reverse direction";
     Serial.printf("Flow direction set to %u (%s) (Register 42)\n", direction, dirStr);
 }
@@ -0,0 +1,394 @@
+#include "modbus_register_image.h"
+#include "modbus_handler.h"
+
+// Everything one virtual meter's image needs, fixed size
+struct ModbusImage {
+    uint16_t registers[MODBUS_IMAGE_SIZE];
+    uint32_t readOnly[(MODBUS_IMAGE_SIZE + 31) / 32];  // One bit per register
+    ModbusImageStats stats;
+};
+
+static ModbusImage images[MODBUS_MAX_METERS];
+static portMUX_TYPE imageMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Watched range for master writes
+static ImageWriteHook writeHook = nullptr;
+static ImageWriteLock writeLock = nullptr;
+static ImageWriteUnlock writeUnlock = nullptr;
+static uint8_t hookMeter = 0;
+static uint16_t hookFirst = 0;
+static uint16_t hookCount = 0;
+
+/**
+ * Fill an exception response
+ */
+static uint8_t exceptionResponse(ModbusImage& image, uint8_t functionCode, uint8_t code, uint8_t* response) {
+    response[0] = functionCode | 0x80;
+    response[1] = code;
+    image.stats.exceptions++;
+    return 2;
+}
+
+/**
+ * Check whether any register in a range is read-only
+ */
+static bool rangeReadOnly(const ModbusImage& image, uint16_t start, uint16_t count) {
+    for (uint16_t r = start; r < start + count; r++) {
+        if (image.readOnly[r >> 5] & (1UL << (r & 31))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Store register data from a write request, then let the write hook accept or reject it
+ * @param data Big-endian register values from the request
+ * @return 0 if stored, otherwise the exception code (whole written range restored)
+ */
+static uint8_t storeImageWrite(uint8_t meter, uint16_t start, uint16_t count, const uint8_t* data) {
+    ModbusImage& image = images[meter];
+    uint16_t first = start;
+    uint16_t last = start + count;
+    bool watched = (writeHook != nullptr && meter == hookMeter &&
+                    first < hookFirst + hookCount && last > hookFirst);
+    if (watched) {
+        first = (first > hookFirst) ? first : hookFirst;
+        last = (last < hookFirst + hookCount) ? last : hookFirst + hookCount;
+    }
+
+    ImageWriteUnlock unlock = watched ? writeUnlock : nullptr;
+    if (watched && writeLock != nullptr && !writeLock()) {
+        return Modbus::EX_SLAVE_DEVICE_BUSY;
+    }
+
+    // A rejected write is undone in full, also where it extends past the watched range
+    uint16_t previous[MODBUS_MAX_WRITE_REGS];
+    portENTER_CRITICAL(&imageMux);
+    if (watched) {
+        memcpy(previous, &image.registers[start], count * sizeof(uint16_t));
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        image.registers[start + i] = (data[0] << 8) | data[1];
+        data += 2;
+    }
+    portEXIT_CRITICAL(&imageMux);
+
+    if (!watched) {
+        return 0;
+    }
+    uint8_t exception = writeHook(meter, first, last - first);
+    if (exception != 0) {
+        portENTER_CRITICAL(&imageMux);
+        memcpy(&image.registers[start], previous, count * sizeof(uint16_t));
+        portEXIT_CRITICAL(&imageMux);
+    }
+    if (unlock != nullptr) {
+        unlock();
+    }
+    return exception;
+}
+
+/**
+ * Build the response PDU for a request PDU served from the image
+ */
+uint8_t buildImageResponse(uint8_t meter, const uint8_t* request, uint8_t length, uint8_t* response) {
+    if (meter >= MODBUS_MAX_METERS || length < 1) {
+        return 0;
+    }
+    ModbusImage& image = images[meter];
+    uint8_t functionCode = request[0];
+    if (functionCode != 0x03 && functionCode != 0x06 && functionCode != 0x10 && functionCode != 0x17) {
+        return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_FUNCTION, response);
+    }
+    if (length < 5) {
+        return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+    }
+    uint16_t start = (request[1] << 8) | request[2];
+    uint16_t value = (request[3] << 8) | request[4];
+    if (start >= MODBUS_IMAGE_SIZE) {
+        return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_ADDRESS, response);
+    }
+
+    switch (functionCode) {
+        case 0x03: {
+            // Read holding registers: value = register count
+            if (length != 5 || value < 1 || value > MODBUS_MAX_READ_REGS) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+            }
+            if (start + value > MODBUS_IMAGE_SIZE) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_ADDRESS, response);
+            }
+            response[0] = functionCode;
+            response[1] = value * 2;
+            uint8_t* out = &response[2];
+            portENTER_CRITICAL(&imageMux);
+            for (uint16_t i = 0; i < value; i++) {
+                uint16_t word = image.registers[start + i];
+                *out++ = word >> 8;
+                *out++ = word & 0xFF;
+            }
+            portEXIT_CRITICAL(&imageMux);
+            image.stats.reads++;
+            return 2 + value * 2;
+        }
+        case 0x06: {
+            // Write single register: echo request
+            if (length != 5) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+            }
+            if (rangeReadOnly(image, start, 1)) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_ADDRESS, response);
+            }
+            uint8_t exception = storeImageWrite(meter, start, 1, &request[3]);
+            if (exception != 0) {
+                return exceptionResponse(image, functionCode, exception, response);
+            }
+            memmove(response, request, 5);
+            image.stats.writes++;
+            return 5;
+        }
+        case 0x10: {
+            // Write multiple registers: value = register count, then byte count and data
+            uint8_t byteCount = (length >= 6) ? request[5] : 0;
+            if (length < 6 || value < 1 || value > MODBUS_MAX_WRITE_REGS || byteCount != value * 2 || length != 6 + byteCount) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+            }
+            if (start + value > MODBUS_IMAGE_SIZE || rangeReadOnly(image, start, value)) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_ADDRESS, response);
+            }
+            uint8_t exception = storeImageWrite(meter, start, value, &request[6]);
+            if (exception != 0) {
+                return exceptionResponse(image, functionCode, exception, response);
+            }
+            memmove(response, request, 5);
+            image.stats.writes++;
+            return 5;
+        }
+        case 0x17: {
+            // Read/write multiple registers: start/value = read range, then write range,
+            // byte count and data. The write is done first, the read sees its result.
+            if (length < 10) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+            }
+            uint16_t writeStart = (request[5] << 8) | request[6];
+            uint16_t writeCount = (request[7] << 8) | request[8];
+            uint8_t byteCount = request[9];
+            if (value < 1 || value > MODBUS_MAX_READ_REGS ||
+                writeCount < 1 || writeCount > MODBUS_MAX_RW_WRITE_REGS ||
+                byteCount != writeCount * 2 || length != 10 + byteCount) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_VALUE, response);
+            }
+            if (start + value > MODBUS_IMAGE_SIZE || writeStart + writeCount > MODBUS_IMAGE_SIZE ||
+                rangeReadOnly(image, writeStart, writeCount)) {
+                return exceptionResponse(image, functionCode, Modbus::EX_ILLEGAL_ADDRESS, response);
+            }
+            uint8_t exception = storeImageWrite(meter, writeStart, writeCount, &request[10]);
+            if (exception != 0) {
+                return exceptionResponse(image, functionCode, exception, response);
+            }
+            // Request data has been consumed, the read response may now overwrite it
+            response[0] = functionCode;
+            response[1] = value * 2;
+            uint8_t* out = &response[2];
+            portENTER_CRITICAL(&imageMux);
+            for (uint16_t i = 0; i < value; i++) {
+                uint16_t word = image.registers[start + i];
+                *out++ = word >> 8;
+                *out++ = word & 0xFF;
+            }
+            portEXIT_CRITICAL(&imageMux);
+            image.stats.writes++;
+            image.stats.reads++;
+            return 2 + value * 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Clear all images
+ */
+void initModbusRegisterImage() {
+    memset(images, 0, sizeof(images));
+    Serial.printf("Modbus register image: holding registers 0-%d, %d meters x %u bytes\n",
+                  MODBUS_IMAGE_SIZE - 1, MODBUS_MAX_METERS, (unsigned)sizeof(ModbusImage));
+}
+
+/**
+ * Clear one meter's image (registers, access flags and counters)
+ */
+void clearModbusImage(uint8_t meter) {
+    if (meter >= MODBUS_MAX_METERS) {
+        return;
+    }
+    portENTER_CRITICAL(&imageMux);
+    memset(&images[meter], 0, sizeof(ModbusImage));
+    portEXIT_CRITICAL(&imageMux);
+}
+
+/**
+ * Write consecutive registers
+ */
+bool writeImageRegisters(uint8_t meter, uint16_t address, const uint16_t* words, uint8_t count) {
+    if (meter >= MODBUS_MAX_METERS || address + count > MODBUS_IMAGE_SIZE) {
+        return false;
+    }
+    portENTER_CRITICAL(&imageMux);
+    memcpy(&images[meter].registers[address], words, count * sizeof(uint16_t));
+    portEXIT_CRITICAL(&imageMux);
+    return true;
+}
+
+/**
+ * Write several register ranges as one update
+ */
+bool writeImageBatch(uint8_t meter, const ImageWrite* writes, uint8_t count) {
+    if (meter >= MODBUS_MAX_METERS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (writes[i].count > 4 || writes[i].address + writes[i].count > MODBUS_IMAGE_SIZE) {
+            return false;
+        }
+    }
+    uint16_t* registers = images[meter].registers;
+    portENTER_CRITICAL(&imageMux);
+    for (uint8_t i = 0; i < count; i++) {
+        memcpy(&registers[writes[i].address], writes[i].words, writes[i].count * sizeof(uint16_t));
+    }
+    portEXIT_CRITICAL(&imageMux);
+    return true;
+}
+
+/**
+ * Set whether the Modbus master may write a register range
+ */
+bool setImageRegisterAccess(uint8_t meter, uint16_t address, uint8_t count, bool writable) {
+    if (meter >= MODBUS_MAX_METERS || address + count > MODBUS_IMAGE_SIZE) {
+        return false;
+    }
+    uint32_t* readOnly = images[meter].readOnly;
+    portENTER_CRITICAL(&imageMux);
+    for (uint16_t r = address; r < address + count; r++) {
+        if (writable) {
+            readOnly[r >> 5] &= ~(1UL << (r & 31));
+        } else {
+            readOnly[r >> 5] |= 1UL << (r & 31);
+        }
+    }
+    portEXIT_CRITICAL(&imageMux);
+    return true;
+}
+
+/**
+ * Watch a register range of one meter for master writes
+ */
+bool setImageWriteHook(uint8_t meter, uint16_t address, uint16_t count, ImageWriteHook hook,
+                       ImageWriteLock lock, ImageWriteUnlock unlock) {
+    if (meter >= MODBUS_MAX_METERS || address + count > MODBUS_IMAGE_SIZE) {
+        return false;
+    }
+    portENTER_CRITICAL(&imageMux);
+    writeHook = hook;
+    writeLock = lock;
+    writeUnlock = unlock;
+    hookMeter = meter;
+    hookFirst = address;
+    hookCount = count;
+    portEXIT_CRITICAL(&imageMux);
+    return true;
+}
+
+/**
+ * Read consecutive registers
+ */
+bool readImageRegisters(uint8_t meter, uint16_t address, uint16_t* words, uint8_t count) {
+    if (meter >= MODBUS_MAX_METERS || address + count > MODBUS_IMAGE_SIZE) {
+        return false;
+    }
+    portENTER_CRITICAL(&imageMux);
+    memcpy(words, &images[meter].registers[address], count * sizeof(uint16_t));
+    portEXIT_CRITICAL(&imageMux);
+    return true;
+}
+
+/**
+ * Get request counters
+ */
+ModbusImageStats getModbusImageStats(uint8_t meter) {
+    ModbusImageStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (meter < MODBUS_MAX_METERS) {
+        stats = images[meter].stats;
+    }
+    return stats;
+}
+
+/**
+ * Get memory used by one meter's image
+ */
+size_t getModbusImageBytes() {
+    return sizeof(ModbusImage);
+}
+
+/**
+ * Benchmark register image against the library's register search path (on meter 0)
+ * Update = one FLOAT written the old way (addHreg + 2x Hreg) vs writeImageRegisters().
+ * Read = 40 registers (the meter block 6-45) looked up word by word as the library's
+ * FC03 handler does, vs building the complete FC03 response from the image.
+ */
+void runModbusImageBenchmark() {
+    const int ITERATIONS = 1000;
+    const uint16_t FIRST = 6;
+    const uint16_t COUNT = 40;
+    volatile uint32_t sink = 0;
+
+    // Library path: same register block as the meter map
+    mb.addHreg(FIRST, 0, COUNT);
+    unsigned long t0 = micros();
+    for (int i = 0; i < ITERATIONS; i++) {
+        mb.addHreg(FIRST, 0x00, 2);
+        mb.Hreg(FIRST, i);
+        mb.Hreg(FIRST + 1, i);
+    }
+    unsigned long libraryUpdate = micros() - t0;
+    t0 = micros();
+    for (int i = 0; i < ITERATIONS; i++) {
+        for (uint16_t r = FIRST; r < FIRST + COUNT; r++) {
+            sink += mb.Hreg(r);
+        }
+    }
+    unsigned long libraryRead = micros() - t0;
+    mb.removeHreg(FIRST, COUNT);
+
+    // Image path (restores the registers it touches)
+    uint16_t saved[2];
+    readImageRegisters(0, FIRST, saved, 2);
+    t0 = micros();
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint16_t words[2] = {(uint16_t)i, (uint16_t)i};
+        writeImageRegisters(0, FIRST, words, 2);
+    }
+    unsigned long imageUpdate = micros() - t0;
+    writeImageRegisters(0, FIRST, saved, 2);
+
+    ModbusImageStats savedStats = images[0].stats;
+    uint8_t request[5] = {0x03, 0x00, FIRST, 0x00, COUNT};
+    static uint8_t response[2 + 2 * MODBUS_MAX_READ_REGS];
+    t0 = micros();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink += buildImageResponse(0, request, sizeof(request), response);
+    }
+    unsigned long imageRead = micros() - t0;
+    images[0].stats = savedStats;
+    (void)sink;
+
+    Serial.println("=== MODBUS REGISTER BENCHMARK ===");
+    Serial.printf("Iterations: %d, read block: %d registers\n", ITERATIONS, COUNT);
+    Serial.printf("FLOAT update  library: %.2f us   image: %.2f us\n",
+                  (float)libraryUpdate / ITERATIONS, (float)imageUpdate / ITERATIONS);
+    Serial.printf("FC03 read     library: %.2f us   image: %.2f us (complete response)\n",
+                  (float)libraryRead / ITERATIONS, (float)imageRead / ITERATIONS);
+    Serial.println("=================================");
+}
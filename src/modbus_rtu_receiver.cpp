@@ -0,0 +1,348 @@
+#include "modbus_rtu_receiver.h"
+#include "modbus_handler.h"
+#include "modbus_register_image.h"
+#include "virtual_meters.h"
+
+static TaskHandle_t receiverTaskHandle = nullptr;
+static volatile uint32_t frameEndTimestamp = 0;
+static ModbusReceiverStats receiverStats;
+static portMUX_TYPE receiverMux = portMUX_INITIALIZER_UNLOCKED;
+
+// One static frame buffer: requests are received into it and the response is built in place
+static uint8_t rtuFrame[MODBUS_RTU_MAX_FRAME];
+static uint16_t crcTable[256];
+
+// Heap state when the receiver started, for the high-water report
+static uint32_t heapFreeAtStart = 0;
+static uint32_t heapMinAtStart = 0;
+
+// Heap probe for measureModbusHeap(): lowest free heap seen while a frame is in flight
+static volatile bool heapProbeActive = false;
+static volatile uint32_t heapProbeFrames = 0;
+static volatile uint32_t heapProbeMinFree = 0;
+
+/**
+ * Build the CRC16 lookup table (polynomial 0xA001)
+ */
+static void buildCrcTable() {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        crcTable[i] = crc;
+    }
+}
+
+/**
+ * Continue a CRC16 over more bytes
+ */
+static inline uint16_t crcUpdate(uint16_t crc, const uint8_t* data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        crc = (crc >> 8) ^ crcTable[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+/**
+ * Compute Modbus RTU CRC16 (polynomial 0xA001, initial 0xFFFF)
+ */
+uint16_t modbusCrc16(const uint8_t* data, uint16_t length) {
+    return crcUpdate(0xFFFF, data, length);
+}
+
+/**
+ * Sample the free heap while a frame is being processed
+ */
+static void sampleHeapProbe() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < heapProbeMinFree) {
+        heapProbeMinFree = freeHeap;
+    }
+    heapProbeFrames++;
+}
+
+/**
+ * UART event callback (RX timeout = end of frame): only wakes the receive task
+ */
+static void onFrameEnd() {
+    frameEndTimestamp = micros();
+    xTaskNotifyGive(receiverTaskHandle);
+}
+
+/**
+ * Validate one frame and send the response
+ * @param length Frame length including CRC
+ * @param crc CRC over the whole frame including its CRC bytes (0 if intact)
+ * @param frameEnd End-of-frame event timestamp
+ */
+static void handleFrame(uint16_t length, uint16_t crc, uint32_t frameEnd) {
+    if (length < 4 || crc != 0) {
+        portENTER_CRITICAL(&receiverMux);
+        receiverStats.crcErrors++;
+        portEXIT_CRITICAL(&receiverMux);
+        return;
+    }
+
+    uint8_t address = rtuFrame[0];
+    if (address == 0) {
+        // Broadcast writes (FC06/FC16) go to every meter without a reply; their response
+        // is a 5-byte echo or 2-byte exception, so the small scratch keeps the request
+        // intact for the next meter. Reads (FC03/FC23) and anything else are dropped.
+        if (rtuFrame[1] == 0x06 || rtuFrame[1] == 0x10) {
+            uint8_t scratch[8];
+            for (uint8_t meter = 0; meter < MODBUS_MAX_METERS; meter++) {
+                if (isVirtualMeterActive(meter)) {
+                    buildImageResponse(meter, &rtuFrame[1], length - 3, scratch);
+                }
+            }
+        }
+        portENTER_CRITICAL(&receiverMux);
+        receiverStats.broadcasts++;
+        portEXIT_CRITICAL(&receiverMux);
+        return;
+    }
+
+    uint8_t meter = findVirtualMeter(address); // One table lookup, any number of meters
+    if (meter == VIRTUAL_METER_NONE) {
+        portENTER_CRITICAL(&receiverMux);
+        receiverStats.otherAddress++;
+        portEXIT_CRITICAL(&receiverMux);
+        return;
+    }
+
+    // Response PDU overwrites the request PDU, address byte stays
+    uint8_t pduLength = buildImageResponse(meter, &rtuFrame[1], length - 3, &rtuFrame[1]);
+    if (pduLength == 0) {
+        return;
+    }
+
+    uint16_t responseCrc = modbusCrc16(rtuFrame, 1 + pduLength);
+    rtuFrame[1 + pduLength] = responseCrc & 0xFF;
+    rtuFrame[2 + pduLength] = responseCrc >> 8;
+    Serial1.write(rtuFrame, 3 + pduLength);
+
+    uint32_t latency = micros() - frameEnd;
+    portENTER_CRITICAL(&receiverMux);
+    receiverStats.responses++;
+    receiverStats.lastLatencyUs = latency;
+    if (latency > receiverStats.maxLatencyUs) {
+        receiverStats.maxLatencyUs = latency;
+    }
+    receiverStats.totalLatencyUs += latency;
+    portEXIT_CRITICAL(&receiverMux);
+}
+
+/**
+ * Receive task: drains the UART after each end-of-frame event
+ * CRC is updated chunk by chunk while copying out of the UART driver, so the
+ * frame is never scanned twice and nothing is allocated.
+ */
+static void receiverTask(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t frameEnd = frameEndTimestamp;
+
+        uint16_t length = 0;
+        uint16_t crc = 0xFFFF;
+        bool overrun = false;
+        int available;
+        while ((available = Serial1.available()) > 0) {
+            if (length + available > MODBUS_RTU_MAX_FRAME) {
+                // Not a valid RTU frame, drop everything received so far
+                while (Serial1.available() > 0) {
+                    Serial1.read();
+                }
+                overrun = true;
+                break;
+            }
+            size_t count = Serial1.read(&rtuFrame[length], available);
+            crc = crcUpdate(crc, &rtuFrame[length], count);
+            length += count;
+        }
+
+        if (overrun) {
+            portENTER_CRITICAL(&receiverMux);
+            receiverStats.overruns++;
+            portEXIT_CRITICAL(&receiverMux);
+            continue;
+        }
+        if (length == 0) {
+            continue;
+        }
+        portENTER_CRITICAL(&receiverMux);
+        receiverStats.frames++;
+        portEXIT_CRITICAL(&receiverMux);
+        if (heapProbeActive) {
+            sampleHeapProbe();
+        }
+        handleFrame(length, crc, frameEnd);
+    }
+}
+
+/**
+ * Attach the receiver to Serial1 and start the receive task
+ */
+void initModbusReceiver() {
+    memset(&receiverStats, 0, sizeof(receiverStats));
+    buildCrcTable();
+    heapFreeAtStart = ESP.getFreeHeap();
+    heapMinAtStart = ESP.getMinFreeHeap();
+
+    xTaskCreatePinnedToCore(receiverTask, "modbus_rtu", MODBUS_RTU_TASK_STACK, nullptr,
+                            MODBUS_RTU_TASK_PRIORITY, &receiverTaskHandle, MODBUS_RTU_TASK_CORE);
+
+    Serial1.setRxTimeout(MODBUS_RX_TIMEOUT_SYMBOLS);
+    Serial1.onReceive(onFrameEnd, true); // Only on RX timeout, not on FIFO full
+
+    Serial.printf("Modbus RTU receiver: end of frame after %d idle characters\n", MODBUS_RX_TIMEOUT_SYMBOLS);
+    Serial.printf("Heap at receiver start: %lu bytes free, low-water %lu bytes\n",
+                  (unsigned long)heapFreeAtStart, (unsigned long)heapMinAtStart);
+}
+
+/**
+ * Detach the receiver from Serial1
+ */
+void detachModbusReceiver() {
+    Serial1.onReceive(NULL);
+}
+
+/**
+ * Reattach the receiver to Serial1
+ */
+void attachModbusReceiver() {
+    // Leftovers of the other reader would be taken for the start of a frame
+    while (Serial1.available()) {
+        Serial1.read();
+    }
+    Serial1.onReceive(onFrameEnd, true);
+}
+
+/**
+ * onRaw hook for the library pass: runs after ModbusRTU::task() allocated the request
+ */
+static Modbus::ResultCode probeLibraryFrame(uint8_t* data, uint8_t length, void* custom) {
+    sampleHeapProbe();
+    return Modbus::EX_PASSTHROUGH; // Let the library process the frame as usual
+}
+
+/**
+ * Run one pipeline until it has seen the given number of frames (or the timeout)
+ */
+static ModbusHeapSample runHeapProbe(bool library, uint32_t frames, uint32_t timeoutMs) {
+    ModbusHeapSample sample;
+    sample.freeBefore = ESP.getFreeHeap();
+    sample.lowWaterBefore = ESP.getMinFreeHeap();
+    heapProbeMinFree = sample.freeBefore;
+    heapProbeFrames = 0;
+    heapProbeActive = !library;
+
+    unsigned long start = millis();
+    while (heapProbeFrames < frames && millis() - start < timeoutMs) {
+        if (library) {
+            mb.task();
+        }
+        vTaskDelay(library ? 1 : 10);
+    }
+    heapProbeActive = false;
+
+    sample.frames = heapProbeFrames;
+    sample.minFree = heapProbeMinFree;
+    sample.freeAfter = ESP.getFreeHeap();
+    sample.lowWaterAfter = ESP.getMinFreeHeap();
+    sample.largestBlock = ESP.getMaxAllocHeap();
+    return sample;
+}
+
+/**
+ * Print one pipeline's heap measurement
+ */
+static void printHeapSample(const char* name, const ModbusHeapSample& sample) {
+    Serial.printf("%-18s %5lu frames, free %lu -> %lu bytes, lowest in frame %lu, "
+                  "low-water %lu -> %lu, largest block %lu\n",
+                  name, (unsigned long)sample.frames,
+                  (unsigned long)sample.freeBefore, (unsigned long)sample.freeAfter,
+                  (unsigned long)sample.minFree,
+                  (unsigned long)sample.lowWaterBefore, (unsigned long)sample.lowWaterAfter,
+                  (unsigned long)sample.largestBlock);
+}
+
+/**
+ * Measure heap use of ModbusRTU::task() and of this receiver over the same traffic
+ */
+void measureModbusHeap(uint32_t frames, uint32_t timeoutMs) {
+    Serial.printf("Measuring heap over %lu frames per pipeline (keep the master polling)...\n",
+                  (unsigned long)frames);
+
+    // Library pass: detach the receiver so ModbusRTU::task() reads Serial1 itself
+    detachModbusReceiver();
+    mb.onRaw(probeLibraryFrame);
+    ModbusHeapSample library = runHeapProbe(true, frames, timeoutMs);
+    mb.onRaw();
+    attachModbusReceiver();
+
+    ModbusHeapSample receiver = runHeapProbe(false, frames, timeoutMs);
+
+    Serial.println("=== MODBUS HEAP ===");
+    printHeapSample("ModbusRTU::task()", library);
+    printHeapSample("RTU receiver", receiver);
+    if (library.frames < frames || receiver.frames < frames) {
+        Serial.println("Timed out before all frames arrived: compare the counts above");
+    }
+    Serial.println("(The library answers from its own empty register set, so its replies are");
+    Serial.println(" exceptions; its per-frame allocation is the same as for served requests.)");
+    Serial.println("===================");
+}
+
+/**
+ * Get receiver statistics
+ */
+ModbusReceiverStats getModbusReceiverStats() {
+    portENTER_CRITICAL(&receiverMux);
+    ModbusReceiverStats copy = receiverStats;
+    portEXIT_CRITICAL(&receiverMux);
+    return copy;
+}
+
+/**
+ * Clear receiver statistics
+ */
+void clearModbusReceiverStats() {
+    portENTER_CRITICAL(&receiverMux);
+    memset(&receiverStats, 0, sizeof(receiverStats));
+    portEXIT_CRITICAL(&receiverMux);
+}
+
+/**
+ * Print receiver, heap and register image statistics
+ */
+void printModbusReceiverStats() {
+    ModbusReceiverStats stats = getModbusReceiverStats();
+    ModbusImageStats image;
+    memset(&image, 0, sizeof(image));
+    for (uint8_t meter = 0; meter < MODBUS_MAX_METERS; meter++) {
+        ModbusImageStats stats = getModbusImageStats(meter);
+        image.reads += stats.reads;
+        image.writes += stats.writes;
+        image.exceptions += stats.exceptions;
+    }
+    Serial.println("=== MODBUS RTU RECEIVER ===");
+    Serial.printf("Frames: %lu, responses: %lu, broadcasts: %lu, other slaves: %lu\n",
+                  (unsigned long)stats.frames, (unsigned long)stats.responses,
+                  (unsigned long)stats.broadcasts, (unsigned long)stats.otherAddress);
+    Serial.printf("Dropped: %lu CRC/short, %lu overrun\n",
+                  (unsigned long)stats.crcErrors, (unsigned long)stats.overruns);
+    if (stats.responses > 0) {
+        Serial.printf("Response latency (end of frame -> reply queued): last %lu us, avg %lu us, max %lu us\n",
+                      (unsigned long)stats.lastLatencyUs,
+                      (unsigned long)(stats.totalLatencyUs / stats.responses),
+                      (unsigned long)stats.maxLatencyUs);
+    }
+    Serial.printf("Heap free: %lu bytes (%lu at start), low-water: %lu bytes (%lu at start), largest block: %lu bytes\n",
+                  (unsigned long)ESP.getFreeHeap(), (unsigned long)heapFreeAtStart,
+                  (unsigned long)ESP.getMinFreeHeap(), (unsigned long)heapMinAtStart,
+                  (unsigned long)ESP.getMaxAllocHeap());
+    Serial.printf("Register images (all meters): %lu reads, %lu writes, %lu exceptions\n",
+                  (unsigned long)image.reads, (unsigned long)image.writes, (unsigned long)image.exceptions);
+    Serial.println("===========================");
+}
@@ -0,0 +1,334 @@
+#include "output_control.h"
+#include "modbus_handler.h"
+#include "modbus_register_image.h"
+#include "meter_register_map.h"
+#include "dac_controller.h"
+#include "dac_output_queue.h"
+#include "output_stage.h"
+#include "relay_controller.h"
+#include "sine_wave_generator.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "sample_output.h"
+
+extern char signalModes[3];
+extern float signalValues[3];
+extern bool signalConfigured[3];
+
+static SemaphoreHandle_t outputMutex = nullptr;
+
+static_assert(OUTPUT_CONTROL_BASE + OUTPUT_CONTROL_REGS <= MODBUS_IMAGE_SIZE,
+              "Output control block exceeds the register image");
+static_assert(meterRegisterMap[METER_FLOW_DIRECTION].address + 2 <= OUTPUT_CONTROL_BASE,
+              "Output control block overlaps the meter register map");
+
+/**
+ * Decode a FLOAT stored low word first (1-0-3-2)
+ */
+static float decodeFloat1032(const uint16_t* words) {
+    uint32_t raw = (uint32_t)words[0] | ((uint32_t)words[1] << 16);
+    float value;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+/**
+ * Encode a FLOAT low word first (1-0-3-2)
+ */
+static void encodeFloat1032(float value, uint16_t* words) {
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    words[0] = raw & 0xFFFF;
+    words[1] = raw >> 16;
+}
+
+/**
+ * Read and validate one signal's block
+ * @param channel Signal channel (0-2)
+ * @param command Decoded block
+ * @return true if every field is in range
+ */
+static bool readOutputCommand(uint8_t channel, OutputCommand* command) {
+    uint16_t words[OUTPUT_CONTROL_STRIDE];
+    readImageRegisters(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE + channel * OUTPUT_CONTROL_STRIDE,
+                       words, OUTPUT_CONTROL_STRIDE);
+
+    uint16_t mode = words[OUTPUT_REG_MODE];
+    uint16_t waveform = words[OUTPUT_REG_WAVEFORM];
+    if (mode > OUTPUT_MODE_CURRENT || waveform > OUTPUT_WAVEFORM_SINE) {
+        return false;
+    }
+    command->mode = (mode == OUTPUT_MODE_CURRENT) ? 'c' : 'v';
+    command->sine = (waveform == OUTPUT_WAVEFORM_SINE);
+    command->setpoint = decodeFloat1032(&words[OUTPUT_REG_SETPOINT]);
+    command->amplitude = decodeFloat1032(&words[OUTPUT_REG_AMPLITUDE]);
+    command->period = decodeFloat1032(&words[OUTPUT_REG_PERIOD]);
+    return isOutputCommandValid(*command);
+}
+
+/**
+ * Check a target state against the output ranges
+ */
+bool isOutputCommandValid(const OutputCommand& command) {
+    if (command.mode != 'v' && command.mode != 'c') {
+        return false;
+    }
+    // Comparisons are written so that NaN fails them
+    float fullScale = (command.mode == 'v') ? 10.0f : 25.0f;
+    if (!(command.setpoint >= 0 && command.setpoint <= fullScale)) {
+        return false;
+    }
+    if (command.sine) {
+        if (!(command.amplitude >= 0 && command.amplitude <= fullScale) ||
+            !(command.period >= 1.0f && command.period <= 60.0f)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check whether a signal's relay currently connects the DAC of a mode
+ */
+static bool relayConnected(uint8_t channel, char mode) {
+    return getRelayState(channel * 2 + ((mode == 'c') ? 1 : 2));
+}
+
+/**
+ * Apply target states, DC setpoints either posted now or scheduled for a sample tick
+ */
+static bool applyOutputs(const OutputCommand* commands, uint8_t channelMask, bool latched, uint32_t tick) {
+    // Break: take the signals over from other sources and zero the outgoing DAC of
+    // every signal that changes mode, all in one frame, before any relay moves
+    DacFrame frame;
+    dacFrameClear(&frame);
+    bool switching = false;
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        if (!(channelMask & (1 << ch))) {
+            continue;
+        }
+        releaseSineChannel(ch);
+        releaseWaveformChannel(ch);
+        releaseProfileChannel(ch);
+        if (signalModes[ch] != commands[ch].mode) {
+            if (signalModes[ch] == 'v') {
+                dacFrameSetVoltageCode(&frame, ch, 0);
+            } else {
+                dacFrameSetCurrentCode(&frame, ch, 0);
+            }
+            switching = true;
+        }
+    }
+    if (switching) {
+        postDacFrame(&frame);
+        if (!flushDacOutputQueue()) {
+            // Outgoing DAC may still be live: leave every relay where it is
+            Serial.println("Output update aborted: DAC queue flush timed out, relays unchanged");
+            return false;
+        }
+    }
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        if (!(channelMask & (1 << ch))) {
+            continue;
+        }
+        if (signalModes[ch] != commands[ch].mode || !relayConnected(ch, commands[ch].mode)) {
+            signalModes[ch] = commands[ch].mode;
+            setRelayMode(ch + 1, commands[ch].mode);
+        }
+    }
+
+    // Make: DC setpoints in one frame, sine signals armed and started on one tick
+    dacFrameClear(&frame);
+    bool armed = false;
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        if (!(channelMask & (1 << ch))) {
+            continue;
+        }
+        const OutputCommand& command = commands[ch];
+        if (command.sine) {
+            armSineWave(command.amplitude, command.period, command.setpoint, ch + 1, command.mode, 0.0f);
+            armed = true;
+        } else {
+            uint16_t code = (command.mode == 'v') ? voltageToDacCode(command.setpoint)
+                                                  : currentToDacCode(command.setpoint);
+            if (isOutputStageEnabled(ch)) {
+                // Shaped channels ramp from the stage, starting on the latch tick if latched
+                if (latched) {
+                    postSetpointCodeAtTick(ch, command.mode, code, tick);
+                } else {
+                    postSetpointCode(ch, command.mode, code);
+                }
+            } else if (command.mode == 'v') {
+                dacFrameSetVoltageCode(&frame, ch, code);
+            } else {
+                dacFrameSetCurrentCode(&frame, ch, code);
+            }
+        }
+        signalValues[ch] = command.setpoint;
+        signalConfigured[ch] = true;
+    }
+    if (frame.voltagePending || frame.currentPending) {
+        if (latched) {
+            scheduleSampleFrame(&frame, tick);
+        } else {
+            postDacFrame(&frame);
+        }
+    }
+    if (armed) {
+        triggerSineWaves();
+    }
+    return true;
+}
+
+/**
+ * Apply target states to several signals together
+ */
+bool applyOutputCommands(const OutputCommand* commands, uint8_t channelMask) {
+    return applyOutputs(commands, channelMask, false, 0);
+}
+
+/**
+ * Apply target states with the DC setpoints posted on a given sample tick
+ */
+bool applyOutputCommandsAtTick(const OutputCommand* commands, uint8_t channelMask, uint32_t tick) {
+    return applyOutputs(commands, channelMask, true, tick);
+}
+
+/**
+ * Take the output lock for a master write (before the write is stored in the block)
+ */
+static bool lockOutputControlWrite() {
+    return lockOutputs(OUTPUT_LOCK_TIMEOUT_MS);
+}
+
+/**
+ * Write hook for the control block: validate, then apply all touched signals together
+ * Runs with the output lock held from before the write was stored, so a command in
+ * loop() cannot resync the block over the master's registers in between.
+ * @return 0 if applied, Modbus exception code if the block was rejected
+ */
+static uint8_t applyOutputControl(uint8_t meter, uint16_t address, uint16_t count) {
+    if (isModbusModeActive()) {
+        return Modbus::EX_ILLEGAL_ADDRESS; // Block is read-only while emulating the meter
+    }
+    uint8_t first = (address - OUTPUT_CONTROL_BASE) / OUTPUT_CONTROL_STRIDE;
+    uint8_t last = (address + count - 1 - OUTPUT_CONTROL_BASE) / OUTPUT_CONTROL_STRIDE;
+
+    // Validate everything before any output moves
+    OutputCommand commands[3];
+    uint8_t channelMask = 0;
+    for (uint8_t ch = first; ch <= last; ch++) {
+        if (!readOutputCommand(ch, &commands[ch])) {
+            return Modbus::EX_ILLEGAL_VALUE;
+        }
+        channelMask |= 1 << ch;
+    }
+
+    if (!applyOutputCommands(commands, channelMask)) {
+        return Modbus::EX_SLAVE_FAILURE;
+    }
+    // The block now mirrors the outputs, including fields the write did not touch
+    syncOutputControl();
+    return 0;
+}
+
+/**
+ * Take the output lock
+ */
+bool lockOutputs(uint32_t timeoutMs) {
+    if (outputMutex == nullptr) {
+        return true; // Before initOutputControl() only setup() runs
+    }
+    TickType_t ticks = (timeoutMs == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    return xSemaphoreTake(outputMutex, ticks) == pdTRUE;
+}
+
+/**
+ * Release the output lock
+ */
+void unlockOutputs() {
+    if (outputMutex != nullptr) {
+        xSemaphoreGive(outputMutex);
+    }
+}
+
+/**
+ * Copy the real output state into the control block
+ */
+void syncOutputControl() {
+    if (isModbusModeActive()) {
+        return; // Outputs isolated, block stays cleared
+    }
+    uint16_t words[OUTPUT_CONTROL_REGS];
+    memset(words, 0, sizeof(words));
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        uint16_t* block = &words[ch * OUTPUT_CONTROL_STRIDE];
+        float amplitude = 0;
+        float period = 0;
+        float center = 0;
+        char mode = signalModes[ch];
+        if (getSineWaveParams(ch, &amplitude, &period, &center, &mode)) {
+            block[OUTPUT_REG_WAVEFORM] = OUTPUT_WAVEFORM_SINE;
+            encodeFloat1032(center, &block[OUTPUT_REG_SETPOINT]);
+            encodeFloat1032(amplitude, &block[OUTPUT_REG_AMPLITUDE]);
+            encodeFloat1032(period, &block[OUTPUT_REG_PERIOD]);
+        } else {
+            bool otherSource = isWaveformActiveOnChannel(ch) || isProfileActiveOnChannel(ch);
+            block[OUTPUT_REG_WAVEFORM] = otherSource ? OUTPUT_WAVEFORM_OTHER : OUTPUT_WAVEFORM_DC;
+            encodeFloat1032(signalValues[ch], &block[OUTPUT_REG_SETPOINT]);
+        }
+        block[OUTPUT_REG_MODE] = (mode == 'c') ? OUTPUT_MODE_CURRENT : OUTPUT_MODE_VOLTAGE;
+    }
+    writeImageRegisters(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE, words, OUTPUT_CONTROL_REGS);
+}
+
+/**
+ * Attach the control block to the register image
+ */
+void initOutputControl() {
+    outputMutex = xSemaphoreCreateMutex();
+    setImageWriteHook(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE, OUTPUT_CONTROL_REGS, applyOutputControl,
+                      lockOutputControlWrite, unlockOutputs);
+    setOutputControlWritable(!isModbusModeActive());
+    Serial.printf("Output control block: holding registers %d-%d\n",
+                  OUTPUT_CONTROL_BASE, OUTPUT_CONTROL_BASE + OUTPUT_CONTROL_REGS - 1);
+}
+
+/**
+ * Allow or refuse master writes to the control block
+ */
+void setOutputControlWritable(bool writable) {
+    if (!writable) {
+        // Outputs are isolated: the block no longer describes them
+        uint16_t zero[OUTPUT_CONTROL_REGS];
+        memset(zero, 0, sizeof(zero));
+        writeImageRegisters(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE, zero, OUTPUT_CONTROL_REGS);
+    }
+    setImageRegisterAccess(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE, OUTPUT_CONTROL_REGS, writable);
+    if (writable) {
+        syncOutputControl();
+    }
+}
+
+/**
+ * Print the control block contents
+ */
+void printOutputControl() {
+    Serial.println("=== MODBUS OUTPUT CONTROL ===");
+    Serial.printf("Registers %d-%d (slave meter %d), %s\n",
+                  OUTPUT_CONTROL_BASE, OUTPUT_CONTROL_BASE + OUTPUT_CONTROL_REGS - 1, OUTPUT_CONTROL_METER,
+                  isModbusModeActive() ? "read-only in Modbus mode" : "writable");
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        uint16_t words[OUTPUT_CONTROL_STRIDE];
+        readImageRegisters(OUTPUT_CONTROL_METER, OUTPUT_CONTROL_BASE + ch * OUTPUT_CONTROL_STRIDE,
+                           words, OUTPUT_CONTROL_STRIDE);
+        const char* unit = (words[OUTPUT_REG_MODE] == OUTPUT_MODE_CURRENT) ? "mA" : "V";
+        Serial.printf("SIG%d @%d: mode %u, waveform %u, setpoint %.3f %s, amplitude %.3f %s, period %.2f s\n",
+                      ch + 1, OUTPUT_CONTROL_BASE + ch * OUTPUT_CONTROL_STRIDE,
+                      words[OUTPUT_REG_MODE], words[OUTPUT_REG_WAVEFORM],
+                      decodeFloat1032(&words[OUTPUT_REG_SETPOINT]), unit,
+                      decodeFloat1032(&words[OUTPUT_REG_AMPLITUDE]), unit,
+                      decodeFloat1032(&words[OUTPUT_REG_PERIOD]));
+    }
+    Serial.println("=============================");
+}
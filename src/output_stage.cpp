@@ -0,0 +1,368 @@
+#include "output_stage.h"
+#include "dac_output_queue.h"
+#include "dac_codes.h"
+#include "sample_clock.h"
+#include "sample_output.h"
+
+#define STAGE_ONE_Q16 65536
+
+// Per-channel settings, coefficients and state
+struct OutputStageChannel {
+    float slewRate;         // V/s or mA/s, 0 = unlimited
+    float filterTau;        // Seconds, 0 = off
+
+    // Fixed-point coefficients, rebuilt when settings, mode or sample rate change
+    int32_t maxStepQ16;     // Max change per tick in Q16 codes, 0 = unlimited
+    int32_t alphaQ16;       // Filter gain per tick, STAGE_ONE_Q16 = off
+    char coeffMode;
+    float coeffRate;
+    bool coeffDirty;
+
+    // State (sample clock task)
+    bool running;           // Output has not reached target yet
+    char mode;              // Mode of target and value
+    int32_t valueQ16;       // Current output in Q16 codes
+    uint16_t target;        // Target code
+    uint16_t emitted;       // Last code posted by the stage
+
+    // Manual setpoint handed over from loop()
+    bool manualPending;
+    bool manualAtTick;      // Take it over on manualTick, not on the next tick
+    char manualMode;
+    uint16_t manualCode;
+    uint32_t manualTick;
+};
+
+static OutputStageChannel stageChannels[3];
+static portMUX_TYPE stageMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Initialize output stage (all channels pass-through)
+ */
+void initOutputStage() {
+    memset(stageChannels, 0, sizeof(stageChannels));
+    for (int i = 0; i < 3; i++) {
+        stageChannels[i].alphaQ16 = STAGE_ONE_Q16;
+        stageChannels[i].mode = 'v';
+        stageChannels[i].coeffDirty = true;
+    }
+}
+
+/**
+ * Set maximum slew rate of a channel
+ */
+void setOutputSlewRate(uint8_t channel, float rate) {
+    if (channel >= 3) return;
+    portENTER_CRITICAL(&stageMux);
+    stageChannels[channel].slewRate = (rate > 0) ? rate : 0;
+    stageChannels[channel].coeffDirty = true;
+    portEXIT_CRITICAL(&stageMux);
+}
+
+/**
+ * Set smoothing filter time constant of a channel
+ */
+void setOutputFilter(uint8_t channel, float tauSeconds) {
+    if (channel >= 3) return;
+    portENTER_CRITICAL(&stageMux);
+    stageChannels[channel].filterTau = (tauSeconds > 0) ? tauSeconds : 0;
+    stageChannels[channel].coeffDirty = true;
+    portEXIT_CRITICAL(&stageMux);
+}
+
+/**
+ * Check if a channel shapes its output
+ */
+bool isOutputStageEnabled(uint8_t channel) {
+    if (channel >= 3) return false;
+    return stageChannels[channel].slewRate > 0 || stageChannels[channel].filterTau > 0;
+}
+
+/**
+ * Post a manual setpoint through the stage (or directly if the stage is off)
+ */
+void postSetpointCode(uint8_t channel, char mode, uint16_t code) {
+    if (channel >= 3) return;
+    cancelScheduledChannel(channel); // Replaces a latched code not yet written
+    if (!isOutputStageEnabled(channel)) {
+        if (mode == 'v') {
+            postVoltageCode(channel, code);
+        } else {
+            postCurrentCode(channel, code);
+        }
+        return;
+    }
+    // Picked up by the next sample tick
+    portENTER_CRITICAL(&stageMux);
+    stageChannels[channel].manualPending = true;
+    stageChannels[channel].manualAtTick = false;
+    stageChannels[channel].manualMode = mode;
+    stageChannels[channel].manualCode = code;
+    portEXIT_CRITICAL(&stageMux);
+}
+
+/**
+ * Post a manual setpoint that the stage takes over on a given sample tick
+ */
+void postSetpointCodeAtTick(uint8_t channel, char mode, uint16_t code, uint32_t tick) {
+    if (channel >= 3) return;
+    cancelScheduledChannel(channel);
+    if (!isOutputStageEnabled(channel)) {
+        postSetpointCode(channel, mode, code);
+        return;
+    }
+    portENTER_CRITICAL(&stageMux);
+    stageChannels[channel].manualPending = true;
+    stageChannels[channel].manualAtTick = true;
+    stageChannels[channel].manualMode = mode;
+    stageChannels[channel].manualCode = code;
+    stageChannels[channel].manualTick = tick;
+    portEXIT_CRITICAL(&stageMux);
+}
+
+/**
+ * Rebuild fixed-point coefficients for the channel's mode and the sample rate
+ */
+static void rebuildCoefficients(OutputStageChannel* ch, float sampleRate) {
+    // DAC codes per V or per mA
+    float codesPerUnit = (ch->mode == 'v') ? GP8413VoltageCodec::kMaxCode * 1000.0f / 10000.0f
+                                           : GP8313CurrentCodec::kMaxCode * 1000.0f / 25000.0f;
+    if (ch->slewRate > 0) {
+        float step = ch->slewRate * codesPerUnit / sampleRate * STAGE_ONE_Q16;
+        ch->maxStepQ16 = (step < 1.0f) ? 1 : (step > 32767.0f * STAGE_ONE_Q16) ? 0 : (int32_t)step;
+    } else {
+        ch->maxStepQ16 = 0;
+    }
+    if (ch->filterTau > 0) {
+        float alpha = (1.0f - expf(-1.0f / (ch->filterTau * sampleRate))) * STAGE_ONE_Q16;
+        ch->alphaQ16 = (alpha < 1.0f) ? 1 : (int32_t)alpha;
+    } else {
+        ch->alphaQ16 = STAGE_ONE_Q16;
+    }
+    ch->coeffMode = ch->mode;
+    ch->coeffRate = sampleRate;
+    ch->coeffDirty = false;
+}
+
+/**
+ * Filter gain over several ticks: 1 - (1 - alpha)^ticks in Q16 (square-and-multiply)
+ */
+static int32_t filterGainQ16(int32_t alphaQ16, uint32_t ticks) {
+    if (ticks <= 1 || alphaQ16 >= STAGE_ONE_Q16) {
+        return alphaQ16;
+    }
+    int64_t keep = STAGE_ONE_Q16 - alphaQ16;
+    int64_t keepN = STAGE_ONE_Q16;
+    while (ticks > 0 && keepN > 0) {
+        if (ticks & 1) keepN = (keepN * keep) >> 16;
+        keep = (keep * keep) >> 16;
+        ticks >>= 1;
+    }
+    return STAGE_ONE_Q16 - (int32_t)keepN;
+}
+
+/**
+ * Shape a tick's output frame in place
+ */
+void applyOutputStage(DacFrame* frame, uint32_t ticks) {
+    if (ticks == 0) ticks = 1;
+    uint32_t now = getSampleTick();
+    float sampleRate = getSampleClockRate();
+
+    for (uint8_t i = 0; i < 3; i++) {
+        OutputStageChannel* ch = &stageChannels[i];
+        uint8_t bit = 1 << i;
+
+        portENTER_CRITICAL(&stageMux);
+        bool enabled = ch->slewRate > 0 || ch->filterTau > 0;
+        bool manual = ch->manualPending &&
+                      (!ch->manualAtTick || (int32_t)(now - ch->manualTick) >= 0);
+        char manualMode = ch->manualMode;
+        uint16_t manualCode = ch->manualCode;
+        if (manual) {
+            ch->manualPending = false;
+        }
+        bool coeffDirty = ch->coeffDirty;
+        portEXIT_CRITICAL(&stageMux);
+
+        if (!enabled) {
+            // Stage just turned off: commit the target instead of freezing a ramp in
+            // progress or dropping a pending manual setpoint (a source sample in this
+            // frame replaces either anyway). A ramp already stopped by a safety write
+            // stays stopped.
+            bool commit = manual ||
+                          (ch->running && getLastPostedCode(i, ch->mode) == ch->emitted);
+            bool sourced = (frame->voltagePending | frame->currentPending) & bit;
+            if (commit && !sourced) {
+                char mode = manual ? manualMode : ch->mode;
+                uint16_t code = manual ? manualCode : ch->target;
+                if (mode == 'v') {
+                    postVoltageCode(i, code);
+                } else {
+                    postCurrentCode(i, code);
+                }
+            }
+            ch->running = false;
+            continue;
+        }
+
+        // A safety write (zeroing on stop or mode change) bypassed the stage since the
+        // last tick: stop on that value instead of ramping back to the old target
+        if (ch->running) {
+            uint16_t posted = getLastPostedCode(i, ch->mode);
+            if (posted != ch->emitted) {
+                ch->running = false;
+                ch->target = posted;
+                ch->emitted = posted;
+                ch->valueQ16 = (int32_t)posted << 16;
+            }
+        }
+
+        // New target: source sample of this tick first, then a manual setpoint
+        bool haveTarget = true;
+        char mode = ch->mode;
+        uint16_t target = ch->target;
+        if (frame->voltagePending & bit) {
+            mode = 'v';
+            target = frame->voltageCode[i];
+        } else if (frame->currentPending & bit) {
+            mode = 'c';
+            target = frame->currentCode[i];
+        } else if (manual) {
+            mode = manualMode;
+            target = manualCode;
+        } else {
+            haveTarget = ch->running;
+        }
+        if (!haveTarget) {
+            continue;
+        }
+
+        // Start from the actual output when idle, after a mode change, or when a
+        // safety write bypassed the stage before this new target
+        uint16_t lastPosted = getLastPostedCode(i, mode);
+        if (!ch->running || mode != ch->mode || lastPosted != ch->emitted) {
+            ch->valueQ16 = (int32_t)lastPosted << 16;
+        }
+        ch->mode = mode;
+        ch->target = target;
+        if (coeffDirty || ch->coeffMode != mode || ch->coeffRate != sampleRate) {
+            rebuildCoefficients(ch, sampleRate);
+        }
+
+        // First-order filter, then slew limit on the resulting step, both over all
+        // ticks due (a late sample task catches up instead of slowing the ramp)
+        int32_t targetQ16 = (int32_t)target << 16;
+        int32_t error = targetQ16 - ch->valueQ16;
+        int32_t alphaQ16 = filterGainQ16(ch->alphaQ16, ticks);
+        int32_t step = (alphaQ16 >= STAGE_ONE_Q16) ? error
+                                                   : (int32_t)(((int64_t)error * alphaQ16) >> 16);
+        if (ch->maxStepQ16 > 0) {
+            int64_t maxStep = (int64_t)ch->maxStepQ16 * ticks;
+            if (step > maxStep) step = (int32_t)maxStep;
+            if (step < -maxStep) step = (int32_t)-maxStep;
+        }
+        ch->valueQ16 += step;
+
+        // Settle once within half a code (the filter alone only approaches the target)
+        int32_t remaining = targetQ16 - ch->valueQ16;
+        if (remaining > -(1 << 15) && remaining < (1 << 15)) {
+            ch->valueQ16 = targetQ16;
+        }
+        ch->running = (ch->valueQ16 != targetQ16);
+
+        int32_t code = (ch->valueQ16 + (1 << 15)) >> 16;
+        if (code < 0) code = 0;
+        if (code > 32767) code = 32767;
+        ch->emitted = (uint16_t)code;
+
+        if (mode == 'v') {
+            dacFrameSetVoltageCode(frame, i, ch->emitted);
+        } else {
+            dacFrameSetCurrentCode(frame, i, ch->emitted);
+        }
+    }
+}
+
+/**
+ * Print output stage settings and state
+ */
+void printOutputStageStatus() {
+    Serial.println("=== OUTPUT STAGE ===");
+    for (int i = 0; i < 3; i++) {
+        OutputStageChannel* ch = &stageChannels[i];
+        if (!isOutputStageEnabled(i)) {
+            Serial.printf("SIG%d: pass-through\n", i + 1);
+            continue;
+        }
+        const char* unit = (ch->mode == 'v') ? "V" : "mA";
+        float fullScale = (ch->mode == 'v') ? 10.0f : 25.0f;
+        if (ch->slewRate > 0) {
+            Serial.printf("SIG%d: slew %.3f %s/s", i + 1, ch->slewRate, unit);
+        } else {
+            Serial.printf("SIG%d: slew unlimited", i + 1);
+        }
+        if (ch->filterTau > 0) {
+            Serial.printf(", filter tau %.3fs", ch->filterTau);
+        }
+        Serial.printf(", output %.3f%s -> target %.3f%s%s\n",
+                      ch->emitted * fullScale / 32767, unit, ch->target * fullScale / 32767, unit,
+                      ch->running ? " (moving)" : "");
+    }
+    Serial.println("====================");
+}
+
+/**
+ * Parse output stage commands
+ * Format: stage <signal> slew <rate|off> | stage <signal> filter <tau|off> | stage <signal> off | stage status
+ */
+void parseOutputStageCommand(String input) {
+    input.trim();
+    input.toLowerCase();
+    String params = input.substring(5); // Remove "stage"
+    params.trim();
+
+    if (params.length() == 0 || params.startsWith("status")) {
+        printOutputStageStatus();
+        return;
+    }
+
+    int space1 = params.indexOf(' ');
+    int signal = params.substring(0, space1 == -1 ? params.length() : space1).toInt();
+    if (signal < 1 || signal > 3 || space1 == -1) {
+        Serial.println("Usage: stage <signal> slew <rate|off> | stage <signal> filter <tau|off> | stage <signal> off");
+        Serial.println("Example: stage 2 slew 5      // SIG2 max 5 V/s (or 5 mA/s in current mode)");
+        Serial.println("         stage 2 filter 0.2  // SIG2 smoothing, 0.2s time constant");
+        return;
+    }
+    String rest = params.substring(space1 + 1);
+    rest.trim();
+    int space2 = rest.indexOf(' ');
+    String option = rest.substring(0, space2 == -1 ? rest.length() : space2);
+    String value = (space2 == -1) ? String("") : rest.substring(space2 + 1);
+    value.trim();
+
+    if (option == "off") {
+        setOutputSlewRate(signal - 1, 0);
+        setOutputFilter(signal - 1, 0);
+        Serial.printf("SIG%d: output stage off (pass-through)\n", signal);
+    } else if (option == "slew" && value.length() > 0) {
+        float rate = (value == "off") ? 0 : value.toFloat();
+        setOutputSlewRate(signal - 1, rate);
+        if (rate > 0) {
+            Serial.printf("SIG%d: slew limit %.3f V/s (mA/s in current mode)\n", signal, rate);
+        } else {
+            Serial.printf("SIG%d: slew limit off\n", signal);
+        }
+    } else if (option == "filter" && value.length() > 0) {
+        float tau = (value == "off") ? 0 : value.toFloat();
+        setOutputFilter(signal - 1, tau);
+        if (tau > 0) {
+            Serial.printf("SIG%d: smoothing filter tau %.3fs\n", signal, tau);
+        } else {
+            Serial.printf("SIG%d: smoothing filter off\n", signal);
+        }
+    } else {
+        Serial.println("Usage: stage <signal> slew <rate|off> | stage <signal> filter <tau|off> | stage <signal> off");
+    }
+}
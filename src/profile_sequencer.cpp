@@ -0,0 +1,538 @@
+#include "profile_sequencer.h"
+#include "dac_codes.h"
+#include "dac_output_queue.h"
+#include "relay_controller.h"
+#include "sample_clock.h"
+#include "sine_wave_generator.h"
+#include "waveform_player.h"
+#include "sample_output.h"
+
+extern float signalValues[3];
+
+enum ProfileSegmentType {
+    PROFILE_STEP,
+    PROFILE_RAMP,
+    PROFILE_HOLD,
+    PROFILE_LOOP
+};
+
+struct ProfileSegment {
+    uint8_t type;           // ProfileSegmentType
+    uint16_t code;          // Target DAC code (STEP, RAMP)
+    uint32_t durationMs;    // RAMP, HOLD
+    uint16_t loopCount;     // LOOP, 0 = forever
+};
+
+// Per-channel profile and execution state
+struct ProfileChannel {
+    ProfileSegment segments[PROFILE_MAX_SEGMENTS];
+    uint8_t count;          // Loaded segments
+    char mode;              // 'v' or 'c'
+    bool loaded;
+    bool active;
+    bool finished;
+    uint8_t index;          // Current segment
+    uint8_t loopStart;      // First segment repeated by the next LOOP
+    uint32_t loopsDone;     // Completed passes of the current loop
+    uint32_t segmentTick;   // Ticks spent in current RAMP/HOLD
+    uint32_t segmentTicks;  // Length of current RAMP/HOLD in ticks
+    int32_t startCode;      // Code at start of current RAMP
+    int32_t code;           // Current output code
+    uint32_t ticks[PROFILE_MAX_SEGMENTS]; // RAMP/HOLD length in ticks at tickRate
+    float tickRate;         // Sample clock rate the tick lengths were computed for
+};
+
+static ProfileChannel profiles[3];
+static volatile uint8_t profileStartMask = 0;  // Channels to start on the next tick
+
+// Guards execution state shared between loop() and the sample clock task
+static portMUX_TYPE profileMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int32_t codeToUnits(int32_t code, char mode) {
+    return (mode == 'v') ? GP8413VoltageCodec::toUnits(code) : GP8313CurrentCodec::toUnits(code);
+}
+
+/**
+ * Initialize profile sequencer
+ */
+void initProfileSequencer() {
+    memset(profiles, 0, sizeof(profiles));
+    for (int i = 0; i < 3; i++) {
+        profiles[i].mode = 'v';
+    }
+    Serial.printf("Profile sequencer initialized (%d segments per channel)\n", PROFILE_MAX_SEGMENTS);
+}
+
+/**
+ * Parse one segment, e.g. "RAMP 10 5"
+ * @return true if segment is valid
+ */
+static bool parseSegment(String text, char mode, ProfileSegment* segment) {
+    text.trim();
+    text.toUpperCase();
+    int space1 = text.indexOf(' ');
+    String type = (space1 == -1) ? text : text.substring(0, space1);
+    String args = (space1 == -1) ? String("") : text.substring(space1 + 1);
+    args.trim();
+    int space2 = args.indexOf(' ');
+
+    float maxValue = (mode == 'v') ? 10.0f : 25.0f;
+    memset(segment, 0, sizeof(ProfileSegment));
+
+    if (type == "STEP" || type == "RAMP") {
+        if (args.length() == 0 || (type == "RAMP" && space2 == -1)) {
+            return false;
+        }
+        float value = args.substring(0, space2 == -1 ? args.length() : space2).toFloat();
+        if (value < 0 || value > maxValue) {
+            Serial.printf("Invalid value %.2f (0-%.0f%s)\n", value, maxValue, (mode == 'v') ? "V" : "mA");
+            return false;
+        }
+        int32_t units = (int32_t)lroundf(value * 1000.0f); // mV or uA
+        segment->code = (mode == 'v') ? GP8413VoltageCodec::toCode(units) : GP8313CurrentCodec::toCode(units);
+        if (type == "STEP") {
+            segment->type = PROFILE_STEP;
+            return true;
+        }
+        segment->type = PROFILE_RAMP;
+        args = args.substring(space2 + 1);
+    } else if (type == "HOLD") {
+        segment->type = PROFILE_HOLD;
+    } else if (type == "LOOP") {
+        segment->type = PROFILE_LOOP;
+        long count = args.toInt();
+        if (args.length() == 0 || count < 0 || count > 65535) {
+            return false;
+        }
+        segment->loopCount = (uint16_t)count;
+        return true;
+    } else {
+        return false;
+    }
+
+    // RAMP / HOLD duration in seconds
+    float seconds = args.toFloat();
+    if (args.length() == 0 || seconds < 0 || seconds > 86400.0f) {
+        Serial.println("Invalid duration (0-86400 s)");
+        return false;
+    }
+    segment->durationMs = (uint32_t)lroundf(seconds * 1000.0f);
+    return true;
+}
+
+/**
+ * Load a profile for one channel from its segment list
+ */
+bool loadProfile(uint8_t signal, char mode, String segments) {
+    if (signal < 1 || signal > 3) {
+        Serial.println("Invalid signal number. Use 1-3.");
+        return false;
+    }
+    if (mode != 'v' && mode != 'c') {
+        Serial.println("Invalid mode. Use 'v' for voltage or 'c' for current.");
+        return false;
+    }
+    ProfileChannel* ch = &profiles[signal - 1];
+    if (ch->active || (profileStartMask & (1 << (signal - 1)))) {
+        Serial.printf("SIG%d: profile running. Use PROFILE STOP %d first.\n", signal, signal);
+        return false;
+    }
+
+    ProfileSegment parsed[PROFILE_MAX_SEGMENTS];
+    uint8_t count = 0;
+    bool timedSinceLoop = false;
+    int pos = 0;
+    while (pos <= (int)segments.length()) {
+        int next = segments.indexOf(';', pos);
+        if (next == -1) next = segments.length();
+        String text = segments.substring(pos, next);
+        text.trim();
+        pos = next + 1;
+        if (text.length() == 0) {
+            continue;
+        }
+        if (count >= PROFILE_MAX_SEGMENTS) {
+            Serial.printf("SIG%d: too many segments (max %d)\n", signal, PROFILE_MAX_SEGMENTS);
+            return false;
+        }
+        if (!parseSegment(text, mode, &parsed[count])) {
+            Serial.printf("SIG%d: invalid segment '%s'\n", signal, text.c_str());
+            return false;
+        }
+        ProfileSegment* segment = &parsed[count];
+        if (segment->type == PROFILE_RAMP || segment->type == PROFILE_HOLD) {
+            timedSinceLoop = timedSinceLoop || segment->durationMs > 0;
+        } else if (segment->type == PROFILE_LOOP) {
+            // A loop with no elapsed time would never yield to the next tick
+            if (!timedSinceLoop) {
+                Serial.printf("SIG%d: LOOP needs a RAMP or HOLD with non-zero time before it\n", signal);
+                return false;
+            }
+            timedSinceLoop = false;
+        }
+        count++;
+    }
+    if (count == 0) {
+        Serial.printf("SIG%d: empty profile\n", signal);
+        return false;
+    }
+
+    memcpy(ch->segments, parsed, count * sizeof(ProfileSegment));
+    ch->count = count;
+    ch->mode = mode;
+    ch->loaded = true;
+    ch->finished = false;
+    Serial.printf("SIG%d: profile loaded (%d segments, %s mode)\n", signal, count,
+                  (mode == 'v') ? "voltage" : "current");
+    return true;
+}
+
+/**
+ * Start loaded profiles on several channels in the same sample tick
+ */
+bool startProfiles(uint8_t signalMask) {
+    uint8_t startMask = 0;
+    for (uint8_t channel = 0; channel < 3; channel++) {
+        if (!(signalMask & (1 << channel))) {
+            continue;
+        }
+        ProfileChannel* ch = &profiles[channel];
+        if (!ch->loaded) {
+            Serial.printf("SIG%d: no profile loaded.\n", channel + 1);
+            continue;
+        }
+        if (ch->active) {
+            Serial.printf("SIG%d: profile already running.\n", channel + 1);
+            continue;
+        }
+
+        // Take the channel over from other sources and set the relay before the first sample
+        releaseSineChannel(channel);
+        releaseWaveformChannel(channel);
+        bool modeChanged = (signalModes[channel] != ch->mode);
+        signalModes[channel] = ch->mode;
+        setRelayMode(channel + 1, ch->mode);
+
+        // Ramps start from the channel's current manual value; after a mode change that
+        // value is in the other mode's units, so start from what the new DAC holds
+        if (modeChanged) {
+            ch->code = getLastPostedCode(channel, ch->mode);
+        } else {
+            float maxValue = (ch->mode == 'v') ? 10.0f : 25.0f;
+            float value = constrain(signalValues[channel], 0.0f, maxValue);
+            int32_t units = (int32_t)lroundf(value * 1000.0f);
+            ch->code = (ch->mode == 'v') ? GP8413VoltageCodec::toCode(units) : GP8313CurrentCodec::toCode(units);
+        }
+        startMask |= (1 << channel);
+    }
+    if (startMask == 0) {
+        return false;
+    }
+
+    // Picked up atomically by the next tick
+    portENTER_CRITICAL(&profileMux);
+    profileStartMask |= startMask;
+    portEXIT_CRITICAL(&profileMux);
+    Serial.printf("Profiles started:%s%s%s\n", (startMask & 1) ? " SIG1" : "",
+                  (startMask & 2) ? " SIG2" : "", (startMask & 4) ? " SIG3" : "");
+    return true;
+}
+
+/**
+ * Enter the segment at ch->index, executing zero-time segments (STEP, LOOP) immediately
+ * Caller holds profileMux.
+ */
+static void enterSegment(ProfileChannel* ch) {
+    // Loops without elapsed time are rejected at load, this only bounds a corrupt profile
+    for (int guard = 0; guard < 2 * PROFILE_MAX_SEGMENTS + 2; guard++) {
+        if (ch->index >= ch->count) {
+            ch->active = false;
+            ch->finished = true;
+            return;
+        }
+        const ProfileSegment* segment = &ch->segments[ch->index];
+        switch (segment->type) {
+            case PROFILE_STEP:
+                ch->code = segment->code;
+                ch->index++;
+                break;
+            case PROFILE_LOOP:
+                ch->loopsDone++;
+                if (segment->loopCount == 0 || ch->loopsDone < segment->loopCount) {
+                    ch->index = ch->loopStart;
+                } else {
+                    ch->loopsDone = 0;
+                    ch->index++;
+                    ch->loopStart = ch->index;
+                }
+                break;
+            default: {
+                uint32_t ticks = ch->ticks[ch->index];
+                if (ticks == 0) {
+                    if (segment->type == PROFILE_RAMP) {
+                        ch->code = segment->code;
+                    }
+                    ch->index++;
+                    break;
+                }
+                ch->startCode = ch->code;
+                ch->segmentTick = 0;
+                ch->segmentTicks = ticks;
+                return;
+            }
+        }
+    }
+    ch->active = false;
+    ch->finished = true;
+}
+
+/**
+ * Advance a running profile by one sample tick
+ * Caller holds profileMux.
+ */
+static void advanceProfile(ProfileChannel* ch) {
+    if (!ch->active) {
+        return;
+    }
+    const ProfileSegment* segment = &ch->segments[ch->index];
+    ch->segmentTick++;
+    if (segment->type == PROFILE_RAMP) {
+        int32_t delta = (int32_t)segment->code - ch->startCode;
+        ch->code = ch->startCode + (int32_t)(((int64_t)delta * ch->segmentTick) / ch->segmentTicks);
+    }
+    if (ch->segmentTick >= ch->segmentTicks) {
+        ch->index++;
+        enterSegment(ch);
+    }
+}
+
+/**
+ * Convert segment durations to ticks at the given sample rate (outside profileMux)
+ */
+static void updateSegmentTicks(ProfileChannel* ch, float rate) {
+    for (uint8_t i = 0; i < ch->count; i++) {
+        ch->ticks[i] = (uint32_t)lroundf(ch->segments[i].durationMs * rate / 1000.0f);
+    }
+    ch->tickRate = rate;
+}
+
+/**
+ * Render profile setpoints into the tick's output frame
+ */
+void renderProfiles(DacFrame* frame, uint32_t ticks) {
+    portENTER_CRITICAL(&profileMux);
+    uint8_t startMask = profileStartMask;
+    profileStartMask = 0;
+    portEXIT_CRITICAL(&profileMux);
+
+    // Segments entered from now on use the current rate, the running one keeps its length
+    float rate = getSampleClockRate();
+
+    for (int channel = 0; channel < 3; channel++) {
+        ProfileChannel* ch = &profiles[channel];
+        bool starting = startMask & (1 << channel);
+        if (starting || (ch->active && ch->tickRate != rate)) {
+            updateSegmentTicks(ch, rate);
+        }
+
+        portENTER_CRITICAL(&profileMux);
+        if (starting) {
+            // Started channels begin together at this tick, missed ticks do not apply to them
+            ch->active = true;
+            ch->finished = false;
+            ch->index = 0;
+            ch->loopStart = 0;
+            ch->loopsDone = 0;
+            enterSegment(ch);
+        } else if (ch->active) {
+            for (uint32_t i = 1; i < ticks; i++) {
+                advanceProfile(ch);
+            }
+        }
+        bool emit = starting || ch->active;
+        int32_t code = ch->code;
+        if (ch->active) {
+            advanceProfile(ch);
+        }
+        // Last segment done: hold its final value from now on
+        bool justFinished = emit && !ch->active;
+        if (justFinished) {
+            code = ch->code;
+        }
+        portEXIT_CRITICAL(&profileMux);
+
+        if (!emit) {
+            continue;
+        }
+        if (ch->mode == 'v') {
+            dacFrameSetVoltageCode(frame, channel, code);
+        } else {
+            dacFrameSetCurrentCode(frame, channel, code);
+        }
+        if (justFinished) {
+            signalValues[channel] = codeToUnits(code, ch->mode) / 1000.0f;
+        }
+    }
+}
+
+/**
+ * Deactivate a channel, return true if it was running or about to start
+ */
+static bool deactivateProfile(uint8_t channel) {
+    ProfileChannel* ch = &profiles[channel];
+    portENTER_CRITICAL(&profileMux);
+    bool wasActive = ch->active || (profileStartMask & (1 << channel));
+    ch->active = false;
+    profileStartMask &= ~(1 << channel);
+    int32_t code = ch->code;
+    portEXIT_CRITICAL(&profileMux);
+    if (wasActive) {
+        signalValues[channel] = codeToUnits(code, ch->mode) / 1000.0f;
+    }
+    return wasActive;
+}
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ */
+void releaseProfileChannel(uint8_t channel) {
+    cancelScheduledChannel(channel); // A latched code must not overwrite the new source
+    if (channel < 3 && deactivateProfile(channel)) {
+        Serial.printf("Profile on SIG%d replaced.\n", channel + 1);
+    }
+}
+
+/**
+ * Stop profile execution, the output keeps its last value
+ */
+void stopProfile(uint8_t signal) {
+    if (signal > 3) {
+        Serial.println("Invalid signal number. Use 1-3, or 0 to stop all.");
+        return;
+    }
+    bool anyActive = false;
+    for (uint8_t channel = 0; channel < 3; channel++) {
+        if (signal != 0 && channel != signal - 1) {
+            continue;
+        }
+        if (deactivateProfile(channel)) {
+            anyActive = true;
+            Serial.printf("Profile stopped on SIG%d, output held at %.3f%s\n", channel + 1,
+                          signalValues[channel], (profiles[channel].mode == 'v') ? "V" : "mA");
+        }
+    }
+    if (!anyActive && signal != 0) {
+        Serial.printf("No profile is running on SIG%d.\n", signal);
+    }
+}
+
+/**
+ * Check if a profile is running on specific channel
+ */
+bool isProfileActiveOnChannel(uint8_t channel) {
+    if (channel >= 3) return false;
+    return profiles[channel].active;
+}
+
+/**
+ * Print profile status
+ */
+void getProfileStatus() {
+    static const char* segmentNames[] = {"STEP", "RAMP", "HOLD", "LOOP"};
+    Serial.println("=== PROFILE STATUS ===");
+    for (int i = 0; i < 3; i++) {
+        ProfileChannel* ch = &profiles[i];
+        const char* unit = (ch->mode == 'v') ? "V" : "mA";
+        if (!ch->loaded) {
+            Serial.printf("SIG%d: EMPTY\n", i + 1);
+            continue;
+        }
+        float value = codeToUnits(ch->code, ch->mode) / 1000.0f;
+        if (ch->active) {
+            const ProfileSegment* segment = &ch->segments[ch->index];
+            Serial.printf("SIG%d: RUNNING segment %d/%d (%s), %lu/%lu ticks, output %.3f%s\n",
+                          i + 1, ch->index + 1, ch->count, segmentNames[segment->type],
+                          (unsigned long)ch->segmentTick, (unsigned long)ch->segmentTicks, value, unit);
+        } else {
+            Serial.printf("SIG%d: %s (%d segments, %s mode)\n", i + 1, ch->finished ? "DONE" : "LOADED",
+                          ch->count, (ch->mode == 'v') ? "voltage" : "current");
+        }
+    }
+    Serial.println("======================");
+}
+
+/**
+ * Parse profile commands
+ * Format: PROFILE LOAD/START/STOP/STATUS ...
+ */
+void parseProfileCommand(String input) {
+    input.trim();
+    String upper = input;
+    upper.toUpperCase();
+
+    if (upper.startsWith("PROFILE LOAD")) {
+        // PROFILE LOAD signal mode segments [| signal mode segments ...]
+        String params = upper.substring(12);
+        int pos = 0;
+        while (pos <= (int)params.length()) {
+            int next = params.indexOf('|', pos);
+            if (next == -1) next = params.length();
+            String block = params.substring(pos, next);
+            block.trim();
+            pos = next + 1;
+            if (block.length() == 0) {
+                continue;
+            }
+            int space1 = block.indexOf(' ');
+            int space2 = block.indexOf(' ', space1 + 1);
+            if (space1 == -1 || space2 == -1) {
+                Serial.println("Invalid PROFILE LOAD format. Use: PROFILE LOAD signal mode segment; segment; ...");
+                return;
+            }
+            uint8_t signal = block.substring(0, space1).toInt();
+            char mode = toLowerCase(block.charAt(space1 + 1));
+            if (!loadProfile(signal, mode, block.substring(space2 + 1))) {
+                return;
+            }
+        }
+
+    } else if (upper.startsWith("PROFILE START")) {
+        // PROFILE START [signal ...], default all loaded channels
+        String params = upper.substring(13);
+        params.trim();
+        uint8_t mask = 0;
+        if (params.length() == 0) {
+            for (int i = 0; i < 3; i++) {
+                if (profiles[i].loaded && !profiles[i].active) mask |= (1 << i);
+            }
+        } else {
+            for (unsigned int i = 0; i < params.length(); i++) {
+                char c = params.charAt(i);
+                if (c >= '1' && c <= '3') mask |= (1 << (c - '1'));
+            }
+        }
+        if (!startProfiles(mask)) {
+            Serial.println("No profiles started.");
+        }
+
+    } else if (upper.startsWith("PROFILE STOP")) {
+        String params = upper.substring(12);
+        params.trim();
+        stopProfile(params.length() == 0 ? 0 : params.toInt());
+
+    } else if (upper.startsWith("PROFILE STATUS")) {
+        getProfileStatus();
+
+    } else {
+        Serial.println("Invalid profile command. Use:");
+        Serial.println("  PROFILE LOAD signal mode segment; segment; ... [| signal mode ...]");
+        Serial.println("  PROFILE START [signal ...]");
+        Serial.println("  PROFILE STOP [signal]");
+        Serial.println("  PROFILE STATUS");
+        Serial.println("Segments: STEP value | RAMP value seconds | HOLD seconds | LOOP n (0 = forever)");
+        Serial.println("Examples:");
+        Serial.println("  PROFILE LOAD 1 V STEP 0; RAMP 10 5; HOLD 2; RAMP 0 5; LOOP 3");
+        Serial.println("  PROFILE LOAD 1 V RAMP 10 5 | 2 C STEP 4; HOLD 1; STEP 20; HOLD 1; LOOP 0");
+        Serial.println("  PROFILE START");
+    }
+}
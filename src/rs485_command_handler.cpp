@@ -3,6 +3,19 @@
 #include "relay_controller.h"
 #include "sine_wave_generator.h"
 #include "device_id.h"
+#include "modbus_handler.h"
+#include "output_control.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "sample_output.h"
+#include "sample_clock.h"
+
+extern char signalModes[3];
+extern float signalValues[3];
+
+// Values waiting for CMD_LATCH_OUTPUTS
+static OutputCommand stagedCommands[3];
+static uint8_t stagedMask = 0;
 
 // Forward declaration
 void printStatusReport();
@@ -22,6 +35,7 @@ bool handleRS485Commands() {
     if (processRS485Commands()) {
         RS485Command* command = getLastCommand();
         if (command && command->valid) {
+            OutputLockScope outputLock; // Same lock as USB commands and Modbus control writes
             return executeRS485Command(command);
         }
     }
@@ -73,6 +87,16 @@ bool executeRS485Command(RS485Command* command) {
             success = handleStopSineCommand(command->data, command->length);
             break;
             
+        case CMD_SET_OUTPUTS:
+            // Answered with the compact status instead of an ack
+            return handleSetOutputsCommand(command->data, command->length);
+            
+        case CMD_STAGE_OUTPUTS:
+            return handleStageOutputsCommand(command->data, command->length);
+            
+        case CMD_LATCH_OUTPUTS:
+            return handleLatchOutputsCommand(command->data, command->length, command->rxTick);
+            
         default:
             Serial.printf("Unknown command: 0x%02X\n", command->commandType);
             sendAckResponse(false);
@@ -290,4 +314,169 @@ bool handleStopSineCommand(const uint8_t* data, uint8_t length) {
     stopSineWave(0);  // Stop all channels
     
     return true;
-} 
\ No newline at end of file
+}
+
+/**
+ * Build the compact status response
+ * @param result Response code (RESP_*)
+ * @param status Output buffer (RS485_COMPACT_STATUS_LENGTH bytes)
+ * @return Number of bytes written
+ */
+uint8_t buildCompactStatus(uint8_t result, uint8_t* status) {
+    uint8_t modeBits = 0;
+    uint8_t relayBits = 0;
+    uint8_t sourceBits = 0;
+    for (int i = 0; i < 3; i++) {
+        if (signalModes[i] == 'c') {
+            modeBits |= 1 << i;
+        }
+        if (isSineWaveActiveOnChannel(i) || isWaveformActiveOnChannel(i) || isProfileActiveOnChannel(i)) {
+            sourceBits |= 1 << i;
+        }
+    }
+    for (int i = 1; i <= 6; i++) {
+        if (getRelayState(i)) {
+            relayBits |= 1 << (i - 1);
+        }
+    }
+    status[0] = result;
+    status[1] = modeBits;
+    status[2] = relayBits;
+    status[3] = sourceBits;
+    for (int i = 0; i < 3; i++) {
+        uint16_t valueRaw = (uint16_t)lroundf(signalValues[i] * 100);
+        status[4 + 2 * i] = (valueRaw >> 8) & 0xFF;
+        status[5 + 2 * i] = valueRaw & 0xFF;
+    }
+    return RS485_COMPACT_STATUS_LENGTH;
+}
+
+/**
+ * Decode and check a batch payload (nothing is applied)
+ * @param commands Decoded target state per signal
+ * @param channelMask Signals present in the payload
+ * @return RESP_SUCCESS or the error response code
+ */
+static uint8_t decodeOutputBatch(const uint8_t* data, uint8_t length, OutputCommand* commands, uint8_t* channelMask) {
+    uint8_t mask = (length > 0) ? data[0] : 0;
+    uint8_t entries = 0;
+    for (int i = 0; i < 3; i++) {
+        entries += (mask >> i) & 1;
+    }
+    if (mask == 0 || mask > 0x07 || length != 1 + entries * RS485_BATCH_ENTRY_LENGTH) {
+        Serial.println("RS-485: Invalid batch command length or channel mask");
+        return RESP_INVALID_PARAMETER;
+    }
+    if (isModbusModeActive()) {
+        Serial.println("RS-485: Batch command refused in Modbus mode");
+        return RESP_ERROR;
+    }
+
+    const uint8_t* entry = &data[1];
+    for (int i = 0; i < 3; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+        OutputCommand& command = commands[i];
+        command.mode = (entry[0] == 1) ? 'c' : 'v';
+        command.sine = false;
+        command.setpoint = ((entry[1] << 8) | entry[2]) / 100.0f;
+        if (entry[0] > 1 || !isOutputCommandValid(command)) {
+            Serial.printf("RS-485: Invalid batch entry for SIG%d\n", i + 1);
+            return RESP_INVALID_PARAMETER;
+        }
+        entry += RS485_BATCH_ENTRY_LENGTH;
+    }
+    *channelMask = mask;
+    return RESP_SUCCESS;
+}
+
+/**
+ * Send the compact status unless the command was a broadcast
+ * (every module would reply at once)
+ */
+static void sendCompactStatus(uint8_t result) {
+    if (getLastCommand()->deviceID != 0xFF) {
+        uint8_t status[RS485_COMPACT_STATUS_LENGTH];
+        sendDataResponse(status, buildCompactStatus(result, status));
+    }
+}
+
+/**
+ * Handle batch output command
+ * @param data Command data
+ * @param length Data length
+ * @return true if successful
+ */
+bool handleSetOutputsCommand(const uint8_t* data, uint8_t length) {
+    OutputCommand commands[3];
+    uint8_t channelMask = 0;
+    uint8_t result = decodeOutputBatch(data, length, commands, &channelMask);
+    if (result == RESP_SUCCESS) {
+        if (applyOutputCommands(commands, channelMask)) {
+            Serial.printf("RS-485: Batch applied to signal mask 0x%02X\n", channelMask);
+        } else {
+            result = RESP_ERROR;
+        }
+    }
+    sendCompactStatus(result);
+    return result == RESP_SUCCESS;
+}
+
+/**
+ * Handle stage command
+ * @param data Command data
+ * @param length Data length
+ * @return true if successful
+ */
+bool handleStageOutputsCommand(const uint8_t* data, uint8_t length) {
+    OutputCommand commands[3];
+    uint8_t channelMask = 0;
+    uint8_t result = decodeOutputBatch(data, length, commands, &channelMask);
+    if (result == RESP_SUCCESS) {
+        for (int i = 0; i < 3; i++) {
+            if (channelMask & (1 << i)) {
+                stagedCommands[i] = commands[i];
+            }
+        }
+        stagedMask |= channelMask;
+        Serial.printf("RS-485: Staged signal mask 0x%02X (pending 0x%02X)\n", channelMask, stagedMask);
+    }
+    sendCompactStatus(result);
+    return result == RESP_SUCCESS;
+}
+
+/**
+ * Handle latch command
+ * The commit tick is counted from the receive event of the latch frame, so every
+ * module picks the same tick however long its loop() took to decode the frame.
+ * @param data Command data
+ * @param length Data length
+ * @param rxTick Sample tick of the receive event that completed the latch frame
+ * @return true if successful
+ */
+bool handleLatchOutputsCommand(const uint8_t* data, uint8_t length, uint32_t rxTick) {
+    uint8_t result = RESP_SUCCESS;
+    if (length != 0) {
+        result = RESP_INVALID_PARAMETER;
+    } else if (stagedMask == 0 || isModbusModeActive()) {
+        result = RESP_ERROR;
+    } else {
+        uint32_t delayTicks = (uint32_t)ceilf(RS485_LATCH_DELAY_MS * getSampleClockRate() / 1000.0f);
+        if (delayTicks == 0) {
+            delayTicks = 1;
+        }
+        uint32_t tick = rxTick + delayTicks;
+        if (applyOutputCommandsAtTick(stagedCommands, stagedMask, tick)) {
+            int32_t margin = (int32_t)(tick - getSampleTick()); // <= 0: posted on the next tick instead
+            Serial.printf("RS-485: Latched signal mask 0x%02X at tick %lu (%ld ticks ahead%s)\n",
+                          stagedMask, (unsigned long)tick, (long)margin,
+                          (margin <= 0) ? ", late" : "");
+        } else {
+            result = RESP_ERROR;
+        }
+        stagedMask = 0;
+    }
+    sendCompactStatus(result);
+    return result == RESP_SUCCESS;
+}
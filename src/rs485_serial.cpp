@@ -1,24 +1,134 @@
 #include "rs485_serial.h"
 #include "device_id.h"
+#include "sample_output.h"
 
 // Global variables
 static uint8_t currentDeviceID = 0;
 static uint8_t rs485Buffer[RS485_BUFFER_SIZE];
 static uint8_t bufferIndex = 0;
 static RS485Command lastCommand;
+static uint8_t framing = RS485_DEFAULT_FRAMING;
+static RS485LinkStats linkStats;
+
+// Receive ring: written only by the UART event (rxHead), read only by the decoder (rxTail).
+// Indices run freely and are masked on access; volatile accesses are ordered on the ESP32.
+static uint8_t rxRing[RS485_RX_RING_SIZE];
+static volatile uint32_t rxHead = 0;
+static volatile uint32_t rxTail = 0;
+static volatile uint32_t rxEventTick = 0;   // Sample tick of the last receive event
+static_assert((RS485_RX_RING_SIZE & (RS485_RX_RING_SIZE - 1)) == 0, "RS485_RX_RING_SIZE must be a power of two");
+
+// Receive event ring, same producer and consumer: ring position each event filled up to
+// and its sample tick. An entry is published before the bytes it covers.
+struct RS485RxEvent {
+    uint32_t head;    // rxHead after the event's bytes
+    uint32_t tick;    // Sample tick of the event
+};
+static RS485RxEvent rxEvents[RS485_RX_EVENT_SLOTS];
+static volatile uint32_t rxEventHead = 0;
+static volatile uint32_t rxEventTail = 0;
+static_assert((RS485_RX_EVENT_SLOTS & (RS485_RX_EVENT_SLOTS - 1)) == 0, "RS485_RX_EVENT_SLOTS must be a power of two");
+
+// CRC frame decoder state
+enum RS485RxState {
+    RX_WAIT_START,   // Hunting for 0x7E
+    RX_LENGTH,       // Next byte is LEN
+    RX_BODY,         // DEVICE_ID, COMMAND, DATA into rs485Buffer
+    RX_CRC_LOW,
+    RX_CRC_HIGH
+};
+static RS485RxState rxState = RX_WAIT_START;
+static bool rxEscape = false;
+static uint8_t rxLength = 0;
+static uint16_t rxCrc = 0xFFFF;
 
 // Forward declaration
 bool processCommand();
 
 // HardwareSerial instance for RS-485 interface
-HardwareSerial RS485Serial(RS485_SERIAL_NUM);  // Serial1 for work mode (receiving external RS-485 signals)
+HardwareSerial RS485Serial(RS485_SERIAL_NUM);  // UART2 for work mode (receiving external RS-485 signals)
+
+/**
+ * Continue a CRC16 (Modbus polynomial) over one byte
+ */
+static uint16_t crc16Update(uint16_t crc, uint8_t byte) {
+    crc ^= byte;
+    for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+    return crc;
+}
+
+/**
+ * UART receive event: move everything the driver holds into the ring (producer side)
+ */
+static void onRS485Receive() {
+    uint32_t tick = getSampleTick();
+    rxEventTick = tick;
+    int available;
+    while ((available = RS485Serial.available()) > 0) {
+        uint32_t head = rxHead;
+        uint32_t fill = head - rxTail;
+        uint32_t space = RS485_RX_RING_SIZE - fill;
+        if (space == 0) {
+            // Ring full: drop what is left, the decoder rejects the cut frame
+            while (RS485Serial.available() > 0) {
+                RS485Serial.read();
+                linkStats.ringOverruns++;
+            }
+            break;
+        }
+        uint32_t offset = head & (RS485_RX_RING_SIZE - 1);
+        uint32_t chunk = RS485_RX_RING_SIZE - offset; // Contiguous part up to the wrap
+        if (chunk > space) chunk = space;
+        if (chunk > (uint32_t)available) chunk = available;
+        size_t count = RS485Serial.read(&rxRing[offset], chunk);
+        uint32_t eventHead = rxEventHead;
+        if (eventHead - rxEventTail < RS485_RX_EVENT_SLOTS) {
+            // When full, the bytes are timed by the next event that fits (slightly late)
+            rxEvents[eventHead & (RS485_RX_EVENT_SLOTS - 1)].head = head + count;
+            rxEvents[eventHead & (RS485_RX_EVENT_SLOTS - 1)].tick = tick;
+            rxEventHead = eventHead + 1;
+        }
+        rxHead = head + count; // Publish only after the bytes are in place
+        if (fill + count > linkStats.ringHighWater) {
+            linkStats.ringHighWater = fill + count;
+        }
+    }
+}
+
+/**
+ * UART error event: count overflows and line errors
+ */
+static void onRS485ReceiveError(hardwareSerial_error_t error) {
+    switch (error) {
+        case UART_BUFFER_FULL_ERROR:
+        case UART_FIFO_OVF_ERROR:
+            linkStats.uartOverruns++;
+            break;
+        case UART_BREAK_ERROR:
+        case UART_FRAME_ERROR:
+        case UART_PARITY_ERROR:
+            linkStats.lineErrors++;
+            break;
+        default:
+            break;
+    }
+}
 
 /**
  * Initialize RS-485 serial communication
  */
 void initRS485Serial() {
     // Initialize work mode RS-485 serial (receiving external RS-485 signals)
+    RS485Serial.setRxBufferSize(RS485_UART_RX_BUFFER);
+    RS485Serial.setTxBufferSize(RS485_UART_TX_BUFFER);
     RS485Serial.begin(RS485_BAUDRATE, RS485_PARITY, RS485_RX_PIN, RS485_TX_PIN);
+    if (RS485_DE_PIN >= 0) {
+        // DE/RE on the UART's RTS output, switched by the driver around each transmission
+        RS485Serial.setPins(-1, -1, -1, RS485_DE_PIN);
+        RS485Serial.setMode(UART_MODE_RS485_HALF_DUPLEX);
+    }
     
     // Get device ID from hardware jumpers
     initDeviceIDPins();
@@ -28,64 +138,79 @@ void initRS485Serial() {
     memset(rs485Buffer, 0, RS485_BUFFER_SIZE);
     bufferIndex = 0;
     lastCommand.valid = false;
+    rxState = RX_WAIT_START;
+    memset(&linkStats, 0, sizeof(linkStats));
+    rxHead = 0;
+    rxTail = 0;
+    rxEventHead = 0;
+    rxEventTail = 0;
     
-    Serial.printf("Work Mode RS-485: GPIO %d(TX), %d(RX)\n", RS485_TX_PIN, RS485_RX_PIN);
-    Serial.printf("Device ID: %d, Baud Rate: %d\n", currentDeviceID, RS485_BAUDRATE);
+    // Receive on FIFO threshold and RX timeout; errors are only counted
+    RS485Serial.onReceiveError(onRS485ReceiveError);
+    RS485Serial.onReceive(onRS485Receive, false);
+    
+    Serial.printf("Work Mode RS-485: UART%d, GPIO %d(TX), %d(RX)\n", RS485_SERIAL_NUM, RS485_TX_PIN, RS485_RX_PIN);
+    Serial.printf("Device ID: %d, Baud Rate: %d, Framing: %s\n", currentDeviceID, RS485_BAUDRATE,
+                  (framing == RS485_FRAMING_CRC) ? "CRC" : "legacy");
 }
 
 /**
- * Process incoming RS-485 commands from work mode interface
- * @return true if a valid command was received
+ * Select the frame format for receiving and sending
+ * @param mode RS485_FRAMING_CRC or RS485_FRAMING_LEGACY
  */
-bool processRS485Commands() {
-    bool commandReceived = false;
+void setRS485Framing(uint8_t mode) {
+    framing = (mode == RS485_FRAMING_LEGACY) ? RS485_FRAMING_LEGACY : RS485_FRAMING_CRC;
+    bufferIndex = 0;
+    rxState = RX_WAIT_START;
+    Serial.printf("RS-485 framing: %s\n", (framing == RS485_FRAMING_CRC) ? "CRC" : "legacy");
+}
+
+/**
+ * Get the frame format in use
+ */
+uint8_t getRS485Framing() {
+    return framing;
+}
+
+/**
+ * Feed one byte to the legacy decoder
+ * @return true if a command for this device was completed
+ */
+static bool feedLegacyByte(uint8_t byte) {
+    // Simple command protocol: [START][DEVICE_ID][COMMAND][DATA...][END]
+    // START = 0xAA, END = 0x55
     
-    while (RS485Serial.available()) {
-        uint8_t byte = RS485Serial.read();
+    if (byte == 0xAA) {
+        // Start of new command
+        bufferIndex = 0;
+        rs485Buffer[bufferIndex++] = byte;
+    } else if (bufferIndex > 0 && bufferIndex < RS485_BUFFER_SIZE - 1) {
+        // Add byte to buffer
+        rs485Buffer[bufferIndex++] = byte;
         
-        // Simple command protocol: [START][DEVICE_ID][COMMAND][DATA...][END]
-        // START = 0xAA, END = 0x55
-        
-        if (byte == 0xAA) {
-            // Start of new command
-            bufferIndex = 0;
-            rs485Buffer[bufferIndex++] = byte;
-        } else if (bufferIndex > 0 && bufferIndex < RS485_BUFFER_SIZE - 1) {
-            // Add byte to buffer
-            rs485Buffer[bufferIndex++] = byte;
-            
-            // Check for end of command
-            if (byte == 0x55 && bufferIndex >= 4) {
-                // Process complete command
-                if (processCommand()) {
-                    commandReceived = true;
-                }
-                bufferIndex = 0; // Reset for next command
-            }
-        } else {
-            // Invalid state, reset
-            bufferIndex = 0;
+        // Check for end of command
+        if (byte == 0x55 && bufferIndex >= 4) {
+            // Process complete command
+            bool accepted = processCommand();
+            bufferIndex = 0; // Reset for next command
+            return accepted;
         }
+    } else {
+        // Invalid state, reset
+        bufferIndex = 0;
     }
-    
-    return commandReceived;
+    return false;
 }
 
 /**
- * Process a complete command from buffer
- * @return true if command is valid and for this device
+ * Store a decoded command if it is addressed to this device
+ * @param body DEVICE_ID, COMMAND and DATA
+ * @param length Body length (at least 2)
+ * @return true if command is for this device
  */
-bool processCommand() {
-    if (bufferIndex < 4) return false; // Minimum command length
-    
-    // Check start and end bytes
-    if (rs485Buffer[0] != 0xAA || rs485Buffer[bufferIndex - 1] != 0x55) {
-        return false;
-    }
-    
-    // Extract device ID and command type
-    uint8_t targetDeviceID = rs485Buffer[1];
-    uint8_t commandType = rs485Buffer[2];
+static bool acceptCommand(const uint8_t* body, uint8_t length) {
+    uint8_t targetDeviceID = body[0];
+    uint8_t commandType = body[1];
     
     // Check if command is for this device (0xFF = broadcast)
     if (targetDeviceID != currentDeviceID && targetDeviceID != 0xFF) {
@@ -95,11 +220,11 @@ bool processCommand() {
     // Store command
     lastCommand.deviceID = targetDeviceID;
     lastCommand.commandType = commandType;
-    lastCommand.length = bufferIndex - 4; // Exclude start, device ID, command, end
+    lastCommand.length = length - 2; // Exclude device ID and command
     
     // Copy data
-    if (lastCommand.length > 0 && lastCommand.length < RS485_MAX_COMMAND_LENGTH - 2) {
-        memcpy(lastCommand.data, &rs485Buffer[3], lastCommand.length);
+    if (lastCommand.length > 0 && lastCommand.length <= RS485_MAX_COMMAND_LENGTH - 2) {
+        memcpy(lastCommand.data, &body[2], lastCommand.length);
     }
     
     lastCommand.valid = true;
@@ -110,6 +235,172 @@ bool processCommand() {
     return true;
 }
 
+/**
+ * Feed one byte to the CRC frame decoder
+ * Unstuffing, length and CRC are handled here as each byte arrives, so a frame is
+ * complete and checked when its last CRC byte is received.
+ * @return true if a command for this device was completed
+ */
+static bool feedCrcFrameByte(uint8_t byte) {
+    if (byte == RS485_FRAME_START) {
+        if (rxState != RX_WAIT_START) {
+            linkStats.frameErrors++; // Previous frame cut short
+        }
+        rxState = RX_LENGTH;
+        rxEscape = false;
+        rxCrc = 0xFFFF;
+        bufferIndex = 0;
+        return false;
+    }
+    if (rxState == RX_WAIT_START) {
+        return false;
+    }
+    if (byte == RS485_FRAME_ESCAPE) {
+        if (rxEscape) {
+            linkStats.frameErrors++;
+            rxState = RX_WAIT_START;
+            return false;
+        }
+        rxEscape = true;
+        return false;
+    }
+    if (rxEscape) {
+        byte ^= RS485_FRAME_ESCAPE_XOR;
+        rxEscape = false;
+    }
+
+    switch (rxState) {
+        case RX_LENGTH:
+            if (byte < 2 || byte > RS485_MAX_COMMAND_LENGTH) {
+                linkStats.frameErrors++;
+                rxState = RX_WAIT_START;
+                return false;
+            }
+            rxLength = byte;
+            rxCrc = crc16Update(rxCrc, byte);
+            rxState = RX_BODY;
+            return false;
+
+        case RX_BODY:
+            rs485Buffer[bufferIndex++] = byte;
+            rxCrc = crc16Update(rxCrc, byte);
+            if (bufferIndex == rxLength) {
+                rxState = RX_CRC_LOW;
+            }
+            return false;
+
+        case RX_CRC_LOW:
+            rxCrc = crc16Update(rxCrc, byte);
+            rxState = RX_CRC_HIGH;
+            return false;
+
+        case RX_CRC_HIGH:
+            rxCrc = crc16Update(rxCrc, byte);
+            rxState = RX_WAIT_START;
+            if (rxCrc != 0) {
+                // Running CRC over data plus its own CRC is 0 for an intact frame
+                linkStats.crcErrors++;
+                return false;
+            }
+            linkStats.frames++;
+            return acceptCommand(rs485Buffer, rxLength);
+
+        default:
+            rxState = RX_WAIT_START;
+            return false;
+    }
+}
+
+/**
+ * Sample tick of the receive event that delivered the byte before a ring position
+ * Events that end before the position are released; later frames end after it.
+ */
+static uint32_t frameEventTick(uint32_t frameEnd) {
+    uint32_t eventTail = rxEventTail;
+    uint32_t eventHead = rxEventHead;
+    while (eventTail != eventHead) {
+        const RS485RxEvent& event = rxEvents[eventTail & (RS485_RX_EVENT_SLOTS - 1)];
+        if ((int32_t)(event.head - frameEnd) >= 0) {
+            uint32_t tick = event.tick;
+            rxEventTail = eventTail;
+            return tick;
+        }
+        eventTail++;
+    }
+    rxEventTail = eventTail;
+    return rxEventTick; // Event not recorded (slots were full): the running one is the closest
+}
+
+/**
+ * Release the receive events whose bytes have all been decoded
+ */
+static void releaseRxEvents(uint32_t consumed) {
+    uint32_t eventTail = rxEventTail;
+    uint32_t eventHead = rxEventHead;
+    while (eventTail != eventHead &&
+           (int32_t)(rxEvents[eventTail & (RS485_RX_EVENT_SLOTS - 1)].head - consumed) <= 0) {
+        eventTail++;
+    }
+    rxEventTail = eventTail;
+}
+
+/**
+ * Process incoming RS-485 commands from work mode interface
+ * @return true if a valid command was received
+ */
+bool processRS485Commands() {
+    uint32_t tail = rxTail;
+    uint32_t head = rxHead;
+    while (tail != head) {
+        uint8_t byte = rxRing[tail & (RS485_RX_RING_SIZE - 1)];
+        tail++;
+        bool commandReceived = (framing == RS485_FRAMING_CRC) ? feedCrcFrameByte(byte)
+                                                              : feedLegacyByte(byte);
+        if (commandReceived) {
+            lastCommand.rxTick = frameEventTick(tail);
+            rxTail = tail;
+            return true; // One command per call, lastCommand must not be overwritten
+        }
+    }
+    releaseRxEvents(tail);
+    rxTail = tail; // Release the consumed bytes to the producer
+    
+    return false;
+}
+
+/**
+ * Process a complete legacy command from buffer
+ * @return true if command is valid and for this device
+ */
+bool processCommand() {
+    if (bufferIndex < 4) return false; // Minimum command length
+    
+    // Check start and end bytes
+    if (rs485Buffer[0] != 0xAA || rs485Buffer[bufferIndex - 1] != 0x55) {
+        return false;
+    }
+    linkStats.frames++;
+    if (bufferIndex - 2 > RS485_MAX_COMMAND_LENGTH) {
+        linkStats.frameErrors++;
+        return false;
+    }
+    
+    // Exclude start and end bytes
+    return acceptCommand(&rs485Buffer[1], bufferIndex - 2);
+}
+
+/**
+ * Append a byte to a CRC frame, escaping start and escape bytes
+ */
+static uint8_t stuffByte(uint8_t* frame, uint8_t index, uint8_t byte) {
+    if (byte == RS485_FRAME_START || byte == RS485_FRAME_ESCAPE) {
+        frame[index++] = RS485_FRAME_ESCAPE;
+        byte ^= RS485_FRAME_ESCAPE_XOR;
+    }
+    frame[index++] = byte;
+    return index;
+}
+
 /**
  * Send response via RS-485 work mode interface
  * @param deviceID Target device ID
@@ -122,18 +413,88 @@ void sendRS485Response(uint8_t deviceID, uint8_t commandType, const uint8_t* dat
         Serial.println("RS-485: Response too long");
         return;
     }
-    // Send response: [START][DEVICE_ID][COMMAND][DATA...][END]
-    RS485Serial.write(0xAA); // Start byte
-    RS485Serial.write(deviceID);
-    RS485Serial.write(commandType);
-    if (length > 0 && data != nullptr) {
-        RS485Serial.write(data, length);
+    if (data == nullptr) {
+        length = 0;
     }
-    RS485Serial.write(0x55); // End byte
-    RS485Serial.flush(); // Ensure all data is sent
+
+    uint8_t frame[RS485_MAX_FRAME_LENGTH];
+    uint8_t index = 0;
+    if (framing == RS485_FRAMING_CRC) {
+        // [START][LEN][DEVICE_ID][COMMAND][DATA...][CRC_LO][CRC_HI], stuffed
+        uint8_t bodyLength = length + 2;
+        uint16_t crc = crc16Update(0xFFFF, bodyLength);
+        crc = crc16Update(crc, deviceID);
+        crc = crc16Update(crc, commandType);
+        frame[index++] = RS485_FRAME_START;
+        index = stuffByte(frame, index, bodyLength);
+        index = stuffByte(frame, index, deviceID);
+        index = stuffByte(frame, index, commandType);
+        for (uint8_t i = 0; i < length; i++) {
+            crc = crc16Update(crc, data[i]);
+            index = stuffByte(frame, index, data[i]);
+        }
+        index = stuffByte(frame, index, crc & 0xFF);
+        index = stuffByte(frame, index, crc >> 8);
+    } else {
+        // Send response: [START][DEVICE_ID][COMMAND][DATA...][END]
+        frame[index++] = 0xAA; // Start byte
+        frame[index++] = deviceID;
+        frame[index++] = commandType;
+        if (length > 0) {
+            memcpy(&frame[index], data, length);
+            index += length;
+        }
+        frame[index++] = 0x55; // End byte
+    }
+    if (RS485Serial.availableForWrite() < index) {
+        // Never wait for the line: a master that floods us loses responses, not our loop
+        linkStats.txDropped++;
+        Serial.println("RS-485: TX buffer full, response dropped");
+        return;
+    }
+    RS485Serial.write(frame, index); // Copied into the driver, sent by the UART
+    linkStats.txFrames++;
     Serial.printf("Work Mode RS-485 Response sent: Device=%d, Type=0x%02X, Length=%d\n", deviceID, commandType, length);
 }
 
+/**
+ * Get receive counters
+ */
+RS485LinkStats getRS485LinkStats() {
+    return linkStats;
+}
+
+/**
+ * Clear receive counters
+ */
+void clearRS485LinkStats() {
+    memset(&linkStats, 0, sizeof(linkStats));
+    linkStats.ringHighWater = rxHead - rxTail;
+}
+
+/**
+ * Print frame format and receive counters
+ */
+void printRS485LinkStatus() {
+    Serial.println("=== WORK MODE RS-485 ===");
+    Serial.printf("Framing: %s, device ID: %d\n",
+                  (framing == RS485_FRAMING_CRC) ? "CRC (length + CRC16 + byte stuffing)" : "legacy (0xAA ... 0x55)",
+                  currentDeviceID);
+    Serial.printf("Frames: %lu, CRC errors: %lu, frame errors: %lu\n",
+                  (unsigned long)linkStats.frames, (unsigned long)linkStats.crcErrors,
+                  (unsigned long)linkStats.frameErrors);
+    Serial.printf("Dropped: %lu bytes ring full, %lu UART overflows; line errors: %lu\n",
+                  (unsigned long)linkStats.ringOverruns, (unsigned long)linkStats.uartOverruns,
+                  (unsigned long)linkStats.lineErrors);
+    Serial.printf("Receive ring: %lu of %d bytes used, high-water %lu\n",
+                  (unsigned long)(rxHead - rxTail), RS485_RX_RING_SIZE,
+                  (unsigned long)linkStats.ringHighWater);
+    Serial.printf("Transmit: %lu frames, %lu dropped (TX buffer full), direction: %s\n",
+                  (unsigned long)linkStats.txFrames, (unsigned long)linkStats.txDropped,
+                  (RS485_DE_PIN >= 0) ? "UART RTS (half-duplex mode)" : "auto (transceiver)");
+    Serial.println("========================");
+}
+
 /**
  * Get the last received command
  * @return Pointer to the last received command
@@ -147,7 +508,7 @@ RS485Command* getLastCommand() {
  * @return true if data is available
  */
 bool isRS485Available() {
-    return RS485Serial.available() > 0;
+    return rxHead != rxTail;
 }
 
 /**
@@ -0,0 +1,114 @@
+#include "sample_clock.h"
+
+static hw_timer_t* sampleTimer = nullptr;
+static TaskHandle_t sampleTaskHandle = nullptr;
+static SampleTickCallback sampleCallback = nullptr;
+static SampleScheduler sampleScheduler;
+static portMUX_TYPE sampleClockMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Timer ISR: only wakes the sample task, all work happens in task context
+ */
+static void IRAM_ATTR onSampleTimer() {
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(sampleTaskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * Sample task: waits for timer notifications and runs the tick callback
+ */
+static void sampleTask(void* param) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        portENTER_CRITICAL(&sampleClockMux);
+        uint32_t ticks = sampleSchedulerPoll(&sampleScheduler, micros());
+        portEXIT_CRITICAL(&sampleClockMux);
+
+        if (ticks > 0 && sampleCallback) {
+            sampleCallback(ticks);
+        }
+    }
+}
+
+/**
+ * Initialize sample clock timer and task
+ */
+void initSampleClock(SampleTickCallback callback) {
+    sampleCallback = callback;
+    sampleSchedulerReset(&sampleScheduler, 1000000UL / SAMPLE_CLOCK_DEFAULT_HZ, micros());
+
+    xTaskCreatePinnedToCore(sampleTask, "sample_clock", SAMPLE_CLOCK_TASK_STACK, nullptr,
+                            SAMPLE_CLOCK_TASK_PRIORITY, &sampleTaskHandle, SAMPLE_CLOCK_TASK_CORE);
+
+    // 80 MHz APB clock / 80 = 1 MHz timer tick (1 us resolution)
+    sampleTimer = timerBegin(SAMPLE_CLOCK_TIMER_NUM, 80, true);
+    timerAttachInterrupt(sampleTimer, &onSampleTimer, true);
+    timerAlarmWrite(sampleTimer, sampleScheduler.periodUs, true);
+    timerWrite(sampleTimer, 0);
+    timerAlarmEnable(sampleTimer);
+
+    Serial.printf("Sample clock initialized: %d Hz (hardware timer %d)\n",
+                  SAMPLE_CLOCK_DEFAULT_HZ, SAMPLE_CLOCK_TIMER_NUM);
+}
+
+/**
+ * Change sample rate
+ */
+bool setSampleClockRate(uint32_t rateHz) {
+    if (rateHz < SAMPLE_CLOCK_MIN_HZ || rateHz > SAMPLE_CLOCK_MAX_HZ) {
+        Serial.printf("Invalid sample rate. Use %d-%d Hz.\n", SAMPLE_CLOCK_MIN_HZ, SAMPLE_CLOCK_MAX_HZ);
+        return false;
+    }
+
+    uint32_t periodUs = 1000000UL / rateHz;
+
+    // Restart timer, then deadlines from the same moment so they stay in phase (the
+    // scheduler tolerates the few microseconds between them). The timer driver takes
+    // its own lock, so it is called outside the spinlock.
+    if (sampleTimer) {
+        timerAlarmWrite(sampleTimer, periodUs, true);
+        timerWrite(sampleTimer, 0);
+    }
+    uint32_t nowUs = micros();
+    portENTER_CRITICAL(&sampleClockMux);
+    sampleSchedulerReset(&sampleScheduler, periodUs, nowUs);
+    portEXIT_CRITICAL(&sampleClockMux);
+    return true;
+}
+
+/**
+ * Get effective sample rate
+ */
+float getSampleClockRate() {
+    return 1000000.0f / sampleScheduler.periodUs;
+}
+
+/**
+ * Get sample period in microseconds
+ */
+uint32_t getSampleClockPeriodUs() {
+    return sampleScheduler.periodUs;
+}
+
+/**
+ * Get scheduler statistics
+ */
+SampleScheduler getSampleClockStats() {
+    portENTER_CRITICAL(&sampleClockMux);
+    SampleScheduler copy = sampleScheduler;
+    portEXIT_CRITICAL(&sampleClockMux);
+    return copy;
+}
+
+/**
+ * Clear jitter statistics
+ */
+void clearSampleClockStats() {
+    portENTER_CRITICAL(&sampleClockMux);
+    sampleSchedulerClearStats(&sampleScheduler);
+    portEXIT_CRITICAL(&sampleClockMux);
+}
@@ -0,0 +1,109 @@
+#include "sample_output.h"
+#include "sample_clock.h"
+#include "dac_controller.h"
+#include "dac_output_queue.h"
+#include "sine_wave_generator.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "output_stage.h"
+
+// Shared time base: advanced once per tick before any source renders
+static volatile uint32_t sampleTick = 0;
+
+// Codes waiting for their tick (deferred latch), pending masks mark the channels
+static DacFrame scheduledFrame;
+static uint32_t scheduledTick[3];
+static portMUX_TYPE scheduledMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Start the sample clock with the output pipeline as its tick handler
+ */
+void initSampleOutput() {
+    dacFrameClear(&scheduledFrame);
+    initSampleClock(onSampleTick);
+}
+
+/**
+ * Get the shared sample tick counter
+ */
+uint32_t getSampleTick() {
+    return sampleTick;
+}
+
+/**
+ * Post codes together with a given sample tick
+ * Merged per channel: a channel in the new frame replaces its earlier scheduled code,
+ * other channels keep theirs.
+ */
+void scheduleSampleFrame(const DacFrame* frame, uint32_t tick) {
+    portENTER_CRITICAL(&scheduledMux);
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        uint8_t bit = 1 << ch;
+        if (!((frame->voltagePending | frame->currentPending) & bit)) {
+            continue;
+        }
+        scheduledFrame.voltagePending &= ~bit;
+        scheduledFrame.currentPending &= ~bit;
+        if (frame->voltagePending & bit) {
+            dacFrameSetVoltageCode(&scheduledFrame, ch, frame->voltageCode[ch]);
+        }
+        if (frame->currentPending & bit) {
+            dacFrameSetCurrentCode(&scheduledFrame, ch, frame->currentCode[ch]);
+        }
+        scheduledTick[ch] = tick;
+    }
+    portEXIT_CRITICAL(&scheduledMux);
+}
+
+/**
+ * Drop a channel's scheduled codes
+ */
+void cancelScheduledChannel(uint8_t channel) {
+    if (channel >= 3) return;
+    portENTER_CRITICAL(&scheduledMux);
+    scheduledFrame.voltagePending &= ~(1 << channel);
+    scheduledFrame.currentPending &= ~(1 << channel);
+    portEXIT_CRITICAL(&scheduledMux);
+}
+
+/**
+ * Render all signal sources for one sample tick and post the frame
+ * A channel is owned by at most one source at a time, so render order does not matter.
+ */
+void onSampleTick(uint32_t ticks) {
+    sampleTick += ticks;
+
+    DacFrame frame;
+    dacFrameClear(&frame);
+
+    renderSineWave(&frame, ticks);
+    renderWaveformPlayback(&frame, ticks);
+    renderProfiles(&frame, ticks);
+
+    // Slew limit and smoothing between all producers and the DAC
+    applyOutputStage(&frame, ticks);
+
+    // Scheduled codes are final values: merged after the stage, they override this tick's codes
+    portENTER_CRITICAL(&scheduledMux);
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        uint8_t bit = 1 << ch;
+        if (!((scheduledFrame.voltagePending | scheduledFrame.currentPending) & bit) ||
+            (int32_t)(sampleTick - scheduledTick[ch]) < 0) {
+            continue;
+        }
+        if (scheduledFrame.voltagePending & bit) {
+            dacFrameSetVoltageCode(&frame, ch, scheduledFrame.voltageCode[ch]);
+        }
+        if (scheduledFrame.currentPending & bit) {
+            dacFrameSetCurrentCode(&frame, ch, scheduledFrame.currentCode[ch]);
+        }
+        scheduledFrame.voltagePending &= ~bit;
+        scheduledFrame.currentPending &= ~bit;
+    }
+    portEXIT_CRITICAL(&scheduledMux);
+
+    // All channels of this tick are posted together (SIG1/SIG2 voltage share one transaction)
+    if (frame.voltagePending || frame.currentPending) {
+        postDacFrame(&frame);
+    }
+}
@@ -0,0 +1,56 @@
+#include "sample_scheduler.h"
+
+/**
+ * Reset scheduler with a new period, first tick due one period after nowUs
+ */
+void sampleSchedulerReset(SampleScheduler* scheduler, uint32_t periodUs, uint32_t nowUs) {
+    if (periodUs == 0) {
+        periodUs = 1;
+    }
+    scheduler->periodUs = periodUs;
+    scheduler->nextDeadlineUs = nowUs + periodUs;
+    scheduler->tickCount = 0;
+    sampleSchedulerClearStats(scheduler);
+}
+
+/**
+ * Check how many ticks are due at nowUs and advance the deadline past them
+ * Deadlines advance by whole periods, so timer jitter never accumulates into drift.
+ * A wake-up up to half a period early still counts as the tick (timer and time
+ * source are separate peripherals and may disagree by a few microseconds).
+ * Lateness is measured from the oldest due deadline, so a batch of missed ticks
+ * reports the whole delay, not just the part beyond whole periods.
+ */
+uint32_t sampleSchedulerPoll(SampleScheduler* scheduler, uint32_t nowUs) {
+    int32_t offset = (int32_t)(nowUs - scheduler->nextDeadlineUs);
+    if (offset < -(int32_t)(scheduler->periodUs / 2)) {
+        return 0; // Spurious early wake, nothing due yet
+    }
+
+    uint32_t due = 1;
+    uint32_t jitter;
+    if (offset >= 0) {
+        due += (uint32_t)offset / scheduler->periodUs;
+        jitter = (uint32_t)offset;
+    } else {
+        jitter = (uint32_t)(-offset);
+    }
+
+    scheduler->nextDeadlineUs += due * scheduler->periodUs;
+    scheduler->tickCount += due;
+    scheduler->missedTicks += due - 1;
+    scheduler->lastLatenessUs = jitter;
+    if (jitter > scheduler->maxLatenessUs) {
+        scheduler->maxLatenessUs = jitter;
+    }
+    return due;
+}
+
+/**
+ * Clear jitter statistics
+ */
+void sampleSchedulerClearStats(SampleScheduler* scheduler) {
+    scheduler->missedTicks = 0;
+    scheduler->lastLatenessUs = 0;
+    scheduler->maxLatenessUs = 0;
+}
@@ -2,18 +2,44 @@
 #include "dac_controller.h"
 #include "relay_controller.h"
 #include "utils.h"
+#include "dds_engine.h"
+#include "sample_clock.h"
+#include "dac_output_queue.h"
+#include "dac_codes.h"
+#include "waveform_player.h"
+#include "profile_sequencer.h"
+#include "sample_output.h"
+
+static_assert(DDS_CODE_MAX == GP8413VoltageCodec::kMaxCode && DDS_CODE_MAX == GP8313CurrentCodec::kMaxCode,
+              "DDS output range must match DAC code range");
 
 // Global variables for sine wave generation
 bool sineWaveActive[3] = {false, false, false}; // Per-channel sine wave status
-unsigned long lastUpdateTime = 0;
-const unsigned long UPDATE_INTERVAL = 250; // 0.25 seconds in milliseconds
+
+// Serializes channel configuration (loop) against sample output (sample clock task)
+static SemaphoreHandle_t sineMutex = nullptr;
 
 // Sine wave parameters per channel
 float sineAmplitude[3] = {5.0, 5.0, 5.0};    // Default amplitude per channel
 float sinePeriod[3] = {1.0, 1.0, 1.0};       // Default period in seconds per channel
 float sineOffset[3] = {5.0, 5.0, 5.0};       // Center point per channel
-unsigned long startTime[3] = {0, 0, 0};       // Start time per channel
+float sinePhase[3] = {0.0, 0.0, 0.0};        // Phase offset in degrees per channel
+uint32_t sineEpoch[3] = {0, 0, 0};            // Sample tick of phase 0 per channel (shared time base)
+bool sineWaveArmed[3] = {false, false, false}; // Configured, waiting for SINE TRIGGER
+
+// Chirp (frequency sweep) settings per channel; sinePeriod holds the start period
+struct SineChirpSettings {
+    float endPeriod;        // Period at sweep end in seconds
+    float sweepSeconds;     // Sweep duration in seconds
+    uint8_t shape;          // DDS_CHIRP_LINEAR or DDS_CHIRP_LOG
+    uint8_t endMode;        // DDS_CHIRP_ONCE, DDS_CHIRP_REPEAT or DDS_CHIRP_BOUNCE
+};
+static bool sineChirpEnabled[3] = {false, false, false};
+static SineChirpSettings sineChirpSettings[3];
+static DDSChirp sineChirp[3];
+static uint32_t sineChirpIndex[3] = {0, 0, 0};   // Next sample index to accumulate (phase in sineDDS)
 char sineWaveMode[3] = {'v', 'v', 'v'};       // Current mode per channel: 'v'=voltage, 'c'=current
+DDSChannel sineDDS[3];                         // Phase accumulator state per channel
 
 // Signal mapping for sine wave output
 extern char signalModes[3];
@@ -25,49 +51,60 @@ SineSignalMap sineSignalMap[3] = {
     {&gp8413_2, 0, &gp8313_3}  // SIG3
 };
 
+/**
+ * Convert engineering value to 15-bit DAC code (no clamping, DDS clamps at output)
+ * @param value: Voltage (V) or current (mA)
+ * @param mode: 'v' for voltage, 'c' for current
+ * @return DAC code
+ */
+static int32_t valueToDacCode(float value, char mode) {
+    int32_t units = (int32_t)lroundf(value * 1000.0f); // mV or uA
+    if (mode == 'v') {
+        return GP8413VoltageCodec::toCodeUnclamped(units);
+    }
+    return GP8313CurrentCodec::toCodeUnclamped(units);
+}
+
 /**
  * Initialize sine wave generator
  */
 void initSineWaveGenerator() {
+    ddsInitTable();
     for (int i = 0; i < 3; i++) {
         sineWaveActive[i] = false;
         sineAmplitude[i] = 5.0;
         sinePeriod[i] = 1.0;
         sineOffset[i] = 5.0;
-        startTime[i] = 0;
+        sinePhase[i] = 0.0;
+        sineEpoch[i] = 0;
+        sineWaveArmed[i] = false;
         sineWaveMode[i] = 'v';
+        ddsConfigure(&sineDDS[i], 0, 0, 0);
     }
-    lastUpdateTime = 0;
+    sineMutex = xSemaphoreCreateMutex();
     Serial.println("Sine Wave Generator initialized (analog mode only)");
 }
 
 /**
- * Start sine wave generation
- * @param amplitude: Peak amplitude
- * @param period: Period in seconds (1-60s)
- * @param center: Center point of the sine wave
- * @param signal: Signal number (1-3)
- * @param mode: 'v' for voltage, 'c' for current
- * @param overshoot: Whether to allow overshoot beyond safe ranges
+ * Validate sine wave parameters (out-of-range output only warns, it is clamped at runtime)
+ * @return true if parameters can be used
  */
-void startSineWave(float amplitude, float period, float center, uint8_t signal, char mode, bool overshoot) {
+static bool validateSineParams(float amplitude, float period, float center, uint8_t signal, char mode) {
     if (signal < 1 || signal > 3) {
         Serial.println("Invalid signal number. Use 1-3.");
-        return;
+        return false;
     }
     
     if (mode != 'v' && mode != 'c') {
         Serial.println("Invalid mode. Use 'v' for voltage or 'c' for current.");
-        return;
+        return false;
     }
     
-    int channel = signal - 1; // Convert to 0-based index
-    
     // Validate amplitude and center point based on mode
     if (mode == 'v') {
         if (amplitude < 0) {
             Serial.println("Invalid voltage amplitude. Use 0 or higher.");
-            return;
+            return false;
         }
         
         // Calculate output range
@@ -84,7 +121,7 @@ void startSineWave(float amplitude, float period, float center, uint8_t signal,
     if (mode == 'c') {
         if (amplitude < 0) {
             Serial.println("Invalid current amplitude. Use 0 or higher.");
-            return;
+            return false;
         }
         
         // Calculate output range
@@ -101,21 +138,93 @@ void startSineWave(float amplitude, float period, float center, uint8_t signal,
     // Validate period
     if (period < 1.0 || period > 60.0) {
         Serial.println("Invalid period. Use 1-60 seconds.");
-        return;
+        return false;
     }
     
+    return true;
+}
+
+/**
+ * Rebuild a channel's chirp for the current sample rate and restart the sweep
+ * (setSineSampleRate() then restores the rescaled position)
+ * Caller holds sineMutex (or the channel is not running).
+ */
+static void buildSineChirp(int channel) {
+    const SineChirpSettings* settings = &sineChirpSettings[channel];
+    float rate = getSampleClockRate();
+    ddsChirpConfigure(&sineChirp[channel],
+                      ddsIncrementForPeriod(sinePeriod[channel], rate),
+                      ddsIncrementForPeriod(settings->endPeriod, rate),
+                      (uint32_t)lroundf(settings->sweepSeconds * rate),
+                      settings->shape, settings->endMode);
+    sineChirpIndex[channel] = 0;
+}
+
+/**
+ * Configure a channel and either start it at the next tick or arm it for a trigger
+ * @param arm: true to arm (idle until triggerSineWaves()), false to start immediately
+ * @return true if channel was configured
+ */
+static bool configureSineChannel(float amplitude, float period, float center, uint8_t signal, char mode,
+                                 float phaseDeg, bool arm, const SineChirpSettings* chirp) {
+    if (!validateSineParams(amplitude, period, center, signal, mode)) {
+        return false;
+    }
+    
+    int channel = signal - 1; // Convert to 0-based index
+    
+    // Take the channel over from waveform playback and profiles
+    releaseWaveformChannel(channel);
+    releaseProfileChannel(channel);
+    
+    // Set signal mode and relay before the first sample
+    signalModes[channel] = mode;
+    setRelayMode(signal, mode);
+    
     // Set parameters for this channel
+    xSemaphoreTake(sineMutex, portMAX_DELAY);
     sineAmplitude[channel] = amplitude;
     sinePeriod[channel] = period;
     sineOffset[channel] = center;
+    sinePhase[channel] = phaseDeg;
     sineWaveMode[channel] = mode;
-    startTime[channel] = millis();
-    sineWaveActive[channel] = true;
-    lastUpdateTime = 0;
-    
-    // Set signal mode and relay
-    signalModes[signal - 1] = mode;
-    setRelayMode(signal, mode);
+    ddsConfigure(&sineDDS[channel],
+                 valueToDacCode(center, mode),
+                 valueToDacCode(amplitude, mode),
+                 ddsIncrementForPeriod(period, getSampleClockRate()));
+    sineDDS[channel].phase = ddsPhaseFromDegrees(phaseDeg);
+    sineChirpEnabled[channel] = (chirp != nullptr);
+    if (chirp) {
+        sineChirpSettings[channel] = *chirp;
+        buildSineChirp(channel);
+    }
+    if (arm) {
+        sineWaveActive[channel] = false;
+        sineWaveArmed[channel] = true;
+    } else {
+        sineEpoch[channel] = getSampleTick() + 1; // Next tick is sample 0
+        sineWaveArmed[channel] = false;
+        sineWaveActive[channel] = true;
+    }
+    xSemaphoreGive(sineMutex);
+    return true;
+}
+
+/**
+ * Start sine wave generation
+ * @param amplitude: Peak amplitude
+ * @param period: Period in seconds (1-60s)
+ * @param center: Center point of the sine wave
+ * @param signal: Signal number (1-3)
+ * @param mode: 'v' for voltage, 'c' for current
+ * @param overshoot: Whether to allow overshoot beyond safe ranges
+ * @param phaseDeg: Phase offset at start in degrees
+ */
+void startSineWave(float amplitude, float period, float center, uint8_t signal, char mode, bool overshoot,
+                   float phaseDeg) {
+    if (!configureSineChannel(amplitude, period, center, signal, mode, phaseDeg, false, nullptr)) {
+        return;
+    }
     
     Serial.printf("Sine wave started on SIG%d: %.2f%s amplitude, %.1fs period, center %.2f%s, %s mode\n",
                   signal,
@@ -127,6 +236,81 @@ void startSineWave(float amplitude, float period, float center, uint8_t signal,
                   (mode == 'v') ? "voltage" : "current");
 }
 
+/**
+ * Arm sine wave generation (configured but idle until SINE TRIGGER)
+ * @param phaseDeg: Phase offset at trigger in degrees
+ */
+void armSineWave(float amplitude, float period, float center, uint8_t signal, char mode, float phaseDeg) {
+    if (!configureSineChannel(amplitude, period, center, signal, mode, phaseDeg, true, nullptr)) {
+        return;
+    }
+    Serial.printf("Sine wave armed on SIG%d: %.2f%s amplitude, %.1fs period, center %.2f%s, phase %.1f deg\n",
+                  signal, amplitude, (mode == 'v') ? "V" : "mA", period, center,
+                  (mode == 'v') ? "V" : "mA", phaseDeg);
+}
+
+/**
+ * Start (or arm) a frequency sweep between two periods with continuous phase
+ * @param startPeriod: Period at sweep start in seconds (1-60s)
+ * @param endPeriod: Period at sweep end in seconds (1-60s)
+ * @param sweepSeconds: Sweep duration in seconds
+ * @param shape: DDS_CHIRP_LINEAR or DDS_CHIRP_LOG
+ * @param endMode: DDS_CHIRP_ONCE, DDS_CHIRP_REPEAT or DDS_CHIRP_BOUNCE
+ * @param arm: true to wait for SINE TRIGGER
+ */
+void startSineChirp(float amplitude, float startPeriod, float endPeriod, float sweepSeconds, float center,
+                    uint8_t signal, char mode, uint8_t shape, uint8_t endMode, bool arm) {
+    if (endPeriod < 1.0 || endPeriod > 60.0) {
+        Serial.println("Invalid end period. Use 1-60 seconds.");
+        return;
+    }
+    if (sweepSeconds < 1.0 || sweepSeconds > 86400.0) {
+        Serial.println("Invalid sweep time. Use 1-86400 seconds.");
+        return;
+    }
+    SineChirpSettings chirp;
+    chirp.endPeriod = endPeriod;
+    chirp.sweepSeconds = sweepSeconds;
+    chirp.shape = shape;
+    chirp.endMode = endMode;
+    if (!configureSineChannel(amplitude, startPeriod, center, signal, mode, 0.0f, arm, &chirp)) {
+        return;
+    }
+    
+    static const char* endModeNames[] = {"once", "repeat", "bounce"};
+    Serial.printf("Chirp %s on SIG%d: %.1fs -> %.1fs period over %.1fs (%s, %s), %.2f%s amplitude, center %.2f%s\n",
+                  arm ? "armed" : "started", signal, startPeriod, endPeriod, sweepSeconds,
+                  (shape == DDS_CHIRP_LOG) ? "log" : "linear", endModeNames[endMode],
+                  amplitude, (mode == 'v') ? "V" : "mA", center, (mode == 'v') ? "V" : "mA");
+}
+
+/**
+ * Start all armed channels from one common epoch (the next sample tick)
+ * @return Number of channels started
+ */
+int triggerSineWaves() {
+    int started = 0;
+    xSemaphoreTake(sineMutex, portMAX_DELAY);
+    uint32_t epoch = getSampleTick() + 1;
+    for (int i = 0; i < 3; i++) {
+        if (sineWaveArmed[i]) {
+            sineWaveArmed[i] = false;
+            sineEpoch[i] = epoch;
+            sineChirpIndex[i] = 0;
+            sineWaveActive[i] = true;
+            started++;
+        }
+    }
+    xSemaphoreGive(sineMutex);
+    
+    if (started > 0) {
+        Serial.printf("Sine trigger: %d channel(s) started at tick %lu\n", started, (unsigned long)epoch);
+    } else {
+        Serial.println("Sine trigger: no channels armed.");
+    }
+    return started;
+}
+
 /**
  * Stop sine wave generation for a specific channel
  * @param signal: Signal number (1-3), 0 to stop all channels
@@ -135,33 +319,44 @@ void stopSineWave(uint8_t signal) {
     if (signal == 0) {
         // Stop all channels
         bool anyActive = false;
+        xSemaphoreTake(sineMutex, portMAX_DELAY);
         for (int i = 0; i < 3; i++) {
+            sineWaveArmed[i] = false;
             if (sineWaveActive[i]) {
                 sineWaveActive[i] = false;
                 anyActive = true;
             }
         }
+        xSemaphoreGive(sineMutex);
         
         if (anyActive) {
             Serial.println("All sine waves stopped.");
             // Reset all outputs to 0 for safety
-            initializeDACs();
-            Serial.println("All outputs reset to 0.");
+            if (initializeDACs()) {
+                Serial.println("All outputs reset to 0.");
+            }
         } else {
             Serial.println("No sine waves are currently active.");
         }
     } else if (signal >= 1 && signal <= 3) {
         // Stop specific channel
         int channel = signal - 1;
+        if (sineWaveArmed[channel]) {
+            sineWaveArmed[channel] = false;
+            Serial.printf("Sine wave disarmed on SIG%d.\n", signal);
+        }
         if (sineWaveActive[channel]) {
+            // Holding the mutex guarantees no sample for this channel is in flight
+            xSemaphoreTake(sineMutex, portMAX_DELAY);
             sineWaveActive[channel] = false;
+            xSemaphoreGive(sineMutex);
             Serial.printf("Sine wave stopped on SIG%d.\n", signal);
             
-            // Reset this channel's output to 0
+            // Reset this channel's output to 0 (replaces any sample still pending)
             if (sineWaveMode[channel] == 'v') {
-                sineSignalMap[channel].voltageDAC->setVoltage(0.0, sineSignalMap[channel].voltageChannel);
+                postVoltageCode(channel, 0);
             } else if (sineWaveMode[channel] == 'c') {
-                sineSignalMap[channel].currentDAC->setDACOutElectricCurrent(0);
+                postCurrentCode(channel, 0);
             }
             Serial.printf("SIG%d output reset to 0.\n", signal);
         } else {
@@ -173,51 +368,178 @@ void stopSineWave(uint8_t signal) {
 }
 
 /**
- * Update sine wave output (call this in main loop)
+ * Render sine wave samples into the tick's output frame (called from the sample clock task)
+ * @param frame: Output frame shared by all signal sources
+ * @param ticks: Number of sample ticks due; unused, every channel is evaluated at the
+ *               shared tick counter, so missed ticks never shift phase between channels.
  */
-void updateSineWave() {
-    unsigned long currentTime = millis();
+void renderSineWave(DacFrame* frame, uint32_t ticks) {
+    xSemaphoreTake(sineMutex, portMAX_DELAY);
     
-    // Check if it's time for next update (every 0.25 seconds)
-    if (currentTime - lastUpdateTime < UPDATE_INTERVAL) {
-        return;
-    }
-    
-    lastUpdateTime = currentTime;
-    
-    // Process each active channel
+    uint32_t tick = getSampleTick();
     for (int channel = 0; channel < 3; channel++) {
         if (!sineWaveActive[channel]) {
             continue;
         }
+        // The tick is counted before this render takes sineMutex, so a channel started
+        // in between has its epoch (tick read + 1) one tick ahead: it starts on the next
+        // tick. Without this, tick - epoch would wrap to 0xFFFFFFFF.
+        if (sineEpoch[channel] == tick + 1) {
+            continue;
+        }
         
-        // Calculate elapsed time since start for this channel
-        unsigned long elapsedTime = currentTime - startTime[channel];
-        float timeInSeconds = elapsedTime / 1000.0;
-        
-        // Calculate sine wave value for this channel
-        float frequency = 1.0 / sinePeriod[channel];
-        float angle = 2.0 * PI * frequency * timeInSeconds;
-        float sineValue = sin(angle);
-        
-        // Calculate output value for this channel
-        float outputValue = sineOffset[channel] + (sineValue * sineAmplitude[channel]);
-        
-        // Clamp output to safe ranges
-        if (outputValue < 0) outputValue = 0;
-        if (sineWaveMode[channel] == 'v' && outputValue > 10.0) outputValue = 10.0;
-        if (sineWaveMode[channel] == 'c' && outputValue > 25.0) outputValue = 25.0;
+        // All channels use the same timestamp: samples since their (possibly shared) epoch
+        uint16_t code;
+        if (sineChirpEnabled[channel]) {
+            // Accumulate the sweep's varying increments up to this sample (phase continuous);
+            // compared by difference so the catch-up keeps going past 2^31 samples
+            uint32_t sampleIndex = tick - sineEpoch[channel];
+            while ((int32_t)(sampleIndex - sineChirpIndex[channel]) > 0) {
+                sineDDS[channel].phase += ddsChirpIncrement(&sineChirp[channel], sineChirpIndex[channel]);
+                sineChirpIndex[channel]++;
+            }
+            code = ddsCurrentCode(&sineDDS[channel]);
+        } else {
+            code = ddsCodeAt(&sineDDS[channel], tick - sineEpoch[channel]);
+        }
         
-        // Output to this channel
+        // Code is already clamped to 0-10V / 0-25mA
         if (sineWaveMode[channel] == 'v') {
-            sineSignalMap[channel].voltageDAC->setVoltage(outputValue, sineSignalMap[channel].voltageChannel);
+            dacFrameSetVoltageCode(frame, channel, code);
         } else if (sineWaveMode[channel] == 'c') {
-            // Convert mA to DAC data: Rset=2kΩ, 25mA = 32767 (15-bit), so 1mA = 1310.68
-            sineSignalMap[channel].currentDAC->setDACOutElectricCurrent(static_cast<uint16_t>(outputValue * 1310.68));
+            dacFrameSetCurrentCode(frame, channel, code);
         }
         
         // Status printing removed - use 'SINE STATUS' command to check progress
     }
+    
+    xSemaphoreGive(sineMutex);
+}
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ * @param channel: Channel number (0-2)
+ */
+void releaseSineChannel(uint8_t channel) {
+    if (channel >= 3) {
+        return;
+    }
+    cancelScheduledChannel(channel); // A latched code must not overwrite the new source
+    sineWaveArmed[channel] = false;
+    if (!sineWaveActive[channel]) {
+        return;
+    }
+    xSemaphoreTake(sineMutex, portMAX_DELAY);
+    sineWaveActive[channel] = false;
+    xSemaphoreGive(sineMutex);
+    Serial.printf("Sine wave on SIG%d replaced.\n", channel + 1);
+}
+
+/**
+ * Set waveform sample rate
+ * Phase increments of running channels are recomputed so their periods are kept.
+ * Running channels are rebased onto one new epoch with their current phase, so
+ * they stay continuous and aligned with each other. Chirps keep their position in
+ * the sweep (in seconds): the sweep index is rescaled to the new rate.
+ * @param rateHz: Sample rate in Hz
+ */
+void setSineSampleRate(uint32_t rateHz) {
+    xSemaphoreTake(sineMutex, portMAX_DELAY);
+    float oldRate = getSampleClockRate();
+    if (setSampleClockRate(rateHz)) {
+        float rate = getSampleClockRate();
+        uint32_t tick = getSampleTick();
+        uint32_t epoch = tick + 1;
+        for (int i = 0; i < 3; i++) {
+            if (sineWaveActive[i] && !sineChirpEnabled[i]) {
+                sineDDS[i].phase += sineDDS[i].increment * (epoch - sineEpoch[i]);
+                sineEpoch[i] = epoch;
+            }
+            sineDDS[i].increment = ddsIncrementForPeriod(sinePeriod[i], rate);
+            if (sineChirpEnabled[i]) {
+                // Same time into the sweep at the new rate; the accumulated phase is kept
+                uint32_t index = (uint32_t)llround((double)sineChirpIndex[i] * rate / oldRate);
+                buildSineChirp(i);
+                sineChirpIndex[i] = index;
+                if (sineWaveActive[i]) {
+                    sineEpoch[i] = tick - index; // Next render continues at index + 1
+                }
+            }
+        }
+        Serial.printf("Sample rate set to %.1f Hz (period %lu us)\n", getSampleClockRate(), (unsigned long)getSampleClockPeriodUs());
+    }
+    xSemaphoreGive(sineMutex);
+}
+
+/**
+ * Print sample clock rate and jitter statistics
+ */
+void printSampleClockStatus() {
+    SampleScheduler stats = getSampleClockStats();
+    Serial.printf("Sample clock: %.1f Hz (period %lu us)\n", getSampleClockRate(), (unsigned long)stats.periodUs);
+    Serial.printf("  Ticks: %lu, missed: %lu\n", (unsigned long)stats.tickCount, (unsigned long)stats.missedTicks);
+    Serial.printf("  Lateness: last %lu us, max %lu us\n", (unsigned long)stats.lastLatenessUs, (unsigned long)stats.maxLatenessUs);
+}
+
+/**
+ * Benchmark DDS engine against the previous float sin() path
+ * Reports throughput per sample and worst-case code error over several periods.
+ */
+void runSineBenchmark() {
+    const int SAMPLES = 10000;
+    const float period = 7.3f;    // Deliberately not a multiple of the sample tick
+    const float amplitude = 5.0f;
+    const float center = 5.0f;
+    
+    const float sampleRate = getSampleClockRate();
+    const float tickSeconds = 1.0f / sampleRate;
+    
+    DDSChannel dds;
+    ddsConfigure(&dds, valueToDacCode(center, 'v'), valueToDacCode(amplitude, 'v'),
+                 ddsIncrementForPeriod(period, sampleRate));
+    
+    // Accuracy: compare both paths sample by sample
+    int32_t maxError = 0;
+    for (int n = 0; n < SAMPLES; n++) {
+        float timeInSeconds = n * tickSeconds;
+        float outputValue = center + sin(2.0 * PI * (1.0 / period) * timeInSeconds) * amplitude;
+        if (outputValue < 0) outputValue = 0;
+        if (outputValue > 10.0) outputValue = 10.0;
+        int32_t floatCode = static_cast<uint16_t>((outputValue / 10.0) * 32767);
+        int32_t error = abs((int32_t)ddsCurrentCode(&dds) - floatCode);
+        if (error > maxError) maxError = error;
+        ddsAdvance(&dds, 1);
+    }
+    
+    // Throughput: float path
+    volatile uint16_t sink = 0;
+    unsigned long t0 = micros();
+    for (int n = 0; n < SAMPLES; n++) {
+        float timeInSeconds = n * tickSeconds;
+        float frequency = 1.0 / period;
+        float outputValue = center + sin(2.0 * PI * frequency * timeInSeconds) * amplitude;
+        if (outputValue < 0) outputValue = 0;
+        if (outputValue > 10.0) outputValue = 10.0;
+        sink = static_cast<uint16_t>((outputValue / 10.0) * 32767);
+    }
+    unsigned long floatMicros = micros() - t0;
+    
+    // Throughput: DDS path
+    dds.phase = 0;
+    t0 = micros();
+    for (int n = 0; n < SAMPLES; n++) {
+        sink = ddsCurrentCode(&dds);
+        ddsAdvance(&dds, 1);
+    }
+    unsigned long ddsMicros = micros() - t0;
+    (void)sink;
+    
+    Serial.println("=== SINE BENCHMARK ===");
+    Serial.printf("Samples: %d, period %.1fs, sample rate %.1f Hz\n", SAMPLES, period, sampleRate);
+    Serial.printf("Float sin() path: %lu us total, %.3f us/sample\n", floatMicros, (float)floatMicros / SAMPLES);
+    Serial.printf("DDS path:         %lu us total, %.3f us/sample\n", ddsMicros, (float)ddsMicros / SAMPLES);
+    Serial.printf("Max code error vs float: %ld LSB (%.2f mV)\n", (long)maxError, maxError * 10000.0f / 32767);
+    Serial.println("======================");
 }
 
 /**
@@ -272,22 +594,37 @@ void getSineWaveStatus() {
     bool anyActive = false;
     
     for (int i = 0; i < 3; i++) {
-        if (sineWaveActive[i]) {
+        if (sineWaveActive[i] || sineWaveArmed[i]) {
             if (!anyActive) {
                 Serial.println("=== SINE WAVE STATUS ===");
                 anyActive = true;
             }
             
-            unsigned long currentTime = millis();
-            unsigned long elapsedTime = currentTime - startTime[i];
-            float timeInSeconds = elapsedTime / 1000.0;
-            float progress = (timeInSeconds / sinePeriod[i]) * 100.0;
+            // Elapsed time and phase from the shared tick counter
+            uint32_t tick = getSampleTick();
+            uint32_t samples = (sineWaveActive[i] && sineEpoch[i] != tick + 1) ? tick - sineEpoch[i] : 0;
+            float timeInSeconds = samples / getSampleClockRate();
+            uint32_t phase = sineChirpEnabled[i] ? sineDDS[i].phase  // Chirp: live accumulator
+                                                 : sineDDS[i].phase + sineDDS[i].increment * samples;
+            float progress = phase / 4294967296.0f * 100.0f;
             
-            Serial.printf("SIG%d: ACTIVE\n", i + 1);
+            Serial.printf("SIG%d: %s\n", i + 1, sineWaveActive[i] ? "ACTIVE" : "ARMED (waiting for SINE TRIGGER)");
             Serial.printf("  Amplitude: %.2f%s\n", sineAmplitude[i], (sineWaveMode[i] == 'v') ? "V" : "mA");
-            Serial.printf("  Period: %.1f seconds\n", sinePeriod[i]);
-            Serial.printf("  Elapsed time: %.1f seconds\n", timeInSeconds);
-            Serial.printf("  Progress: %.1f%%\n", progress);
+            if (sineChirpEnabled[i]) {
+                static const char* endModeNames[] = {"once", "repeat", "bounce"};
+                const SineChirpSettings* chirp = &sineChirpSettings[i];
+                uint32_t increment = ddsChirpIncrement(&sineChirp[i], sineChirpIndex[i]);
+                Serial.printf("  Chirp: %.1f -> %.1f seconds over %.1fs (%s, %s)\n", sinePeriod[i],
+                              chirp->endPeriod, chirp->sweepSeconds,
+                              (chirp->shape == DDS_CHIRP_LOG) ? "log" : "linear", endModeNames[chirp->endMode]);
+                Serial.printf("  Current period: %.2f seconds\n",
+                              4294967296.0f / ((float)increment * getSampleClockRate()));
+            } else {
+                Serial.printf("  Period: %.1f seconds\n", sinePeriod[i]);
+            }
+            Serial.printf("  Time since epoch: %.1f seconds\n", timeInSeconds);
+            Serial.printf("  Progress: %.1f%% of cycle\n", progress);
+            Serial.printf("  Phase offset: %.1f deg\n", sinePhase[i]);
             Serial.printf("  Center point: %.2f%s\n", sineOffset[i], (sineWaveMode[i] == 'v') ? "V" : "mA");
             Serial.printf("  Mode: %s\n", (sineWaveMode[i] == 'v') ? "Voltage" : "Current");
             Serial.println();
@@ -299,6 +636,7 @@ void getSineWaveStatus() {
     } else {
         Serial.println("Sine wave: INACTIVE");
     }
+    printSampleClockStatus();
 }
 
 /**
@@ -309,11 +647,13 @@ void parseSineWaveCommand(String input) {
     input.trim();
     input.toUpperCase();
     
-    if (input.startsWith("SINE START")) {
-        // Parse: SINE START amplitude period center signal mode
+    if (input.startsWith("SINE START") || input.startsWith("SINE ARM")) {
+        // Parse: SINE START|ARM amplitude period center signal mode [phase]
         // Example: SINE START 5.0 2.0 5.0 1 V
         // Example: SINE START 3.0 1.5 2.5 2 C
-        String params = input.substring(11); // Remove "SINE START "
+        // Example: SINE ARM 5.0 2.0 5.0 2 V 120
+        bool arm = input.startsWith("SINE ARM");
+        String params = input.substring(arm ? 9 : 11); // Remove "SINE ARM " / "SINE START "
         params.trim();
         
         // Parse parameters
@@ -334,8 +674,59 @@ void parseSineWaveCommand(String input) {
         float center = params.substring(space2 + 1, space3).toFloat();
         uint8_t signal = params.substring(space3 + 1, space4).toInt();
         char mode = toLowerCase(params.substring(space4 + 1).charAt(0));
+        int space5 = params.indexOf(' ', space4 + 1);
+        float phaseDeg = (space5 == -1) ? 0.0f : params.substring(space5 + 1).toFloat();
         
-        startSineWave(amplitude, period, center, signal, mode, false);
+        if (arm) {
+            armSineWave(amplitude, period, center, signal, mode, phaseDeg);
+        } else {
+            startSineWave(amplitude, period, center, signal, mode, false, phaseDeg);
+        }
+        
+    } else if (input.startsWith("SINE CHIRP")) {
+        // Parse: SINE CHIRP amplitude startPeriod endPeriod sweepTime center signal mode [LIN|LOG] [ONCE|REPEAT|BOUNCE] [ARM]
+        // Example: SINE CHIRP 5.0 10.0 1.0 60 5.0 1 V LOG REPEAT
+        String params = input.substring(10); // Remove "SINE CHIRP"
+        params.trim();
+        
+        String tokens[10];
+        int count = 0;
+        int pos = 0;
+        while (pos < (int)params.length() && count < 10) {
+            int next = params.indexOf(' ', pos);
+            if (next == -1) next = params.length();
+            if (next > pos) {
+                tokens[count++] = params.substring(pos, next);
+            }
+            pos = next + 1;
+        }
+        if (count < 7) {
+            Serial.println("Invalid SINE CHIRP format. Use: SINE CHIRP amplitude startPeriod endPeriod sweepTime center signal mode [LIN|LOG] [ONCE|REPEAT|BOUNCE] [ARM]");
+            Serial.println("Example: SINE CHIRP 5.0 10.0 1.0 60 5.0 1 V LOG REPEAT");
+            return;
+        }
+        
+        uint8_t shape = DDS_CHIRP_LINEAR;
+        uint8_t endMode = DDS_CHIRP_ONCE;
+        bool arm = false;
+        for (int i = 7; i < count; i++) {
+            if (tokens[i] == "LIN") shape = DDS_CHIRP_LINEAR;
+            else if (tokens[i] == "LOG") shape = DDS_CHIRP_LOG;
+            else if (tokens[i] == "ONCE") endMode = DDS_CHIRP_ONCE;
+            else if (tokens[i] == "REPEAT") endMode = DDS_CHIRP_REPEAT;
+            else if (tokens[i] == "BOUNCE") endMode = DDS_CHIRP_BOUNCE;
+            else if (tokens[i] == "ARM") arm = true;
+            else {
+                Serial.printf("Unknown chirp option: %s\n", tokens[i].c_str());
+                return;
+            }
+        }
+        startSineChirp(tokens[0].toFloat(), tokens[1].toFloat(), tokens[2].toFloat(), tokens[3].toFloat(),
+                       tokens[4].toFloat(), tokens[5].toInt(), toLowerCase(tokens[6].charAt(0)),
+                       shape, endMode, arm);
+        
+    } else if (input.startsWith("SINE TRIGGER")) {
+        triggerSineWaves();
         
     } else if (input.startsWith("SINE STOP")) {
         String params = input.substring(10); // Remove "SINE STOP "
@@ -357,22 +748,46 @@ void parseSineWaveCommand(String input) {
     } else if (input.startsWith("SINE STATUS")) {
         getSineWaveStatus();
         
+    } else if (input.startsWith("SINE BENCH")) {
+        runSineBenchmark();
+        
+    } else if (input.startsWith("SINE RATE")) {
+        String params = input.substring(9); // Remove "SINE RATE"
+        params.trim();
+        
+        if (params.length() == 0) {
+            printSampleClockStatus();
+        } else {
+            setSineSampleRate(params.toInt());
+        }
+        
     } else {
         Serial.println("Invalid sine wave command. Use:");
-        Serial.println("  SINE START amplitude period center signal mode");
+        Serial.println("  SINE START amplitude period center signal mode [phase]");
+        Serial.println("  SINE ARM amplitude period center signal mode [phase]");
+        Serial.println("  SINE TRIGGER");
+        Serial.println("  SINE CHIRP amplitude startPeriod endPeriod sweepTime center signal mode [LIN|LOG] [ONCE|REPEAT|BOUNCE] [ARM]");
         Serial.println("  SINE STOP [signal]");
         Serial.println("  SINE STATUS");
+        Serial.println("  SINE BENCH");
+        Serial.println("  SINE RATE [hz]");
         Serial.println("Examples:");
         Serial.println("  SINE START 5.0 2.0 5.0 1 V    // Start voltage sine wave on SIG1");
         Serial.println("  SINE START 3.0 1.5 2.5 2 C    // Start current sine wave on SIG2");
+        Serial.println("  SINE ARM 5.0 2.0 5.0 1 V 0     // Arm SIG1 at 0 deg");
+        Serial.println("  SINE ARM 5.0 2.0 5.0 2 V 120   // Arm SIG2 at 120 deg");
+        Serial.println("  SINE TRIGGER                  // Start all armed channels together");
+        Serial.println("  SINE CHIRP 5.0 10 1 60 5.0 1 V LOG  // Sweep SIG1 from 10s to 1s period in 60s");
         Serial.println("  SINE STOP                     // Stop all sine waves");
         Serial.println("  SINE STOP 1                   // Stop sine wave on SIG1 only");
+        Serial.println("  SINE RATE 500                 // Set sample rate to 500 Hz (1-2000 Hz)");
         Serial.println("Parameters:");
         Serial.println("  amplitude: Peak amplitude from center");
         Serial.println("  period: Period in seconds (1-60s)");
         Serial.println("  center: Center point of the sine wave");
         Serial.println("  signal: Signal number (1-3)");
         Serial.println("  mode: 'v' for voltage, 'c' for current");
+        Serial.println("  phase: Phase offset in degrees at start (default 0)");
         Serial.println("Note: Values exceeding safe ranges will be clamped to boundaries:");
         Serial.println("  Voltage: 0-10V, Current: 0-25mA");
     }
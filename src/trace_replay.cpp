@@ -0,0 +1,325 @@
+#include "trace_replay.h"
+#include "meter_register_map.h"
+#include "meter_totalizer.h"
+#include "virtual_meters.h"
+
+static TraceRecord traceRing[TRACE_RING_SIZE];
+static uint32_t traceHead = 0;    // Records pushed (free-running)
+static uint32_t traceTail = 0;    // Records consumed (free-running)
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t traceTaskHandle = nullptr;
+
+static volatile bool traceRunning = false;
+static volatile bool traceEnded = false;
+static volatile bool traceFinished = false;
+static float traceSpeed = 1.0f;
+static uint8_t traceMeter = 0;    // Virtual meter the trace is replayed into
+static uint32_t lastPushedMs = 0;
+
+// Playback clock: elapsed device time is accumulated in 64 bits (micros() wraps after 71 min)
+static uint64_t traceElapsedUs = 0;
+static uint32_t traceLastUs = 0;
+static uint32_t traceOriginMs = 0;
+
+// Statistics
+static uint32_t recordsApplied = 0;
+static uint32_t underruns = 0;
+static bool starved = false;
+static uint32_t maxLagMs = 0;
+static TraceRecord lastApplied;
+
+/**
+ * Write one record to registers 6/8/14/42 as one image update
+ */
+static void applyTraceRecord(const TraceRecord& record) {
+    ImageWrite writes[4];
+    encodeMeterWrite(METER_FLOW, meterRawFromValue(meterRegisterMap[METER_FLOW], record.flow), &writes[0]);
+    encodeMeterWrite(METER_CONSUMPTION, record.consumption, &writes[1]);
+    encodeMeterWrite(METER_REVERSE_CONSUMPTION, record.reverse, &writes[2]);
+    encodeMeterWrite(METER_FLOW_DIRECTION, record.direction, &writes[3]);
+    writeImageBatch(traceMeter, writes, 4);
+}
+
+/**
+ * Advance the playback clock and apply all records that are due
+ * Only the newest due record is written; older ones in the same tick are already superseded.
+ */
+static void traceTick() {
+    uint32_t now = micros();
+    traceElapsedUs += now - traceLastUs;
+    traceLastUs = now;
+    uint64_t traceTimeMs = traceOriginMs + (uint64_t)(traceElapsedUs * (double)traceSpeed / 1000.0);
+
+    TraceRecord due;
+    bool haveDue = false;
+    bool empty = false;
+    portENTER_CRITICAL(&traceMux);
+    while (traceTail != traceHead) {
+        const TraceRecord& next = traceRing[traceTail % TRACE_RING_SIZE];
+        if (next.timeMs > traceTimeMs) {
+            break;
+        }
+        due = next;
+        haveDue = true;
+        traceTail++;
+        recordsApplied++;
+    }
+    empty = (traceTail == traceHead);
+    if (haveDue) {
+        uint32_t lag = (uint32_t)(traceTimeMs - due.timeMs);
+        if (lag > maxLagMs) {
+            maxLagMs = lag;
+        }
+        lastApplied = due;
+    }
+    if (empty && !traceEnded && !starved) {
+        underruns++; // Host did not keep up, playback clock keeps running
+    }
+    starved = empty && !traceEnded;
+    portEXIT_CRITICAL(&traceMux);
+
+    if (haveDue) {
+        applyTraceRecord(due);
+    }
+    if (empty && traceEnded) {
+        traceRunning = false;
+        traceFinished = true;
+        Serial.printf("Trace finished: %lu records applied\n", (unsigned long)recordsApplied);
+    }
+}
+
+/**
+ * Playback task: fixed tick, trace time derived from accumulated micros()
+ */
+static void traceTask(void* param) {
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(TRACE_TICK_MS));
+        if (traceRunning) {
+            traceTick();
+        }
+    }
+}
+
+/**
+ * Create the playback task
+ */
+void initTraceReplay() {
+    xTaskCreatePinnedToCore(traceTask, "trace_replay", TRACE_TASK_STACK, nullptr,
+                            TRACE_TASK_PRIORITY, &traceTaskHandle, TRACE_TASK_CORE);
+}
+
+/**
+ * Clear the ring buffer and set playback speed
+ */
+bool beginTrace(float speed) {
+    if (speed <= 0 || speed > TRACE_MAX_SPEED) {
+        Serial.printf("Invalid trace speed. Use 0-%.0f (1 = real time).\n", TRACE_MAX_SPEED);
+        return false;
+    }
+    traceRunning = false;
+    portENTER_CRITICAL(&traceMux);
+    traceHead = 0;
+    traceTail = 0;
+    traceSpeed = speed;
+    traceEnded = false;
+    traceFinished = false;
+    lastPushedMs = 0;
+    recordsApplied = 0;
+    underruns = 0;
+    starved = false;
+    maxLagMs = 0;
+    portEXIT_CRITICAL(&traceMux);
+    return true;
+}
+
+/**
+ * Add a record to the ring buffer
+ */
+bool pushTraceRecord(const TraceRecord& record) {
+    bool stored = false;
+    portENTER_CRITICAL(&traceMux);
+    bool ordered = (traceHead == 0) || (record.timeMs >= lastPushedMs);
+    if (ordered && !traceEnded && traceHead - traceTail < TRACE_RING_SIZE) {
+        traceRing[traceHead % TRACE_RING_SIZE] = record;
+        traceHead++;
+        lastPushedMs = record.timeMs;
+        stored = true;
+    }
+    portEXIT_CRITICAL(&traceMux);
+    return stored;
+}
+
+/**
+ * Mark the end of the trace
+ */
+void endTrace() {
+    traceEnded = true;
+}
+
+/**
+ * Start playback from the first buffered record
+ */
+bool startTrace() {
+    portENTER_CRITICAL(&traceMux);
+    bool hasData = (traceTail != traceHead);
+    if (hasData) {
+        traceOriginMs = traceRing[traceTail % TRACE_RING_SIZE].timeMs;
+    }
+    portEXIT_CRITICAL(&traceMux);
+    if (!hasData) {
+        Serial.println("Trace buffer is empty. Send TRACE DATA first.");
+        return false;
+    }
+    traceMeter = getSelectedMeter();
+    if (isTotalizerRunning(traceMeter)) {
+        stopTotalizer(traceMeter); // Both would write the consumption registers
+    }
+
+    traceElapsedUs = 0;
+    traceLastUs = micros();
+    traceFinished = false;
+    traceRunning = true;
+    Serial.printf("Trace playback started at %.2fx (slave %d)\n", traceSpeed, getVirtualMeterSlaveID(traceMeter));
+    return true;
+}
+
+/**
+ * Stop playback
+ */
+void stopTrace() {
+    traceRunning = false;
+    Serial.println("Trace playback stopped, registers keep their last values");
+}
+
+/**
+ * Get free slots in the ring buffer
+ */
+uint16_t getTraceFreeSlots() {
+    portENTER_CRITICAL(&traceMux);
+    uint16_t freeSlots = TRACE_RING_SIZE - (traceHead - traceTail);
+    portEXIT_CRITICAL(&traceMux);
+    return freeSlots;
+}
+
+/**
+ * Print playback state
+ */
+void printTraceStatus() {
+    portENTER_CRITICAL(&traceMux);
+    uint32_t buffered = traceHead - traceTail;
+    uint32_t received = traceHead;
+    uint32_t applied = recordsApplied;
+    uint32_t underrunCount = underruns;
+    uint32_t lag = maxLagMs;
+    TraceRecord last = lastApplied;
+    uint64_t traceTimeMs = traceOriginMs + (uint64_t)(traceElapsedUs * (double)traceSpeed / 1000.0);
+    portEXIT_CRITICAL(&traceMux);
+
+    Serial.println("=== TRACE REPLAY ===");
+    Serial.printf("State: %s, speed %.2fx, slave %d%s\n",
+                  traceRunning ? "PLAYING" : (traceFinished ? "FINISHED" : "STOPPED"),
+                  traceSpeed, getVirtualMeterSlaveID(traceMeter), traceEnded ? ", end of trace received" : "");
+    Serial.printf("Records: %lu received, %lu applied, %lu buffered (%d max)\n",
+                  (unsigned long)received, (unsigned long)applied, (unsigned long)buffered, TRACE_RING_SIZE);
+    Serial.printf("Trace time: %llu ms, max lag: %lu ms, buffer underruns: %lu\n",
+                  (unsigned long long)traceTimeMs, (unsigned long)lag, (unsigned long)underrunCount);
+    if (applied > 0) {
+        Serial.printf("Last record: t=%lu flow=%.3f consumption=%lu reverse=%lu direction=%u\n",
+                      (unsigned long)last.timeMs, last.flow, (unsigned long)last.consumption,
+                      (unsigned long)last.reverse, last.direction);
+    }
+    Serial.println("====================");
+}
+
+/**
+ * Parse one record: time flow consumption reverse direction
+ */
+static bool parseTraceRecord(String text, TraceRecord* record) {
+    text.trim();
+    int space1 = text.indexOf(' ');
+    int space2 = text.indexOf(' ', space1 + 1);
+    int space3 = text.indexOf(' ', space2 + 1);
+    int space4 = text.indexOf(' ', space3 + 1);
+    if (space1 == -1 || space2 == -1 || space3 == -1 || space4 == -1) {
+        return false;
+    }
+    record->timeMs = strtoul(text.substring(0, space1).c_str(), nullptr, 10);
+    record->flow = text.substring(space1 + 1, space2).toFloat();
+    record->consumption = strtoul(text.substring(space2 + 1, space3).c_str(), nullptr, 10);
+    record->reverse = strtoul(text.substring(space3 + 1, space4).c_str(), nullptr, 10);
+    record->direction = text.substring(space4 + 1).toInt() ? 1 : 0;
+    return true;
+}
+
+/**
+ * Parse trace commands
+ * Format: TRACE BEGIN/DATA/END/START/STOP/STATUS ...
+ */
+void parseTraceCommand(String input) {
+    input.trim();
+    input.toUpperCase();
+
+    if (input.startsWith("TRACE BEGIN")) {
+        // TRACE BEGIN [speed]
+        String params = input.substring(11);
+        params.trim();
+        float speed = (params.length() == 0) ? 1.0f : params.toFloat();
+        if (beginTrace(speed)) {
+            Serial.printf("TRACE READY %d\n", TRACE_RING_SIZE);
+        }
+
+    } else if (input.startsWith("TRACE DATA")) {
+        // TRACE DATA t flow consumption reverse direction; t flow ...
+        String params = input.substring(10);
+        params.replace(',', ' ');
+        int accepted = 0;
+        bool full = false;
+        int pos = 0;
+        while (pos < (int)params.length()) {
+            int next = params.indexOf(';', pos);
+            if (next == -1) next = params.length();
+            String item = params.substring(pos, next);
+            item.trim();
+            if (item.length() > 0) {
+                TraceRecord record;
+                if (!parseTraceRecord(item, &record)) {
+                    Serial.printf("TRACE ERROR bad record: %s\n", item.c_str());
+                    break;
+                }
+                if (!pushTraceRecord(record)) {
+                    full = true;
+                    break;
+                }
+                accepted++;
+            }
+            pos = next + 1;
+        }
+        // Reply for host flow control: accepted records and free slots left
+        Serial.printf("TRACE %s %d %u\n", full ? "FULL" : "OK", accepted, getTraceFreeSlots());
+
+    } else if (input.startsWith("TRACE END")) {
+        endTrace();
+        Serial.println("TRACE END OK");
+
+    } else if (input.startsWith("TRACE START")) {
+        startTrace();
+
+    } else if (input.startsWith("TRACE STOP")) {
+        stopTrace();
+
+    } else if (input.startsWith("TRACE STATUS")) {
+        printTraceStatus();
+
+    } else {
+        Serial.println("Invalid trace command. Use:");
+        Serial.println("  TRACE BEGIN [speed]     - Clear buffer, speed 1 = real time");
+        Serial.println("  TRACE DATA t flow consumption reverse direction; t flow ...");
+        Serial.println("  TRACE START             - Start playback (keep sending DATA while playing)");
+        Serial.println("  TRACE END               - No more data, finish after last record");
+        Serial.println("  TRACE STOP");
+        Serial.println("  TRACE STATUS");
+        Serial.printf("Buffer: %d records. Each DATA line is answered with TRACE OK|FULL <accepted> <free>.\n",
+                      TRACE_RING_SIZE);
+    }
+}
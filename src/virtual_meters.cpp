@@ -0,0 +1,174 @@
+#include "virtual_meters.h"
+#include "modbus_handler.h"
+#include "meter_register_map.h"
+#include "meter_totalizer.h"
+#include "output_control.h"
+
+static uint8_t slaveToMeter[256];                 // Unit ID -> meter index
+static uint8_t meterSlaveID[MODBUS_MAX_METERS];   // Meter index -> unit ID (0 = unused)
+static uint8_t selectedMeter = 0;
+
+/**
+ * Reset the table and create meter 0
+ */
+void initVirtualMeters(uint8_t slaveID) {
+    memset(slaveToMeter, VIRTUAL_METER_NONE, sizeof(slaveToMeter));
+    memset(meterSlaveID, 0, sizeof(meterSlaveID));
+    meterSlaveID[0] = slaveID;
+    slaveToMeter[slaveID] = 0;
+    selectedMeter = 0;
+    currentSlaveID = slaveID;
+    initMeterRegisterMap(0);
+}
+
+/**
+ * Add a virtual meter with empty registers
+ */
+uint8_t addVirtualMeter(uint8_t slaveID) {
+    if (slaveID < 1 || slaveID > 247) {
+        Serial.println("Invalid slave ID. Must be between 1 and 247.");
+        return VIRTUAL_METER_NONE;
+    }
+    if (slaveToMeter[slaveID] != VIRTUAL_METER_NONE) {
+        Serial.printf("Slave ID %d is already served.\n", slaveID);
+        return VIRTUAL_METER_NONE;
+    }
+    for (uint8_t meter = 0; meter < MODBUS_MAX_METERS; meter++) {
+        if (meterSlaveID[meter] == 0) {
+            clearModbusImage(meter);
+            initMeterRegisterMap(meter);
+            resetTotalizer(meter);
+            meterSlaveID[meter] = slaveID;
+            slaveToMeter[slaveID] = meter; // Published last: requests see a ready image
+            return meter;
+        }
+    }
+    Serial.printf("All %d virtual meters are in use.\n", MODBUS_MAX_METERS);
+    return VIRTUAL_METER_NONE;
+}
+
+/**
+ * Remove a virtual meter
+ */
+bool removeVirtualMeter(uint8_t slaveID) {
+    uint8_t meter = slaveToMeter[slaveID];
+    if (meter == VIRTUAL_METER_NONE) {
+        Serial.printf("Slave ID %d is not served.\n", slaveID);
+        return false;
+    }
+    if (meter == OUTPUT_CONTROL_METER) {
+        Serial.println("The first virtual meter carries the output control block; change its ID instead.");
+        return false;
+    }
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < MODBUS_MAX_METERS; i++) {
+        active += (meterSlaveID[i] != 0);
+    }
+    if (active <= 1) {
+        Serial.println("The last virtual meter cannot be removed.");
+        return false;
+    }
+
+    slaveToMeter[slaveID] = VIRTUAL_METER_NONE; // Stop serving first
+    meterSlaveID[meter] = 0;
+    resetTotalizer(meter);
+    if (selectedMeter == meter) {
+        for (uint8_t i = 0; i < MODBUS_MAX_METERS; i++) {
+            if (meterSlaveID[i] != 0) {
+                selectedMeter = i;
+                currentSlaveID = meterSlaveID[i];
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Change the slave ID of a meter
+ */
+bool setVirtualMeterSlaveID(uint8_t meter, uint8_t slaveID) {
+    if (meter >= MODBUS_MAX_METERS || meterSlaveID[meter] == 0) {
+        return false;
+    }
+    if (slaveID < 1 || slaveID > 247) {
+        Serial.println("Invalid slave ID. Must be between 1 and 247.");
+        return false;
+    }
+    if (slaveToMeter[slaveID] != VIRTUAL_METER_NONE && slaveToMeter[slaveID] != meter) {
+        Serial.printf("Slave ID %d is already used by another virtual meter.\n", slaveID);
+        return false;
+    }
+    slaveToMeter[meterSlaveID[meter]] = VIRTUAL_METER_NONE;
+    meterSlaveID[meter] = slaveID;
+    slaveToMeter[slaveID] = meter;
+    if (meter == selectedMeter) {
+        currentSlaveID = slaveID;
+    }
+    return true;
+}
+
+/**
+ * Look up the meter serving a unit ID
+ */
+uint8_t findVirtualMeter(uint8_t slaveID) {
+    return slaveToMeter[slaveID];
+}
+
+/**
+ * Select the meter USB commands act on
+ */
+bool selectVirtualMeter(uint8_t slaveID) {
+    uint8_t meter = slaveToMeter[slaveID];
+    if (meter == VIRTUAL_METER_NONE) {
+        Serial.printf("Slave ID %d is not served.\n", slaveID);
+        return false;
+    }
+    selectedMeter = meter;
+    currentSlaveID = slaveID;
+    return true;
+}
+
+/**
+ * Get the selected meter
+ */
+uint8_t getSelectedMeter() {
+    return selectedMeter;
+}
+
+/**
+ * Check whether a meter index is in use
+ */
+bool isVirtualMeterActive(uint8_t meter) {
+    return meter < MODBUS_MAX_METERS && meterSlaveID[meter] != 0;
+}
+
+/**
+ * Get the slave ID of a meter
+ */
+uint8_t getVirtualMeterSlaveID(uint8_t meter) {
+    return (meter < MODBUS_MAX_METERS) ? meterSlaveID[meter] : 0;
+}
+
+/**
+ * Print meters, request counters and memory per meter
+ */
+void printVirtualMeters() {
+    size_t perMeter = getModbusImageBytes() + getTotalizerBytes() + sizeof(meterSlaveID[0]);
+    Serial.println("=== VIRTUAL METERS ===");
+    for (uint8_t meter = 0; meter < MODBUS_MAX_METERS; meter++) {
+        if (meterSlaveID[meter] == 0) {
+            continue;
+        }
+        ModbusImageStats stats = getModbusImageStats(meter);
+        Serial.printf("%c Slave %3d: %lu reads, %lu writes, %lu exceptions, totalizer %s\n",
+                      (meter == selectedMeter) ? '*' : ' ', meterSlaveID[meter],
+                      (unsigned long)stats.reads, (unsigned long)stats.writes, (unsigned long)stats.exceptions,
+                      isTotalizerRunning(meter) ? "RUNNING" : "STOPPED");
+    }
+    Serial.printf("Memory: %u bytes per meter (image %u, totalizer %u), %d meters max, dispatch table %u bytes\n",
+                  (unsigned)perMeter, (unsigned)getModbusImageBytes(), (unsigned)getTotalizerBytes(),
+                  MODBUS_MAX_METERS, (unsigned)sizeof(slaveToMeter));
+    Serial.println("* = selected for USB commands");
+    Serial.println("======================");
+}
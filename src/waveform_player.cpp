@@ -0,0 +1,449 @@
+#include "waveform_player.h"
+#include "dac_output_queue.h"
+#include "dac_codes.h"
+#include "relay_controller.h"
+#include "sine_wave_generator.h"
+#include "profile_sequencer.h"
+#include "sample_output.h"
+
+// Per-channel playback state with double-buffered sample memory
+struct WaveformChannel {
+    uint16_t samples[2][AWG_MAX_SAMPLES];  // DAC codes
+    uint16_t length[2];                    // Samples in each buffer
+    uint16_t hold[2];                      // Ticks per sample for each buffer
+    char mode[2];                          // 'v' or 'c' for each buffer
+    uint8_t front;                         // Buffer being played
+    bool active;                           // Playback running
+    bool swapPending;                      // Back buffer committed, swap at end of cycle
+    bool loading;                          // Back buffer opened by beginWaveformLoad()
+    uint16_t position;                     // Current sample in front buffer
+    uint32_t holdCount;                    // Ticks spent on current sample
+    uint32_t cycles;                       // Completed cycles
+};
+
+static WaveformChannel awgChannels[3];
+
+// Guards playback state shared between loop() and the sample clock task
+static portMUX_TYPE awgMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Initialize waveform player
+ */
+void initWaveformPlayer() {
+    memset(awgChannels, 0, sizeof(awgChannels));
+    for (int i = 0; i < 3; i++) {
+        awgChannels[i].hold[0] = awgChannels[i].hold[1] = 1;
+        awgChannels[i].mode[0] = awgChannels[i].mode[1] = 'v';
+    }
+    Serial.printf("Waveform player initialized (%d samples x 2 buffers, %u bytes per channel)\n",
+                  AWG_MAX_SAMPLES, (unsigned)sizeof(WaveformChannel));
+}
+
+/**
+ * Start loading a new waveform into the back buffer of a channel
+ */
+bool beginWaveformLoad(uint8_t signal, char mode) {
+    if (signal < 1 || signal > 3) {
+        Serial.println("Invalid signal number. Use 1-3.");
+        return false;
+    }
+    if (mode != 'v' && mode != 'c') {
+        Serial.println("Invalid mode. Use 'v' for voltage or 'c' for current.");
+        return false;
+    }
+    WaveformChannel* ch = &awgChannels[signal - 1];
+
+    portENTER_CRITICAL(&awgMux);
+    bool pending = ch->swapPending;
+    bool modeConflict = ch->active && ch->mode[ch->front] != mode;
+    if (!pending && !modeConflict) {
+        uint8_t back = ch->front ^ 1;
+        ch->length[back] = 0;
+        ch->mode[back] = mode;
+        ch->loading = true;
+    }
+    portEXIT_CRITICAL(&awgMux);
+
+    if (pending) {
+        Serial.printf("SIG%d: previous waveform not yet active, retry after the current cycle.\n", signal);
+        return false;
+    }
+    if (modeConflict) {
+        Serial.printf("SIG%d: cannot change mode during playback. Use AWG STOP %d first.\n", signal, signal);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Append one sample to the back buffer
+ */
+bool appendWaveformSample(uint8_t signal, float value) {
+    if (signal < 1 || signal > 3) {
+        return false;
+    }
+    WaveformChannel* ch = &awgChannels[signal - 1];
+    if (!ch->loading) {
+        Serial.printf("SIG%d: no waveform being loaded. Use AWG LOAD first.\n", signal);
+        return false;
+    }
+
+    // Back buffer is not read by the sample task until committed
+    uint8_t back = ch->front ^ 1;
+    if (ch->length[back] >= AWG_MAX_SAMPLES) {
+        Serial.printf("SIG%d: waveform buffer full (%d samples).\n", signal, AWG_MAX_SAMPLES);
+        return false;
+    }
+    int32_t units = (int32_t)lroundf(value * 1000.0f); // mV or uA
+    uint16_t code = (ch->mode[back] == 'v') ? GP8413VoltageCodec::toCode(units) : GP8313CurrentCodec::toCode(units);
+    ch->samples[back][ch->length[back]++] = code;
+    return true;
+}
+
+/**
+ * Commit the back buffer
+ */
+bool commitWaveform(uint8_t signal, long hold) {
+    if (signal < 1 || signal > 3) {
+        Serial.println("Invalid signal number. Use 1-3.");
+        return false;
+    }
+    if (hold < 1 || hold > AWG_MAX_HOLD) {
+        Serial.printf("Invalid hold. Use 1-%d sample ticks.\n", AWG_MAX_HOLD);
+        return false;
+    }
+    int channel = signal - 1;
+    WaveformChannel* ch = &awgChannels[channel];
+    uint8_t back = ch->front ^ 1;
+    if (!ch->loading || ch->length[back] == 0) {
+        Serial.printf("SIG%d: no samples loaded.\n", signal);
+        return false;
+    }
+    char mode = ch->mode[back];
+
+    // Take the channel over from the sine generator before the first sample
+    bool starting = !ch->active;
+    if (starting) {
+        releaseSineChannel(channel);
+        releaseProfileChannel(channel);
+        signalModes[channel] = mode;
+        setRelayMode(signal, mode);
+    }
+
+    portENTER_CRITICAL(&awgMux);
+    ch->hold[back] = (uint16_t)hold;
+    ch->loading = false;
+    if (ch->active) {
+        ch->swapPending = true;
+    } else {
+        ch->front = back;
+        ch->position = 0;
+        ch->holdCount = 0;
+        ch->cycles = 0;
+        ch->active = true;
+    }
+    portEXIT_CRITICAL(&awgMux);
+
+    Serial.printf("SIG%d: waveform %s (%d samples, hold %ld ticks, %s mode)\n",
+                  signal, starting ? "started" : "queued for end of cycle",
+                  ch->length[back], hold, (mode == 'v') ? "voltage" : "current");
+    return true;
+}
+
+/**
+ * Advance playback position by a number of ticks, swapping buffers at end of cycle
+ * Caller holds awgMux.
+ */
+static void advanceWaveform(WaveformChannel* ch, uint32_t ticks) {
+    if (ticks == 0) {
+        return;
+    }
+    uint32_t hold = ch->hold[ch->front];
+    uint32_t elapsed = ch->holdCount + ticks;
+    uint32_t steps = elapsed / hold;
+    ch->holdCount = elapsed % hold;
+    if (steps == 0) {
+        return;
+    }
+
+    uint32_t length = ch->length[ch->front];
+    uint32_t position = ch->position + steps;
+    if (position >= length) {
+        ch->cycles += position / length;
+        position %= length;
+        if (ch->swapPending) {
+            ch->front ^= 1;
+            ch->swapPending = false;
+            position = 0;
+            ch->holdCount = 0;
+        }
+    }
+    ch->position = (uint16_t)position;
+}
+
+/**
+ * Render waveform samples into the tick's output frame
+ */
+void renderWaveformPlayback(DacFrame* frame, uint32_t ticks) {
+    for (int channel = 0; channel < 3; channel++) {
+        WaveformChannel* ch = &awgChannels[channel];
+
+        portENTER_CRITICAL(&awgMux);
+        bool active = ch->active;
+        uint16_t code = 0;
+        char mode = 'v';
+        if (active) {
+            // Skip missed ticks, output current sample, then step to the next one
+            advanceWaveform(ch, ticks - 1);
+            code = ch->samples[ch->front][ch->position];
+            mode = ch->mode[ch->front];
+            advanceWaveform(ch, 1);
+        }
+        portEXIT_CRITICAL(&awgMux);
+
+        if (!active) {
+            continue;
+        }
+        if (mode == 'v') {
+            dacFrameSetVoltageCode(frame, channel, code);
+        } else {
+            dacFrameSetCurrentCode(frame, channel, code);
+        }
+    }
+}
+
+/**
+ * Deactivate a channel, return true if it was playing
+ */
+static bool deactivateWaveform(uint8_t channel) {
+    WaveformChannel* ch = &awgChannels[channel];
+    portENTER_CRITICAL(&awgMux);
+    bool wasActive = ch->active;
+    ch->active = false;
+    ch->swapPending = false;
+    portEXIT_CRITICAL(&awgMux);
+    return wasActive;
+}
+
+/**
+ * Release a channel without touching its output (another source takes it over)
+ */
+void releaseWaveformChannel(uint8_t channel) {
+    cancelScheduledChannel(channel); // A latched code must not overwrite the new source
+    if (channel < 3 && deactivateWaveform(channel)) {
+        Serial.printf("Waveform playback on SIG%d replaced.\n", channel + 1);
+    }
+}
+
+/**
+ * Stop waveform playback
+ */
+void stopWaveform(uint8_t signal) {
+    if (signal > 3) {
+        Serial.println("Invalid signal number. Use 1-3, or 0 to stop all.");
+        return;
+    }
+    bool anyActive = false;
+    for (uint8_t channel = 0; channel < 3; channel++) {
+        if (signal != 0 && channel != signal - 1) {
+            continue;
+        }
+        if (deactivateWaveform(channel)) {
+            anyActive = true;
+            // Reset this channel's output to 0 (replaces any sample still pending)
+            WaveformChannel* ch = &awgChannels[channel];
+            if (ch->mode[ch->front] == 'v') {
+                postVoltageCode(channel, 0);
+            } else {
+                postCurrentCode(channel, 0);
+            }
+            Serial.printf("Waveform playback stopped on SIG%d, output reset to 0.\n", channel + 1);
+        }
+    }
+    if (!anyActive && signal != 0) {
+        Serial.printf("No waveform is playing on SIG%d.\n", signal);
+    }
+}
+
+/**
+ * Check if waveform playback is active on specific channel
+ */
+bool isWaveformActiveOnChannel(uint8_t channel) {
+    if (channel >= 3) return false;
+    return awgChannels[channel].active;
+}
+
+/**
+ * Print playback status and sample memory usage
+ */
+void getWaveformStatus() {
+    Serial.println("=== WAVEFORM PLAYBACK ===");
+    for (int i = 0; i < 3; i++) {
+        WaveformChannel* ch = &awgChannels[i];
+        uint8_t back = ch->front ^ 1;
+        if (ch->active) {
+            const char* unit = (ch->mode[ch->front] == 'v') ? "V" : "mA";
+            Serial.printf("SIG%d: PLAYING %d samples (%s), hold %d ticks, position %d, cycles %lu\n",
+                          i + 1, ch->length[ch->front], unit, ch->hold[ch->front], ch->position,
+                          (unsigned long)ch->cycles);
+        } else {
+            Serial.printf("SIG%d: IDLE\n", i + 1);
+        }
+        if (ch->swapPending) {
+            Serial.printf("  Next waveform: %d samples, active at end of cycle\n", ch->length[back]);
+        } else if (ch->loading) {
+            Serial.printf("  Loading: %d/%d samples\n", ch->length[back], AWG_MAX_SAMPLES);
+        }
+    }
+    Serial.printf("Sample memory: %u bytes per channel (2 x %d samples), %u bytes total\n",
+                  (unsigned)sizeof(WaveformChannel), AWG_MAX_SAMPLES, (unsigned)sizeof(awgChannels));
+    Serial.println("=========================");
+}
+
+/**
+ * Load a built-in shape into the back buffer and commit it
+ * @param type: TRI, SQUARE, SAW or STEP
+ * @param samples: Samples per cycle (STEP: number of levels)
+ */
+static void loadWaveformShape(uint8_t signal, char mode, String type, float low, float high,
+                              int samples, long hold) {
+    if (samples < 2 || samples > AWG_MAX_SAMPLES) {
+        Serial.printf("Invalid sample count. Use 2-%d.\n", AWG_MAX_SAMPLES);
+        return;
+    }
+    // Checked before loading so a bad hold does not leave the back buffer half-written
+    if (hold < 1 || hold > AWG_MAX_HOLD) {
+        Serial.printf("Invalid hold. Use 1-%d sample ticks.\n", AWG_MAX_HOLD);
+        return;
+    }
+    if (type != "TRI" && type != "SQUARE" && type != "SAW" && type != "STEP") {
+        Serial.println("Invalid shape. Use TRI, SQUARE, SAW or STEP.");
+        return;
+    }
+    if (!beginWaveformLoad(signal, mode)) {
+        return;
+    }
+    float span = high - low;
+    for (int k = 0; k < samples; k++) {
+        float phase = (float)k / samples;
+        float value;
+        if (type == "TRI") {
+            value = (phase < 0.5f) ? low + span * 2.0f * phase : high - span * 2.0f * (phase - 0.5f);
+        } else if (type == "SQUARE") {
+            value = (k < samples / 2) ? high : low;
+        } else if (type == "SAW") {
+            value = low + span * phase;
+        } else {
+            value = low + span * k / (samples - 1); // STEP: evenly spaced levels including both ends
+        }
+        appendWaveformSample(signal, value);
+    }
+    commitWaveform(signal, hold);
+}
+
+/**
+ * Parse waveform commands
+ * Format: AWG LOAD/DATA/COMMIT/SHAPE/STOP/STATUS ...
+ */
+void parseWaveformCommand(String input) {
+    input.trim();
+    input.toUpperCase();
+
+    if (input.startsWith("AWG LOAD")) {
+        // AWG LOAD signal mode
+        String params = input.substring(8);
+        params.trim();
+        int space1 = params.indexOf(' ');
+        if (space1 == -1) {
+            Serial.println("Invalid AWG LOAD format. Use: AWG LOAD signal mode");
+            return;
+        }
+        uint8_t signal = params.substring(0, space1).toInt();
+        char mode = toLowerCase(params.charAt(space1 + 1));
+        if (beginWaveformLoad(signal, mode)) {
+            Serial.printf("SIG%d: loading waveform, send AWG DATA then AWG COMMIT.\n", signal);
+        }
+
+    } else if (input.startsWith("AWG DATA")) {
+        // AWG DATA signal v1 v2 v3 ...
+        String params = input.substring(8);
+        params.trim();
+        int space = params.indexOf(' ');
+        if (space == -1) {
+            Serial.println("Invalid AWG DATA format. Use: AWG DATA signal value1 value2 ...");
+            return;
+        }
+        uint8_t signal = params.substring(0, space).toInt();
+        int added = 0;
+        int pos = space + 1;
+        while (pos < (int)params.length()) {
+            int next = params.indexOf(' ', pos);
+            if (next == -1) next = params.length();
+            if (next > pos) {
+                if (!appendWaveformSample(signal, params.substring(pos, next).toFloat())) {
+                    break;
+                }
+                added++;
+            }
+            pos = next + 1;
+        }
+        if (signal >= 1 && signal <= 3) {
+            Serial.printf("SIG%d: %d samples added (%d loaded)\n", signal, added,
+                          awgChannels[signal - 1].length[awgChannels[signal - 1].front ^ 1]);
+        }
+
+    } else if (input.startsWith("AWG COMMIT")) {
+        // AWG COMMIT signal [hold]
+        String params = input.substring(10);
+        params.trim();
+        int space = params.indexOf(' ');
+        uint8_t signal = params.substring(0, space == -1 ? params.length() : space).toInt();
+        long hold = (space == -1) ? 1 : params.substring(space + 1).toInt();
+        commitWaveform(signal, hold);
+
+    } else if (input.startsWith("AWG SHAPE")) {
+        // AWG SHAPE signal mode type low high samples [hold]
+        String params = input.substring(9);
+        params.trim();
+        int space1 = params.indexOf(' ');
+        int space2 = params.indexOf(' ', space1 + 1);
+        int space3 = params.indexOf(' ', space2 + 1);
+        int space4 = params.indexOf(' ', space3 + 1);
+        int space5 = params.indexOf(' ', space4 + 1);
+        if (space1 == -1 || space2 == -1 || space3 == -1 || space4 == -1 || space5 == -1) {
+            Serial.println("Invalid AWG SHAPE format. Use: AWG SHAPE signal mode type low high samples [hold]");
+            return;
+        }
+        uint8_t signal = params.substring(0, space1).toInt();
+        char mode = toLowerCase(params.charAt(space1 + 1));
+        String type = params.substring(space2 + 1, space3);
+        float low = params.substring(space3 + 1, space4).toFloat();
+        float high = params.substring(space4 + 1, space5).toFloat();
+        int space6 = params.indexOf(' ', space5 + 1);
+        int samples = params.substring(space5 + 1, space6 == -1 ? params.length() : space6).toInt();
+        long hold = (space6 == -1) ? 1 : params.substring(space6 + 1).toInt();
+        loadWaveformShape(signal, mode, type, low, high, samples, hold);
+
+    } else if (input.startsWith("AWG STOP")) {
+        String params = input.substring(8);
+        params.trim();
+        stopWaveform(params.length() == 0 ? 0 : params.toInt());
+
+    } else if (input.startsWith("AWG STATUS")) {
+        getWaveformStatus();
+
+    } else {
+        Serial.println("Invalid waveform command. Use:");
+        Serial.println("  AWG LOAD signal mode");
+        Serial.println("  AWG DATA signal value1 value2 ...");
+        Serial.println("  AWG COMMIT signal [hold]");
+        Serial.println("  AWG SHAPE signal mode TRI|SQUARE|SAW|STEP low high samples [hold]");
+        Serial.println("  AWG STOP [signal]");
+        Serial.println("  AWG STATUS");
+        Serial.println("Examples:");
+        Serial.println("  AWG SHAPE 1 V TRI 0.0 10.0 200      // Triangle 0-10V on SIG1");
+        Serial.println("  AWG SHAPE 3 V STEP 0.0 10.0 5 100   // 5-level staircase, 100 ticks per level");
+        Serial.printf("Buffer: %d samples per channel, double-buffered. hold: 1-%d sample ticks\n",
+                      AWG_MAX_SAMPLES, AWG_MAX_HOLD);
+    }
+}
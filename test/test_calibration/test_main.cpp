@@ -0,0 +1,113 @@
+// Native tests for the calibration lookup tables
+// Run with: pio test -e native -f test_calibration
+
+#include <unity.h>
+#include "calibration_lut.h"
+#include "dac_codes.h"
+
+// Tables are compiled in whole mV / uA, so a code can be off by one unit
+// (3.3 codes for voltage, 1.3 for current) plus one code of interpolation
+#define VOLTAGE_TOLERANCE 5
+#define CURRENT_TOLERANCE 3
+
+static uint16_t lut[CAL_LUT_SIZE];
+
+static CalibrationPoints makePoints(uint8_t count, const int32_t* nominal, const int32_t* measured) {
+    CalibrationPoints points;
+    points.count = count;
+    for (int i = 0; i < count; i++) {
+        points.nominal[i] = nominal[i];
+        points.measured[i] = measured[i];
+    }
+    return points;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// No points: the table is the identity
+void test_empty_table_is_identity() {
+    CalibrationPoints points = makePoints(0, NULL, NULL);
+    compileCalibrationLUT(&points, 'v', lut);
+    TEST_ASSERT_EQUAL_UINT16(0, lookupCalibrationLUT(lut, 'v', 0));
+    TEST_ASSERT_EQUAL_UINT16(12345, lookupCalibrationLUT(lut, 'v', 12345));
+    TEST_ASSERT_EQUAL_UINT16(GP8413VoltageCodec::kMaxCode,
+                             lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::kMaxCode));
+}
+
+// One point: constant offset over the whole range
+void test_single_point_is_offset() {
+    const int32_t nominal[] = {5000};
+    const int32_t measured[] = {5050};   // Output reads 50 mV high
+    CalibrationPoints points = makePoints(1, nominal, measured);
+    compileCalibrationLUT(&points, 'v', lut);
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(1950),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(2000)));
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(7950),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(8000)));
+}
+
+// Two points: interpolated inside, extrapolated and clamped at the endpoints
+void test_endpoints_extrapolate_and_clamp() {
+    const int32_t nominal[] = {1000, 9000};
+    const int32_t measured[] = {1100, 9100};  // 100 mV high everywhere
+    CalibrationPoints points = makePoints(2, nominal, measured);
+    compileCalibrationLUT(&points, 'v', lut);
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(4900),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(5000)));
+    // 0 V would need -100 mV: clamped to code 0
+    TEST_ASSERT_EQUAL_UINT16(0, lut[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, lookupCalibrationLUT(lut, 'v', 0));
+    // Full scale extrapolates past the last point
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(9900),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::kMaxCode));
+}
+
+// Gain below 1: the top of the range needs more than full scale and is clamped
+void test_gain_clamps_to_codec_range() {
+    const int32_t nominal[] = {1000, 5000};
+    const int32_t measured[] = {800, 4000};   // Output reads 20 % low
+    CalibrationPoints points = makePoints(2, nominal, measured);
+    compileCalibrationLUT(&points, 'c', lut);
+    TEST_ASSERT_EQUAL_UINT16(GP8313CurrentCodec::kMaxCode, lut[CAL_LUT_SIZE - 1]);
+    TEST_ASSERT_EQUAL_UINT16(GP8313CurrentCodec::kMaxCode,
+                             lookupCalibrationLUT(lut, 'c', GP8313CurrentCodec::toCode(24000)));
+    // Codes above the DAC range are clamped before the lookup
+    TEST_ASSERT_EQUAL_UINT16(GP8313CurrentCodec::kMaxCode, lookupCalibrationLUT(lut, 'c', 40000));
+    TEST_ASSERT_UINT16_WITHIN(CURRENT_TOLERANCE, GP8313CurrentCodec::toCode(2500),
+                              lookupCalibrationLUT(lut, 'c', GP8313CurrentCodec::toCode(2000)));
+}
+
+// Points entered out of order, with a measured curve that is not monotonic in nominal
+void test_non_monotonic_points() {
+    const int32_t nominal[] = {6000, 2000, 4000};
+    const int32_t measured[] = {5800, 2100, 4300};  // 4 V overshoots, 6 V reads low
+    CalibrationPoints points = makePoints(3, nominal, measured);
+    sortCalibrationPoints(&points);
+    TEST_ASSERT_EQUAL_INT32(2100, points.measured[0]);
+    TEST_ASSERT_EQUAL_INT32(4300, points.measured[1]);
+    TEST_ASSERT_EQUAL_INT32(5800, points.measured[2]);
+    TEST_ASSERT_EQUAL_INT32(4000, points.nominal[1]);
+
+    compileCalibrationLUT(&points, 'v', lut);
+    // Each measured point maps back to its nominal value
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(2000),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(2100)));
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(4000),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(4300)));
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(6000),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(5800)));
+    // Midway in the second segment: 5050 mV needs 5000 mV commanded
+    TEST_ASSERT_UINT16_WITHIN(VOLTAGE_TOLERANCE, GP8413VoltageCodec::toCode(5000),
+                              lookupCalibrationLUT(lut, 'v', GP8413VoltageCodec::toCode(5050)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_table_is_identity);
+    RUN_TEST(test_single_point_is_offset);
+    RUN_TEST(test_endpoints_extrapolate_and_clamp);
+    RUN_TEST(test_gain_clamps_to_codec_range);
+    RUN_TEST(test_non_monotonic_points);
+    return UNITY_END();
+}
@@ -0,0 +1,108 @@
+// Native tests for the DDS engine: sine interpolation, phase offsets and chirp increments
+// Run with: pio test -e native -f test_dds
+
+#include <unity.h>
+#include <math.h>
+#include "dds_engine.h"
+
+#define PHASE_PER_ENTRY (1UL << (32 - DDS_TABLE_BITS))
+
+void setUp() {}
+
+void tearDown() {}
+
+// Table points: zero crossings and peaks land exactly on entries
+void test_sine_table_points() {
+    TEST_ASSERT_EQUAL_INT16(0, ddsSineQ15(0));
+    TEST_ASSERT_EQUAL_INT16(32767, ddsSineQ15(0x40000000UL));
+    TEST_ASSERT_EQUAL_INT16(0, ddsSineQ15(0x80000000UL));
+    TEST_ASSERT_EQUAL_INT16(-32767, ddsSineQ15(0xC0000000UL));
+}
+
+// Between two entries the value is interpolated linearly, not held
+void test_sine_interpolation() {
+    uint32_t entry = 100 * PHASE_PER_ENTRY;
+    int32_t a = ddsSineQ15(entry);
+    int32_t b = ddsSineQ15(entry + PHASE_PER_ENTRY);
+    TEST_ASSERT_TRUE(b > a);
+
+    TEST_ASSERT_EQUAL_INT16(a + (((b - a) * 0x8000) >> 16), ddsSineQ15(entry + PHASE_PER_ENTRY / 2));
+    TEST_ASSERT_EQUAL_INT16(a + (((b - a) * 0x4000) >> 16), ddsSineQ15(entry + PHASE_PER_ENTRY / 4));
+    TEST_ASSERT_TRUE(ddsSineQ15(entry + PHASE_PER_ENTRY / 2) > a);
+    TEST_ASSERT_TRUE(ddsSineQ15(entry + PHASE_PER_ENTRY / 2) < b);
+}
+
+// Interpolated values follow sin() within 2 LSB over the whole cycle, including the last entry
+void test_sine_accuracy() {
+    for (uint32_t i = 0; i < 4096; i++) {
+        uint32_t phase = i * 1048573UL + 12345;  // Step not aligned to table entries
+        double expected = sin(2.0 * 3.14159265358979323846 * phase / 4294967296.0) * 32767.0;
+        TEST_ASSERT_INT_WITHIN(2, (int32_t)lround(expected), ddsSineQ15(phase));
+    }
+    TEST_ASSERT_INT_WITHIN(2, 0, ddsSineQ15(0xFFFFFFFFUL));
+}
+
+// Degrees map to fractions of 2^32 and wrap outside 0-360
+void test_phase_from_degrees() {
+    TEST_ASSERT_EQUAL_UINT32(0, ddsPhaseFromDegrees(0.0f));
+    TEST_ASSERT_EQUAL_UINT32(0x40000000UL, ddsPhaseFromDegrees(90.0f));
+    TEST_ASSERT_EQUAL_UINT32(0x80000000UL, ddsPhaseFromDegrees(180.0f));
+    TEST_ASSERT_EQUAL_UINT32(0xC0000000UL, ddsPhaseFromDegrees(270.0f));
+    TEST_ASSERT_EQUAL_UINT32(0, ddsPhaseFromDegrees(360.0f));
+    TEST_ASSERT_EQUAL_UINT32(0x40000000UL, ddsPhaseFromDegrees(450.0f));
+    TEST_ASSERT_EQUAL_UINT32(0xC0000000UL, ddsPhaseFromDegrees(-90.0f));
+    TEST_ASSERT_EQUAL_UINT32(0, ddsPhaseFromDegrees(-720.0f));
+}
+
+// Linear sweep: exact interpolation, then hold, restart or reverse at the end
+void test_chirp_linear() {
+    DDSChirp chirp;
+    ddsChirpConfigure(&chirp, 1000, 2000, 100, DDS_CHIRP_LINEAR, DDS_CHIRP_ONCE);
+    TEST_ASSERT_EQUAL_UINT32(1000, ddsChirpIncrement(&chirp, 0));
+    TEST_ASSERT_EQUAL_UINT32(1500, ddsChirpIncrement(&chirp, 50));
+    TEST_ASSERT_EQUAL_UINT32(2000, ddsChirpIncrement(&chirp, 100));
+    TEST_ASSERT_EQUAL_UINT32(2000, ddsChirpIncrement(&chirp, 250));
+
+    ddsChirpConfigure(&chirp, 1000, 2000, 100, DDS_CHIRP_LINEAR, DDS_CHIRP_REPEAT);
+    TEST_ASSERT_EQUAL_UINT32(1000, ddsChirpIncrement(&chirp, 100));
+    TEST_ASSERT_EQUAL_UINT32(1500, ddsChirpIncrement(&chirp, 150));
+
+    ddsChirpConfigure(&chirp, 1000, 2000, 100, DDS_CHIRP_LINEAR, DDS_CHIRP_BOUNCE);
+    TEST_ASSERT_EQUAL_UINT32(2000, ddsChirpIncrement(&chirp, 100));
+    TEST_ASSERT_EQUAL_UINT32(1800, ddsChirpIncrement(&chirp, 120));
+    TEST_ASSERT_EQUAL_UINT32(1000, ddsChirpIncrement(&chirp, 200));
+    TEST_ASSERT_EQUAL_UINT32(1500, ddsChirpIncrement(&chirp, 250));
+
+    // Downward sweeps and a zero start increment (clamped to 1)
+    ddsChirpConfigure(&chirp, 2000, 1000, 100, DDS_CHIRP_LINEAR, DDS_CHIRP_ONCE);
+    TEST_ASSERT_EQUAL_UINT32(1750, ddsChirpIncrement(&chirp, 25));
+    ddsChirpConfigure(&chirp, 0, 101, 100, DDS_CHIRP_LINEAR, DDS_CHIRP_ONCE);
+    TEST_ASSERT_EQUAL_UINT32(1, ddsChirpIncrement(&chirp, 0));
+    TEST_ASSERT_EQUAL_UINT32(51, ddsChirpIncrement(&chirp, 50));
+}
+
+// Log sweep: equal ratios in equal times, evaluated from the absolute position
+void test_chirp_log() {
+    DDSChirp chirp;
+    ddsChirpConfigure(&chirp, 1000000, 4000000, 1000, DDS_CHIRP_LOG, DDS_CHIRP_ONCE);
+    TEST_ASSERT_UINT32_WITHIN(2, 1000000, ddsChirpIncrement(&chirp, 0));
+    TEST_ASSERT_UINT32_WITHIN(4, 2000000, ddsChirpIncrement(&chirp, 500));
+    TEST_ASSERT_UINT32_WITHIN(8, 4000000, ddsChirpIncrement(&chirp, 1000));
+    TEST_ASSERT_UINT32_WITHIN(8, 4000000, ddsChirpIncrement(&chirp, 5000));
+
+    ddsChirpConfigure(&chirp, 1000000, 4000000, 1000, DDS_CHIRP_LOG, DDS_CHIRP_BOUNCE);
+    TEST_ASSERT_UINT32_WITHIN(4, 2000000, ddsChirpIncrement(&chirp, 1500));
+    TEST_ASSERT_UINT32_WITHIN(2, 1000000, ddsChirpIncrement(&chirp, 2000));
+}
+
+int main() {
+    ddsInitTable();
+    UNITY_BEGIN();
+    RUN_TEST(test_sine_table_points);
+    RUN_TEST(test_sine_interpolation);
+    RUN_TEST(test_sine_accuracy);
+    RUN_TEST(test_phase_from_degrees);
+    RUN_TEST(test_chirp_linear);
+    RUN_TEST(test_chirp_log);
+    return UNITY_END();
+}
@@ -0,0 +1,96 @@
+// Native tests for the sample tick scheduler, driven by a virtual microsecond clock
+// Run with: pio test -e native -f test_sample_scheduler
+
+#include <unity.h>
+#include "sample_scheduler.h"
+
+#define PERIOD_US 1000
+
+static SampleScheduler scheduler;
+static uint32_t nowUs;
+
+void setUp() {
+    nowUs = 5000;
+    sampleSchedulerReset(&scheduler, PERIOD_US, nowUs);
+}
+
+void tearDown() {}
+
+// First tick is due one period after the reset, statistics start at zero
+void test_reset() {
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_US, scheduler.periodUs);
+    TEST_ASSERT_EQUAL_UINT32(nowUs + PERIOD_US, scheduler.nextDeadlineUs);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.tickCount);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.missedTicks);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.maxLatenessUs);
+
+    sampleSchedulerReset(&scheduler, 0, nowUs);
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.periodUs);
+}
+
+// Wakes on each deadline deliver one tick each, with no lateness
+void test_on_time_ticks() {
+    for (int i = 1; i <= 10; i++) {
+        nowUs += PERIOD_US;
+        TEST_ASSERT_EQUAL_UINT32(1, sampleSchedulerPoll(&scheduler, nowUs));
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, scheduler.tickCount);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.missedTicks);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.maxLatenessUs);
+}
+
+// A wake more than half a period early is spurious, a slightly early one counts
+void test_early_wakes() {
+    TEST_ASSERT_EQUAL_UINT32(0, sampleSchedulerPoll(&scheduler, nowUs + PERIOD_US / 4));
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.tickCount);
+
+    TEST_ASSERT_EQUAL_UINT32(1, sampleSchedulerPoll(&scheduler, nowUs + PERIOD_US - 10));
+    TEST_ASSERT_EQUAL_UINT32(10, scheduler.lastLatenessUs);
+    TEST_ASSERT_EQUAL_UINT32(nowUs + 2 * PERIOD_US, scheduler.nextDeadlineUs);
+}
+
+// A late wake delivers every due tick and reports the whole delay
+void test_late_wake_reports_full_lateness() {
+    uint32_t start = nowUs;
+    nowUs += PERIOD_US + 2500;   // First deadline missed by 2.5 periods
+    TEST_ASSERT_EQUAL_UINT32(3, sampleSchedulerPoll(&scheduler, nowUs));
+    TEST_ASSERT_EQUAL_UINT32(2, scheduler.missedTicks);
+    TEST_ASSERT_EQUAL_UINT32(2500, scheduler.lastLatenessUs);
+    TEST_ASSERT_EQUAL_UINT32(2500, scheduler.maxLatenessUs);
+
+    // Deadlines stay on the original grid: no drift after catching up
+    TEST_ASSERT_EQUAL_UINT32(start + 4 * PERIOD_US, scheduler.nextDeadlineUs);
+    TEST_ASSERT_EQUAL_UINT32(1, sampleSchedulerPoll(&scheduler, start + 4 * PERIOD_US + 3));
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.lastLatenessUs);
+    TEST_ASSERT_EQUAL_UINT32(2500, scheduler.maxLatenessUs);
+
+    sampleSchedulerClearStats(&scheduler);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.missedTicks);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.maxLatenessUs);
+    TEST_ASSERT_EQUAL_UINT32(4, scheduler.tickCount);
+}
+
+// The microsecond counter wraps at 2^32 without losing or adding ticks
+void test_clock_wrap() {
+    nowUs = 0xFFFFFFFFu - 1500;
+    sampleSchedulerReset(&scheduler, PERIOD_US, nowUs);
+    nowUs += PERIOD_US;
+    TEST_ASSERT_EQUAL_UINT32(1, sampleSchedulerPoll(&scheduler, nowUs));
+    nowUs += PERIOD_US;                       // Past the wrap
+    TEST_ASSERT_TRUE(nowUs < PERIOD_US);
+    TEST_ASSERT_EQUAL_UINT32(1, sampleSchedulerPoll(&scheduler, nowUs));
+    nowUs += 3 * PERIOD_US;
+    TEST_ASSERT_EQUAL_UINT32(3, sampleSchedulerPoll(&scheduler, nowUs));
+    TEST_ASSERT_EQUAL_UINT32(5, scheduler.tickCount);
+    TEST_ASSERT_EQUAL_UINT32(2 * PERIOD_US, scheduler.lastLatenessUs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_reset);
+    RUN_TEST(test_on_time_ticks);
+    RUN_TEST(test_early_wakes);
+    RUN_TEST(test_late_wake_reports_full_lateness);
+    RUN_TEST(test_clock_wrap);
+    return UNITY_END();
+}
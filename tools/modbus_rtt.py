@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Modbus RTU stand-in master: polls the module and reports response latency.
+
+Sends FC03 (read holding registers) requests to one slave over a USB-RS485
+adapter and measures the round trip of each one, from the end of the request
+on the wire to the last byte of the response. The time the response itself
+spends on the wire is subtracted as well, giving the turnaround of the slave
+(gap detection + processing), comparable with 'modbus_stats' on the device.
+
+Requires pyserial (pip install pyserial).
+
+USB adapters buffer received bytes: set the FTDI latency timer to 1 ms
+(Linux: echo 1 > /sys/bus/usb-serial/devices/ttyUSB0/latency_timer) or the
+measured times include up to 16 ms of adapter delay.
+
+Example:
+    python tools/modbus_rtt.py /dev/ttyUSB0 --slave 1 --count 1000
+"""
+
+import argparse
+import statistics
+import sys
+import time
+
+import serial
+
+
+def crc16(data):
+    """Modbus CRC16 (polynomial 0xA001, initial 0xFFFF)."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def with_crc(frame):
+    crc = crc16(frame)
+    return bytes(frame) + bytes([crc & 0xFF, crc >> 8])
+
+
+def char_time(baud, parity):
+    """Seconds per character: start + 8 data + parity + stop bits."""
+    bits = 1 + 8 + (0 if parity == "N" else 1) + 1
+    return bits / baud
+
+
+def read_response(port, slave, count, deadline):
+    """Read one FC03 response; returns (frame, error) where error is None, 'timeout' or 'crc'."""
+    frame = bytearray()
+    expected = 5  # Exception length until the byte count is known
+    while len(frame) < expected:
+        if time.perf_counter() > deadline:
+            return bytes(frame), "timeout"
+        chunk = port.read(expected - len(frame))
+        frame.extend(chunk)
+        if len(frame) >= 2 and frame[1] == 0x03:
+            expected = 5 + 2 * count
+    if crc16(frame) != 0:
+        return bytes(frame), "crc"
+    if frame[0] != slave:
+        return bytes(frame), "address"
+    return bytes(frame), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="Serial port, e.g. /dev/ttyUSB0 or COM5")
+    parser.add_argument("--baud", type=int, default=19200, help="Baud rate (default 19200)")
+    parser.add_argument("--parity", choices="NEO", default="E", help="Parity (default E, 8E1)")
+    parser.add_argument("--slave", type=int, default=1, help="Slave ID (default 1)")
+    parser.add_argument("--address", type=int, default=0, help="First register (default 0)")
+    parser.add_argument("--registers", type=int, default=2, help="Registers per request (default 2)")
+    parser.add_argument("--count", type=int, default=100, help="Requests to send (default 100)")
+    parser.add_argument("--interval", type=float, default=0.05,
+                        help="Pause between requests in seconds (default 0.05)")
+    parser.add_argument("--timeout", type=float, default=0.5,
+                        help="Response timeout in seconds (default 0.5)")
+    args = parser.parse_args()
+
+    if not 1 <= args.registers <= 125:
+        parser.error("--registers must be 1-125")
+
+    request = with_crc([args.slave, 0x03, args.address >> 8, args.address & 0xFF,
+                        args.registers >> 8, args.registers & 0xFF])
+    tchar = char_time(args.baud, args.parity)
+    request_wire = len(request) * tchar
+
+    port = serial.Serial(args.port, args.baud, bytesize=8, parity=args.parity, stopbits=1,
+                         timeout=0.001)
+    round_trips = []
+    turnarounds = []
+    errors = {"timeout": 0, "crc": 0, "address": 0, "exception": 0}
+
+    try:
+        for _ in range(args.count):
+            port.reset_input_buffer()
+            start = time.perf_counter()
+            port.write(request)
+            frame, error = read_response(port, args.slave, args.registers, start + args.timeout)
+            end = time.perf_counter()
+
+            if error:
+                errors[error] += 1
+            elif frame[1] & 0x80:
+                errors["exception"] += 1
+                print("Exception %02X" % frame[2], file=sys.stderr)
+            else:
+                # Round trip from the end of the request on the wire
+                rtt = end - start - request_wire
+                round_trips.append(rtt)
+                turnarounds.append(rtt - len(frame) * tchar)
+            time.sleep(args.interval)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        port.close()
+
+    ok = len(round_trips)
+    print("Requests: %d ok, %d timeout, %d CRC error, %d wrong address, %d exception" %
+          (ok, errors["timeout"], errors["crc"], errors["address"], errors["exception"]))
+    if ok == 0:
+        return 1
+
+    def report(name, samples):
+        ordered = sorted(samples)
+        p99 = ordered[min(len(ordered) - 1, int(len(ordered) * 0.99))]
+        print("%-11s min %7.2f  avg %7.2f  median %7.2f  p99 %7.2f  max %7.2f ms" %
+              (name, ordered[0] * 1e3, statistics.mean(ordered) * 1e3,
+               statistics.median(ordered) * 1e3, p99 * 1e3, ordered[-1] * 1e3))
+
+    report("Round trip", round_trips)
+    report("Turnaround", turnarounds)
+    print("(Turnaround = round trip minus the response on the wire; the slave's "
+          "3.5-character gap is %.2f ms)" % (3.5 * tchar * 1e3))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())